@@ -0,0 +1,115 @@
+#ifndef ARENA_CPP
+#define ARENA_CPP
+
+/**
+ * @file Arena.cpp
+ *
+ * @brief A bump allocator releasing all its objects at once.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class Arena
+ * @brief Allocates objects by bumping a pointer in large chunks and frees them all together.
+ *
+ * Objects are never freed one by one: release() (or the destructor) runs the
+ * destructors of the non-trivially destructible objects in reverse creation
+ * order and returns every chunk to the heap in one go.
+ */
+class Arena
+{
+private:
+    /**
+     * @brief Destructor call registered for an object that needs one.
+     */
+    struct Finalizer {
+        void (*destroy)(void*);
+        void* object;
+    };
+
+    vector<unique_ptr<char[]>> chunks;
+    vector<Finalizer> finalizers;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t nextChunkSize;
+    size_t used = 0;
+
+public:
+    /**
+     * @brief Create an empty arena.
+     * @param firstChunkSize Size of the first chunk; later chunks double up to 16 MiB.
+     */
+    explicit Arena(size_t firstChunkSize = 64 * 1024): nextChunkSize(firstChunkSize) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() { release(); }
+
+    /**
+     * @brief Allocate raw memory.
+     * @param size Number of bytes.
+     * @param align Required alignment, a power of two.
+     */
+    void* allocate(size_t size, size_t align = alignof(max_align_t)) {
+        size_t space = limit - cursor;
+        void* p = cursor;
+        if (!cursor || !std::align(align, size, p, space)) {
+            size_t chunkSize = max(nextChunkSize, size + align);
+            chunks.emplace_back(new char[chunkSize]);
+            cursor = chunks.back().get();
+            limit = cursor + chunkSize;
+            nextChunkSize = min(nextChunkSize * 2, size_t(16) << 20);
+            p = cursor;
+            space = chunkSize;
+            std::align(align, size, p, space);
+        }
+        cursor = static_cast<char*>(p) + size;
+        used += size;
+        return p;
+    }
+
+    /**
+     * @brief Construct an object in the arena.
+     * @return A pointer valid until release().
+     */
+    template <class T, class... Args>
+    T* create(Args&&... args) {
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (!is_trivially_destructible_v<T>) {
+            finalizers.push_back(Finalizer{[](void* o) { static_cast<T*>(o)->~T(); }, object});
+        }
+        return object;
+    }
+
+    /**
+     * @brief Destroy every object and free every chunk.
+     */
+    void release() {
+        for (auto it = finalizers.rbegin(); it != finalizers.rend(); ++it) it->destroy(it->object);
+        finalizers.clear();
+        chunks.clear();
+        cursor = limit = nullptr;
+        used = 0;
+    }
+
+    /**
+     * @brief Number of bytes handed out since the last release().
+     */
+    size_t bytesUsed() const { return used; }
+
+    /**
+     * @brief Number of chunks currently held.
+     */
+    size_t chunkCount() const { return chunks.size(); }
+};
+#endif // ARENA_CPP
@@ -0,0 +1,250 @@
+#ifndef BATCH_KERNELS_CPP
+#define BATCH_KERNELS_CPP
+
+/**
+ * @file BatchKernels.cpp
+ *
+ * @brief Batched evaluation of many devices of the same type, with AVX2/AVX-512 kernels.
+ */
+
+#include "Separator.cpp"
+#include <map>
+#include <tuple>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_KERNELS_X86 1
+#endif
+
+using namespace std;
+
+/**
+ * @brief Instruction set used by the batch kernels.
+ */
+enum class SimdLevel { Scalar, Avx2, Avx512 };
+
+namespace batch_kernels {
+
+/**
+ * @brief Sum the inputs of every unit and write each output as a fraction of the sum.
+ *
+ * Index and fraction arrays are port-major: port p of unit u is at p * units + u.
+ * Inputs are summed in port order starting from zero with Neumaier
+ * compensation, like Mixer, so the results match updateOutputs() exactly.
+ */
+inline void sumSplitScalar(double* flow, const uint32_t* in, size_t nIn, const uint32_t* out,
+                           const double* frac, size_t nOut, size_t units, size_t from = 0) {
+    for (size_t u = from; u < units; u++) {
+        NeumaierSum sum;
+        for (size_t p = 0; p < nIn; p++) sum.add(flow[in[p * units + u]]);
+        double total = sum.result();
+        for (size_t p = 0; p < nOut; p++) flow[out[p * units + u]] = total * frac[p * units + u];
+    }
+}
+
+#ifdef BATCH_KERNELS_X86
+__attribute__((target("avx2")))
+inline void sumSplitAvx2(double* flow, const uint32_t* in, size_t nIn, const uint32_t* out,
+                         const double* frac, size_t nOut, size_t units) {
+    size_t u = 0;
+    for (; u + 4 <= units; u += 4) {
+        __m256d sum = _mm256_setzero_pd(), comp = _mm256_setzero_pd();
+        __m256d sign = _mm256_set1_pd(-0.0);
+        for (size_t p = 0; p < nIn; p++) {
+            __m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + p * units + u));
+            __m256d x = _mm256_i32gather_pd(flow, idx, 8);
+            __m256d t = _mm256_add_pd(sum, x);
+            __m256d sumLarger = _mm256_cmp_pd(_mm256_andnot_pd(sign, sum), _mm256_andnot_pd(sign, x), _CMP_GE_OQ);
+            __m256d error = _mm256_blendv_pd(_mm256_add_pd(_mm256_sub_pd(x, t), sum),
+                                             _mm256_add_pd(_mm256_sub_pd(sum, t), x), sumLarger);
+            comp = _mm256_add_pd(comp, error);
+            sum = t;
+        }
+        sum = _mm256_add_pd(sum, comp);
+        for (size_t p = 0; p < nOut; p++) {
+            alignas(32) double v[4];
+            _mm256_store_pd(v, _mm256_mul_pd(sum, _mm256_loadu_pd(frac + p * units + u)));
+            const uint32_t* o = out + p * units + u;
+            flow[o[0]] = v[0];
+            flow[o[1]] = v[1];
+            flow[o[2]] = v[2];
+            flow[o[3]] = v[3];
+        }
+    }
+    sumSplitScalar(flow, in, nIn, out, frac, nOut, units, u);
+}
+
+__attribute__((target("avx512f")))
+inline void sumSplitAvx512(double* flow, const uint32_t* in, size_t nIn, const uint32_t* out,
+                           const double* frac, size_t nOut, size_t units) {
+    size_t u = 0;
+    for (; u + 8 <= units; u += 8) {
+        __m512d sum = _mm512_setzero_pd(), comp = _mm512_setzero_pd();
+        for (size_t p = 0; p < nIn; p++) {
+            __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + p * units + u));
+            __m512d x = _mm512_i32gather_pd(idx, flow, 8);
+            __m512d t = _mm512_add_pd(sum, x);
+            __mmask8 sumLarger = _mm512_cmp_pd_mask(_mm512_abs_pd(sum), _mm512_abs_pd(x), _CMP_GE_OQ);
+            __m512d error = _mm512_mask_blend_pd(sumLarger, _mm512_add_pd(_mm512_sub_pd(x, t), sum),
+                                                 _mm512_add_pd(_mm512_sub_pd(sum, t), x));
+            comp = _mm512_add_pd(comp, error);
+            sum = t;
+        }
+        sum = _mm512_add_pd(sum, comp);
+        for (size_t p = 0; p < nOut; p++) {
+            __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out + p * units + u));
+            _mm512_i32scatter_pd(flow, idx, _mm512_mul_pd(sum, _mm512_loadu_pd(frac + p * units + u)), 8);
+        }
+    }
+    sumSplitScalar(flow, in, nIn, out, frac, nOut, units, u);
+}
+#endif
+
+/**
+ * @brief Best instruction set supported by the running CPU.
+ */
+inline SimdLevel detectSimdLevel() {
+#ifdef BATCH_KERNELS_X86
+    if (__builtin_cpu_supports("avx512f")) return SimdLevel::Avx512;
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+inline SimdLevel& activeSimdLevel() {
+    static SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+inline void sumSplit(double* flow, const uint32_t* in, size_t nIn, const uint32_t* out,
+                     const double* frac, size_t nOut, size_t units) {
+    switch (activeSimdLevel()) {
+#ifdef BATCH_KERNELS_X86
+    case SimdLevel::Avx512: sumSplitAvx512(flow, in, nIn, out, frac, nOut, units); return;
+    case SimdLevel::Avx2: sumSplitAvx2(flow, in, nIn, out, frac, nOut, units); return;
+#endif
+    default: sumSplitScalar(flow, in, nIn, out, frac, nOut, units); return;
+    }
+}
+
+} // namespace batch_kernels
+
+/**
+ * @brief Get the instruction set used by the batch kernels.
+ */
+inline SimdLevel getSimdLevel() { return batch_kernels::activeSimdLevel(); }
+
+/**
+ * @brief Force the instruction set used by the batch kernels.
+ *
+ * Levels the CPU does not support fall back to the best supported one.
+ */
+inline void setSimdLevel(SimdLevel level) {
+    batch_kernels::activeSimdLevel() = min(level, batch_kernels::detectSimdLevel());
+}
+
+/**
+ * @class DeviceBatch
+ * @brief Devices of one kind and port count, with their ports laid out in contiguous arrays.
+ */
+class DeviceBatch
+{
+private:
+    DeviceKind kind;
+    size_t nIn, nOut;
+    size_t units = 0;
+    vector<uint32_t> in, out; ///< Port-major stream indices.
+    vector<double> frac;      ///< Port-major output fractions.
+#ifdef DEVICE_PROFILING
+    uint64_t profileId = Profiler::newUnitId(); ///< Identifies the batch in the Profiler.
+#endif
+
+public:
+    /**
+     * @brief Lay out a set of devices sharing the same kind, table and port counts.
+     */
+    explicit DeviceBatch(const vector<Device*>& group)
+        : kind(group.front()->kind()), nIn(group.front()->getInputIds().size()),
+          nOut(group.front()->getOutputIds().size()), units(group.size()),
+          in(nIn * units), out(nOut * units), frac(nOut * units) {
+        for (size_t u = 0; u < units; u++) {
+            const Device* d = group[u];
+            for (size_t p = 0; p < nIn; p++) in[p * units + u] = d->getInputIds()[p];
+            for (size_t p = 0; p < nOut; p++) {
+                out[p * units + u] = d->getOutputIds()[p];
+                frac[p * units + u] = d->outputFraction(p);
+            }
+        }
+    }
+
+    DeviceKind getKind() const { return kind; }
+    size_t size() const { return units; }
+#ifdef DEVICE_PROFILING
+    uint64_t getProfileId() const { return profileId; }
+#endif
+
+    /**
+     * @brief Run the kernel over every device of the batch.
+     * @param flow The mass flow array of the table the devices are connected to.
+     */
+    void run(double* flow) const {
+        batch_kernels::sumSplit(flow, in.data(), nIn, out.data(), frac.data(), nOut, units);
+    }
+};
+
+/**
+ * @class BatchPlan
+ * @brief Groups a set of mutually independent devices by kind and port count.
+ *
+ * Devices of kind Other, devices with incomplete ports (reported by
+ * validate()) and devices on another table are kept aside and run
+ * through the virtual updateOutputs(). The kernels only handle total mass
+ * flows, so every device is kept aside when the table tracks components.
+ */
+class BatchPlan
+{
+private:
+    StreamTable* table = nullptr;
+    vector<DeviceBatch> batches;
+    vector<Device*> fallback;
+
+public:
+    BatchPlan() = default;
+
+    /**
+     * @brief Build the plan.
+     * @param devices Devices that do not read each other's outputs.
+     * @param t The table the batched devices must be connected to.
+     */
+    BatchPlan(const vector<Device*>& devices, StreamTable* t): table(t) {
+        map<tuple<int, size_t, size_t>, vector<Device*>> groups;
+        for (Device* d : devices) {
+            if (d->kind() == DeviceKind::Other || d->getTable() != table || !d->portsComplete()
+                || table->componentCount() != 0) {
+                fallback.push_back(d);
+                continue;
+            }
+            groups[{static_cast<int>(d->kind()), d->getInputIds().size(), d->getOutputIds().size()}].push_back(d);
+        }
+        for (auto& g : groups) batches.emplace_back(g.second);
+    }
+
+    const vector<DeviceBatch>& getBatches() const { return batches; }
+    const vector<Device*>& getFallback() const { return fallback; }
+
+    /**
+     * @brief Evaluate every device of the plan.
+     */
+    void run() const {
+        if (!batches.empty()) {
+            double* flow = table->data();
+            for (const DeviceBatch& b : batches) {
+                PROFILE_START(start);
+                b.run(flow);
+                PROFILE_BATCH(&b, kindName(b.getKind()), b.size(), start);
+            }
+        }
+        for (Device* d : fallback) d->update();
+    }
+};
+#endif // BATCH_KERNELS_CPP
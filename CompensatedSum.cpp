@@ -0,0 +1,83 @@
+#ifndef COMPENSATED_SUM_CPP
+#define COMPENSATED_SUM_CPP
+
+/**
+ * @file CompensatedSum.cpp
+ *
+ * @brief Compensated (Neumaier) summation and a reproducible parallel sum.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "ThreadPool.cpp"
+
+using namespace std;
+
+/**
+ * @brief Add x to sum, accumulating the rounding error of the addition in compensation.
+ *
+ * Neumaier's variant of Kahan summation: the error is recovered whichever of
+ * sum and x is larger, so the error of sum + compensation does not grow with
+ * the number of terms and small terms survive the cancellation of large ones.
+ */
+inline void neumaierAdd(double& sum, double& compensation, double x) {
+    double t = sum + x;
+    double sumLarger = (sum - t) + x, xLarger = (x - t) + sum; // both, so the choice is a select, not a branch
+    compensation += abs(sum) >= abs(x) ? sumLarger : xLarger;
+    sum = t;
+}
+
+/**
+ * @struct NeumaierSum
+ * @brief Running compensated sum.
+ */
+struct NeumaierSum
+{
+    double sum = 0.0;
+    double compensation = 0.0;
+
+    void add(double x) { neumaierAdd(sum, compensation, x); }
+
+    /**
+     * @brief Add another partial sum, e.g. of another chunk of the same range.
+     */
+    void add(const NeumaierSum& other) {
+        add(other.sum);
+        add(other.compensation);
+    }
+
+    double result() const { return sum + compensation; }
+};
+
+/**
+ * @brief Sum value(i) over [0, n), in parallel, with a result independent of the thread count.
+ *
+ * The range is cut into chunks of a fixed size, whatever the pool. Each chunk
+ * is summed in index order with compensation and the chunk sums are added
+ * in chunk order, so the result is the same bit for bit with or without a
+ * pool, for any number of threads and any schedule.
+ *
+ * @param n Number of terms.
+ * @param value Called with every index; must be safe to call concurrently.
+ * @param pool Pool running the chunks, or nullptr to sum on the caller.
+ * @param chunk Number of terms per chunk.
+ */
+template <class Value>
+double reproducibleSum(size_t n, Value value, ThreadPool* pool = nullptr, size_t chunk = 4096) {
+    chunk = max<size_t>(1, chunk);
+    size_t chunks = (n + chunk - 1) / chunk;
+    vector<NeumaierSum> partial(chunks);
+    auto body = [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            size_t last = min(n, (k + 1) * chunk);
+            for (size_t i = k * chunk; i < last; i++) partial[k].add(value(i));
+        }
+    };
+    if (pool && chunks > 1) pool->parallelFor(chunks, 1, body);
+    else body(0, chunks);
+    NeumaierSum total;
+    for (const NeumaierSum& p : partial) total.add(p);
+    return total.result();
+}
+#endif // COMPENSATED_SUM_CPP
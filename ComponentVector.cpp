@@ -0,0 +1,108 @@
+#ifndef COMPONENT_VECTOR_CPP
+#define COMPONENT_VECTOR_CPP
+
+/**
+ * @file ComponentVector.cpp
+ *
+ * @brief A small vector of per-component values.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+
+using namespace std;
+
+/**
+ * @class ComponentVector
+ * @brief Per-component values (mass flows, split fractions) with a small-buffer optimization.
+ *
+ * Up to InlineCapacity components are stored inside the object, so copying
+ * the composition of a typical stream does not touch the heap.
+ */
+class ComponentVector
+{
+public:
+    static constexpr size_t InlineCapacity = 4;
+
+private:
+    size_t count = 0;
+    double inlineValues[InlineCapacity] = {};
+    unique_ptr<double[]> heapValues;
+
+    void allocate(size_t n) {
+        count = n;
+        if (n > InlineCapacity) heapValues.reset(new double[n]);
+        else heapValues.reset();
+    }
+
+public:
+    ComponentVector() = default;
+
+    /**
+     * @brief Create a vector of n components, all set to value.
+     */
+    explicit ComponentVector(size_t n, double value = 0.0) {
+        allocate(n);
+        fill(begin(), end(), value);
+    }
+
+    ComponentVector(initializer_list<double> values) {
+        allocate(values.size());
+        copy(values.begin(), values.end(), begin());
+    }
+
+    /**
+     * @brief Copy n components from an array.
+     */
+    ComponentVector(const double* values, size_t n) {
+        allocate(n);
+        copy(values, values + n, begin());
+    }
+
+    ComponentVector(const ComponentVector& other): ComponentVector(other.data(), other.size()) {}
+
+    ComponentVector& operator=(const ComponentVector& other) {
+        if (this != &other) {
+            if (other.count != count) allocate(other.count);
+            copy(other.begin(), other.end(), begin());
+        }
+        return *this;
+    }
+
+    ComponentVector(ComponentVector&& other) noexcept { *this = std::move(other); }
+
+    ComponentVector& operator=(ComponentVector&& other) noexcept {
+        if (this != &other) {
+            count = other.count;
+            heapValues = std::move(other.heapValues);
+            copy(other.inlineValues, other.inlineValues + InlineCapacity, inlineValues);
+            other.count = 0;
+        }
+        return *this;
+    }
+
+    size_t size() const { return count; }
+    bool isInline() const { return count <= InlineCapacity; }
+
+    double* data() { return heapValues ? heapValues.get() : inlineValues; }
+    const double* data() const { return heapValues ? heapValues.get() : inlineValues; }
+    double* begin() { return data(); }
+    double* end() { return data() + count; }
+    const double* begin() const { return data(); }
+    const double* end() const { return data() + count; }
+
+    double& operator[](size_t i) { return data()[i]; }
+    double operator[](size_t i) const { return data()[i]; }
+
+    /**
+     * @brief Sum of all components.
+     */
+    double sum() const {
+        double total = 0.0;
+        for (double v : *this) total += v;
+        return total;
+    }
+};
+#endif // COMPONENT_VECTOR_CPP
@@ -0,0 +1,102 @@
+#ifndef DEVICE_ERROR_CPP
+#define DEVICE_ERROR_CPP
+
+/**
+ * @file DeviceError.cpp
+ *
+ * @brief Error codes of device wiring and validation, and the exception carrying them.
+ */
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+/**
+ * @brief What is wrong with a device or a flowsheet.
+ */
+enum class DeviceError {
+    None,
+    InputLimit,         ///< Connecting more inputs than the device accepts.
+    OutputLimit,        ///< Connecting more outputs than the device accepts.
+    DifferentTables,    ///< Connecting streams of another StreamTable than the device's.
+    MissingInput,       ///< Fewer inputs connected than updateOutputs() needs.
+    MissingOutput,      ///< Fewer outputs connected than updateOutputs() needs.
+    ConversionSize,     ///< Reactor conversion matrix not N x N for N components.
+    SplitSize,          ///< Separator component split not one value per component, or with more than two outputs.
+    SplitFractions,     ///< Separator output fractions empty, negative or not summing to a positive value.
+    SeveralProducers,   ///< A stream is an output of several devices.
+    NotConverged,       ///< A recycle loop or partition exchange did not converge within the iteration limit.
+    ComponentCount,     ///< Component flows given for another number of components than the table's.
+    UnsupportedDevice,  ///< A device type the operation cannot handle, e.g. a custom device in a snapshot.
+    FileAccess,         ///< A file could not be opened, mapped or written.
+    FileFormat,         ///< A file is not of the expected format, or is truncated or corrupt.
+    UnsupportedComponents, ///< An evaluator of mass flows only given a flowsheet with components.
+    SingularMatrix,     ///< A linear system without a unique solution, e.g. a recycle loop with no way out.
+    SharedMemory,       ///< Shared memory between workers could not be mapped.
+    ResidenceTime,      ///< Tank residence time not positive.
+    StepTooSmall,       ///< The dynamic integrator step fell below its minimum.
+    TooManyParameters,  ///< More sensitivity parameters than derivatives carried.
+};
+
+/**
+ * @brief Message of an error code.
+ */
+inline const char* errorMessage(DeviceError e) {
+    switch (e) {
+    case DeviceError::None: return "NO ERROR";
+    case DeviceError::InputLimit: return "INPUT STREAM LIMIT!";
+    case DeviceError::OutputLimit: return "OUTPUT STREAM LIMIT!";
+    case DeviceError::DifferentTables: return "STREAMS FROM DIFFERENT TABLES!";
+    case DeviceError::MissingInput: return "MISSING INPUT STREAM!";
+    case DeviceError::MissingOutput: return "MISSING OUTPUT STREAM!";
+    case DeviceError::ConversionSize: return "CONVERSION MATRIX SIZE MISMATCH!";
+    case DeviceError::SplitSize: return "COMPONENT SPLIT SIZE MISMATCH!";
+    case DeviceError::SplitFractions: return "INVALID SPLIT FRACTIONS!";
+    case DeviceError::SeveralProducers: return "STREAM HAS SEVERAL PRODUCERS!";
+    case DeviceError::NotConverged: return "ITERATION DID NOT CONVERGE!";
+    case DeviceError::ComponentCount: return "COMPONENT COUNT MISMATCH!";
+    case DeviceError::UnsupportedDevice: return "DEVICE TYPE NOT SUPPORTED!";
+    case DeviceError::FileAccess: return "CANNOT ACCESS FILE!";
+    case DeviceError::FileFormat: return "INVALID FILE FORMAT!";
+    case DeviceError::UnsupportedComponents: return "COMPONENT FLOWS NOT SUPPORTED!";
+    case DeviceError::SingularMatrix: return "SINGULAR MATRIX!";
+    case DeviceError::SharedMemory: return "CANNOT MAP SHARED MEMORY!";
+    case DeviceError::ResidenceTime: return "RESIDENCE TIME MUST BE POSITIVE!";
+    case DeviceError::StepTooSmall: return "DYNAMIC STEP SIZE TOO SMALL!";
+    case DeviceError::TooManyParameters: return "TOO MANY SENSITIVITY PARAMETERS!";
+    }
+    return "UNKNOWN ERROR!";
+}
+
+/**
+ * @class DeviceException
+ * @brief Thrown by the throwing wiring calls (addInput(), addOutput()), by
+ * evaluation (validation, recycle convergence) and by the checked mode.
+ */
+class DeviceException : public runtime_error
+{
+private:
+    DeviceError error;
+
+public:
+    explicit DeviceException(DeviceError e): runtime_error(errorMessage(e)), error(e) {}
+    DeviceError code() const { return error; }
+};
+
+class Device;
+
+/**
+ * @struct Diagnostic
+ * @brief One problem found by Flowsheet::validate().
+ */
+struct Diagnostic
+{
+    DeviceError code;
+    const Device* device;    ///< The faulty device, or the first producer of a stream with several.
+    uint32_t stream = ~0u;   ///< Index of the stream involved in its table, if any.
+
+    const char* message() const { return errorMessage(code); }
+};
+#endif // DEVICE_ERROR_CPP
@@ -0,0 +1,187 @@
+#ifndef DEVICE_MEMO_CPP
+#define DEVICE_MEMO_CPP
+
+/**
+ * @file DeviceMemo.cpp
+ *
+ * @brief Bounded LRU cache of device results, keyed on quantized input flows.
+ */
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "StreamTable.cpp"
+
+using namespace std;
+
+/**
+ * @class DeviceMemo
+ * @brief Remembers the outputs a device computed for recent inputs.
+ *
+ * The key is the mass flow (and component flows) of every input, each
+ * rounded to a multiple of the quantum, so inputs that moved by less than
+ * about half a quantum reuse the stored outputs. A quantum of 0 matches
+ * exact values only. At most capacity results are kept; the least recently
+ * used one is replaced first.
+ *
+ * Entries live in flat arrays (keys and outputs of fixed size per entry) on
+ * an intrusive LRU list; a hash of the key finds the entry.
+ */
+class DeviceMemo
+{
+private:
+    static constexpr uint32_t None = ~0u;
+
+    size_t capacity;
+    double inverseQuantum;             ///< 1 / quantum, 0 for exact keys.
+    size_t keySize = 0, valueSize = 0; ///< Values per key and per stored result.
+    vector<uint64_t> keys;             ///< keySize values per entry.
+    vector<double> values;             ///< valueSize values per entry.
+    vector<uint64_t> hashes;
+    vector<uint32_t> prev, next;       ///< LRU list, most recent at head.
+    uint32_t head = None, tail = None;
+    unordered_map<uint64_t, uint32_t> index;
+    vector<uint64_t> key;              ///< Key of the last recall().
+    uint64_t keyHash = 0;
+    size_t hitCount = 0, missCount = 0, evictionCount = 0;
+
+    uint64_t quantize(double x) const {
+        double q = inverseQuantum > 0.0 ? nearbyint(x * inverseQuantum) : x;
+        return bit_cast<uint64_t>(q + 0.0); // + 0.0 folds -0 into 0
+    }
+
+    void unlink(uint32_t e) {
+        (prev[e] == None ? head : next[prev[e]]) = next[e];
+        (next[e] == None ? tail : prev[next[e]]) = prev[e];
+    }
+
+    void pushFront(uint32_t e) {
+        prev[e] = None;
+        next[e] = head;
+        (head == None ? tail : prev[head]) = e;
+        head = e;
+    }
+
+    /**
+     * @brief Forget every entry if the port layout changed.
+     */
+    void resize(size_t newKeySize, size_t newValueSize) {
+        if (newKeySize == keySize && newValueSize == valueSize) return;
+        clear();
+        keySize = newKeySize;
+        valueSize = newValueSize;
+        keys.clear();
+        values.clear();
+    }
+
+public:
+    /**
+     * @brief Create an empty cache.
+     * @param capacity Maximum number of results kept.
+     * @param quantum Flow resolution of the key, 0 for exact inputs.
+     */
+    DeviceMemo(size_t capacity, double quantum)
+        : capacity(max<size_t>(1, capacity)), inverseQuantum(quantum > 0.0 ? 1.0 / quantum : 0.0) {}
+
+    /**
+     * @brief Look the current inputs up and, on a hit, write the stored outputs.
+     * @return Whether the outputs were written.
+     */
+    bool recall(StreamTable& table, const vector<uint32_t>& inputIds, const vector<uint32_t>& outputIds) {
+        size_t width = 1 + table.componentCount();
+        resize(inputIds.size() * width, outputIds.size() * width);
+        key.clear();
+        keyHash = 0x9e3779b97f4a7c15ull;
+        for (uint32_t id : inputIds) {
+            key.push_back(quantize(table.flow(id)));
+            const double* c = table.componentData(id);
+            for (size_t k = 1; k < width; k++) key.push_back(quantize(c[k - 1]));
+        }
+        for (uint64_t v : key) keyHash = (keyHash ^ v) * 0x100000001b3ull + (keyHash >> 29);
+
+        auto it = index.find(keyHash);
+        if (it == index.end() || !equal(key.begin(), key.end(), keys.begin() + it->second * keySize)) {
+            missCount++;
+            return false;
+        }
+        uint32_t e = it->second;
+        const double* v = values.data() + e * valueSize;
+        double* flow = table.data();
+        for (uint32_t id : outputIds) {
+            flow[id] = *v++;
+            double* c = table.componentData(id);
+            for (size_t k = 1; k < width; k++) c[k - 1] = *v++;
+        }
+        if (e != head) {
+            unlink(e);
+            pushFront(e);
+        }
+        hitCount++;
+        return true;
+    }
+
+    /**
+     * @brief Store the outputs just computed for the inputs of the last recall().
+     */
+    void remember(StreamTable& table, const vector<uint32_t>& outputIds) {
+        uint32_t e;
+        if (auto it = index.find(keyHash); it != index.end()) {
+            e = it->second; // same hash, other key: replace it
+            unlink(e);
+        } else if (hashes.size() < capacity) {
+            e = static_cast<uint32_t>(hashes.size());
+            hashes.push_back(0);
+            prev.push_back(None);
+            next.push_back(None);
+            keys.resize(keys.size() + keySize);
+            values.resize(values.size() + valueSize);
+        } else {
+            e = tail;
+            unlink(e);
+            index.erase(hashes[e]);
+            evictionCount++;
+        }
+        hashes[e] = keyHash;
+        index[keyHash] = e;
+        copy(key.begin(), key.end(), keys.begin() + e * keySize);
+        size_t width = 1 + table.componentCount();
+        double* v = values.data() + e * valueSize;
+        for (uint32_t id : outputIds) {
+            *v++ = table.flow(id);
+            const double* c = table.componentData(id);
+            for (size_t k = 1; k < width; k++) *v++ = c[k - 1];
+        }
+        pushFront(e);
+    }
+
+    /**
+     * @brief Forget every entry, e.g. after a parameter of the device changed. Counters are kept.
+     */
+    void clear() {
+        index.clear();
+        hashes.clear();
+        prev.clear();
+        next.clear();
+        keys.clear();
+        values.clear();
+        head = tail = None;
+    }
+
+    size_t size() const { return hashes.size(); }
+    size_t hits() const { return hitCount; }
+    size_t misses() const { return missCount; }
+    size_t evictions() const { return evictionCount; }
+
+    /**
+     * @brief Fraction of the lookups that were hits, 0 before the first lookup.
+     */
+    double hitRate() const {
+        size_t lookups = hitCount + missCount;
+        return lookups ? double(hitCount) / lookups : 0.0;
+    }
+
+    void resetCounters() { hitCount = missCount = evictionCount = 0; }
+};
+#endif // DEVICE_MEMO_CPP
@@ -0,0 +1,83 @@
+#ifndef DUAL_CPP
+#define DUAL_CPP
+
+/**
+ * @file Dual.cpp
+ *
+ * @brief Dual numbers for forward-mode differentiation with respect to N parameters.
+ */
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+using namespace std;
+
+/**
+ * @struct Dual
+ * @brief A value and its derivatives with respect to N parameters.
+ *
+ * Arithmetic propagates the derivatives exactly (chain rule), one fixed-size
+ * loop over the N derivatives per operation, which the compiler vectorizes.
+ */
+template <size_t N>
+struct Dual
+{
+    double value = 0.0;
+    array<double, N> d{};   ///< Derivative with respect to every parameter.
+
+    Dual() = default;
+    Dual(double v): value(v) {}
+
+    /**
+     * @brief The parameter p itself: value v, derivative 1 with respect to p.
+     */
+    static Dual parameter(double v, size_t p) {
+        Dual x(v);
+        x.d[p] = 1.0;
+        return x;
+    }
+
+    Dual& operator+=(const Dual& o) {
+        value += o.value;
+        for (size_t i = 0; i < N; i++) d[i] += o.d[i];
+        return *this;
+    }
+    Dual& operator-=(const Dual& o) {
+        value -= o.value;
+        for (size_t i = 0; i < N; i++) d[i] -= o.d[i];
+        return *this;
+    }
+    Dual& operator*=(const Dual& o) {
+        for (size_t i = 0; i < N; i++) d[i] = d[i] * o.value + value * o.d[i];
+        value *= o.value;
+        return *this;
+    }
+    Dual& operator/=(const Dual& o) {
+        double inverse = 1.0 / o.value;
+        value *= inverse;
+        for (size_t i = 0; i < N; i++) d[i] = (d[i] - value * o.d[i]) * inverse;
+        return *this;
+    }
+
+    friend Dual operator+(Dual a, const Dual& b) { return a += b; }
+    friend Dual operator-(Dual a, const Dual& b) { return a -= b; }
+    friend Dual operator*(Dual a, const Dual& b) { return a *= b; }
+    friend Dual operator/(Dual a, const Dual& b) { return a /= b; }
+    friend Dual operator-(Dual a) {
+        a.value = -a.value;
+        for (size_t i = 0; i < N; i++) a.d[i] = -a.d[i];
+        return a;
+    }
+};
+
+/**
+ * @brief Value part of a number, for code templated on double or Dual.
+ */
+inline double valueOf(double x) { return x; }
+template <size_t N>
+double valueOf(const Dual<N>& x) { return x.value; }
+
+template <size_t N>
+Dual<N> abs(const Dual<N>& x) { return x.value < 0.0 ? -x : x; }
+#endif // DUAL_CPP
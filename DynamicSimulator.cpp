@@ -0,0 +1,393 @@
+#ifndef DYNAMIC_SIMULATOR_CPP
+#define DYNAMIC_SIMULATOR_CPP
+
+/**
+ * @file DynamicSimulator.cpp
+ *
+ * @brief Implicit, adaptive time integration of the holdups of a flowsheet.
+ */
+
+#include "Flowsheet.cpp"
+#include "SparseLU.cpp"
+#include "Tank.cpp"
+
+using namespace std;
+
+/**
+ * @struct DynamicOptions
+ * @brief Accuracy and step limits of DynamicSimulator.
+ */
+struct DynamicOptions
+{
+    double relativeTolerance = 1e-6;
+    double absoluteTolerance = 1e-9;
+    double initialStep = 1e-4;  ///< First step size tried.
+    double minStep = 1e-12;     ///< Below this the integration fails.
+    double maxStep = 1e30;
+    int maxNewtonIterations = 4;
+};
+
+/**
+ * @struct DynamicStats
+ * @brief Work done by DynamicSimulator since its creation.
+ */
+struct DynamicStats
+{
+    size_t steps = 0;
+    size_t rejectedSteps = 0;
+    size_t residuals = 0;      ///< Flowsheet evaluations.
+    size_t jacobians = 0;
+    size_t factorizations = 0;
+    size_t newtonFailures = 0;
+};
+
+/**
+ * @class DynamicSimulator
+ * @brief Integrates the states of the dynamic devices of a flowsheet (see Device::stateCount()).
+ *
+ * The residual f(x) writes the states, evaluates the flowsheet (the dynamic
+ * devices compute their outputs from their state, the algebraic ones follow,
+ * recycle loops included) and reads every state derivative. Steps use
+ * variable-step BDF (order 1 to start, then order 2) solved by a modified
+ * Newton iteration on I - gamma J; the local error is estimated against an
+ * explicit predictor of the same order and drives the step size.
+ *
+ * The Jacobian J is sparse: the derivative of a device depends only on its own
+ * states and on those of the dynamic devices upstream of it through algebraic
+ * devices. That pattern is found from the device graph, the columns are
+ * grouped so that no two columns of a group share a row, and each group
+ * costs one residual: J is built with as many residuals as groups, not as
+ * states. J and the factors of I - gamma J are reused over steps while
+ * Newton converges.
+ *
+ * Residuals can run the flowsheet on a thread pool (Flowsheet::evaluateParallel()).
+ */
+class DynamicSimulator
+{
+private:
+    Flowsheet& sheet;
+    DynamicOptions options;
+    ThreadPool* pool = nullptr;
+    unsigned long planVersion = ~0ul;
+    vector<Device*> dynamic;         ///< Devices with states.
+    vector<size_t> offset;           ///< First state of every dynamic device (size + 1).
+    vector<uint32_t> rowStart, cols; ///< Pattern of J by rows (diagonal included).
+    vector<uint32_t> colorOf;        ///< Column group of every state.
+    size_t colors = 0;
+    vector<double> jacobian;         ///< Values of J on the pattern.
+    vector<double> newtonMatrix;     ///< Values of I - gamma J on the pattern.
+    SparseLU lu;
+    double factoredGamma = 0.0;
+    bool jacobianCurrent = false;    ///< J evaluated at the last accepted point.
+    bool haveJacobian = false, haveFactors = false;
+    double time = 0.0;
+    double step = 0.0;
+    vector<double> x;                ///< Current state.
+    vector<double> pastX[2];         ///< States one and two steps back.
+    double pastT[2] = {0.0, 0.0};
+    size_t history = 0;              ///< Number of past points kept (0 to 2).
+    DynamicStats stats;
+
+    void rebuildPlan() {
+        const vector<Device*>& order = sheet.evaluationOrder();
+        dynamic.clear();
+        offset.assign(1, 0);
+        vector<uint32_t> dynamicIndex(order.size(), ~0u);
+        for (uint32_t p = 0; p < order.size(); p++) {
+            if (size_t n = order[p]->stateCount()) {
+                dynamicIndex[p] = static_cast<uint32_t>(dynamic.size());
+                dynamic.push_back(order[p]);
+                offset.push_back(offset.back() + n);
+            }
+        }
+
+        // Consumers of every stream of the table.
+        StreamTable& table = sheet.getTable();
+        vector<vector<uint32_t>> consumers(table.size());
+        for (uint32_t p = 0; p < order.size(); p++) {
+            if (order[p]->getTable() != &table) continue;
+            for (uint32_t id : order[p]->getInputIds()) consumers[id].push_back(p);
+        }
+
+        // Dynamic devices reached from each dynamic device through algebraic ones.
+        size_t nd = dynamic.size();
+        vector<vector<uint32_t>> dependsOn(nd); // device -> devices whose states it reads
+        vector<uint32_t> seen(order.size(), ~0u), stack;
+        for (uint32_t j = 0; j < nd; j++) {
+            dependsOn[j].push_back(j);
+            stack.clear();
+            for (uint32_t id : dynamic[j]->getOutputIds()) {
+                for (uint32_t c : consumers[id]) stack.push_back(c);
+            }
+            while (!stack.empty()) {
+                uint32_t p = stack.back();
+                stack.pop_back();
+                if (seen[p] == j) continue;
+                seen[p] = j;
+                if (dynamicIndex[p] != ~0u) {
+                    if (dynamicIndex[p] != j) dependsOn[dynamicIndex[p]].push_back(j);
+                    continue;
+                }
+                for (uint32_t id : order[p]->getOutputIds()) {
+                    for (uint32_t c : consumers[id]) stack.push_back(c);
+                }
+            }
+        }
+
+        size_t n = offset.back();
+        rowStart.assign(1, 0);
+        cols.clear();
+        for (uint32_t i = 0; i < nd; i++) {
+            sort(dependsOn[i].begin(), dependsOn[i].end());
+            for (size_t r = offset[i]; r < offset[i + 1]; r++) {
+                for (uint32_t j : dependsOn[i]) {
+                    for (size_t c = offset[j]; c < offset[j + 1]; c++) cols.push_back(static_cast<uint32_t>(c));
+                }
+                rowStart.push_back(static_cast<uint32_t>(cols.size()));
+            }
+        }
+
+        // Greedy column grouping: columns sharing a row get different groups.
+        vector<vector<uint32_t>> rowsOf(n);
+        for (uint32_t r = 0; r < n; r++) {
+            for (uint32_t k = rowStart[r]; k < rowStart[r + 1]; k++) rowsOf[cols[k]].push_back(r);
+        }
+        colorOf.assign(n, ~0u);
+        colors = 0;
+        vector<uint32_t> usedBy(n + 1, ~0u);
+        for (uint32_t c = 0; c < n; c++) {
+            for (uint32_t r : rowsOf[c]) {
+                for (uint32_t k = rowStart[r]; k < rowStart[r + 1]; k++) {
+                    uint32_t other = colorOf[cols[k]];
+                    if (other != ~0u) usedBy[other] = c;
+                }
+            }
+            uint32_t color = 0;
+            while (usedBy[color] == c) color++;
+            colorOf[c] = color;
+            colors = max<size_t>(colors, color + 1);
+        }
+
+        jacobian.assign(cols.size(), 0.0);
+        newtonMatrix.assign(cols.size(), 0.0);
+        x.assign(n, 0.0);
+        for (size_t i = 0; i < nd; i++) dynamic[i]->readState(x.data() + offset[i]);
+        history = 0;
+        haveJacobian = haveFactors = jacobianCurrent = false;
+        planVersion = sheet.getWiringVersion();
+    }
+
+    /**
+     * @brief Derivatives of every state at the given states.
+     */
+    void residual(const double* state, double* dxdt) {
+        for (size_t i = 0; i < dynamic.size(); i++) dynamic[i]->writeState(state + offset[i]);
+        if (pool) sheet.evaluateParallel(*pool);
+        else sheet.evaluate();
+        for (size_t i = 0; i < dynamic.size(); i++) dynamic[i]->stateDerivatives(dxdt + offset[i]);
+        stats.residuals++;
+    }
+
+    /**
+     * @brief Finite-difference J at state, one residual per column group.
+     */
+    void evaluateJacobian(const double* state, const double* f0) {
+        size_t n = x.size();
+        vector<double> shifted(state, state + n), f(n), delta(n);
+        for (size_t c = 0; c < n; c++) delta[c] = 1e-7 * max(abs(state[c]), 1.0);
+        for (uint32_t color = 0; color < colors; color++) {
+            for (size_t c = 0; c < n; c++) shifted[c] = colorOf[c] == color ? state[c] + delta[c] : state[c];
+            residual(shifted.data(), f.data());
+            for (uint32_t r = 0; r < n; r++) {
+                for (uint32_t k = rowStart[r]; k < rowStart[r + 1]; k++) {
+                    uint32_t c = cols[k];
+                    if (colorOf[c] == color) jacobian[k] = (f[r] - f0[r]) / delta[c];
+                }
+            }
+        }
+        stats.jacobians++;
+        haveJacobian = true;
+        haveFactors = false;
+    }
+
+    void factorNewtonMatrix(double gamma) {
+        size_t n = x.size();
+        for (uint32_t r = 0; r < n; r++) {
+            for (uint32_t k = rowStart[r]; k < rowStart[r + 1]; k++) {
+                newtonMatrix[k] = (cols[k] == r ? 1.0 : 0.0) - gamma * jacobian[k];
+            }
+        }
+        lu.factor(n, rowStart.data(), cols.data(), newtonMatrix.data());
+        factoredGamma = gamma;
+        haveFactors = true;
+        stats.factorizations++;
+    }
+
+    /**
+     * @brief Weighted RMS norm of v relative to the tolerances at state.
+     */
+    double norm(const vector<double>& v, const vector<double>& state) const {
+        if (v.empty()) return 0.0;
+        double sum = 0.0;
+        for (size_t i = 0; i < v.size(); i++) {
+            double w = options.absoluteTolerance + options.relativeTolerance * abs(state[i]);
+            sum += (v[i] / w) * (v[i] / w);
+        }
+        return sqrt(sum / v.size());
+    }
+
+    /**
+     * @brief Solve x = psi + gamma f(x) by modified Newton from the predictor.
+     * @return Whether Newton converged; xNew holds the solution.
+     */
+    bool newton(const vector<double>& psi, double gamma, vector<double>& xNew, vector<double>& f) {
+        size_t n = x.size();
+        vector<double> dx(n);
+        double previous = 0.0;
+        for (int it = 0; it < options.maxNewtonIterations; it++) {
+            residual(xNew.data(), f.data());
+            for (size_t i = 0; i < n; i++) dx[i] = psi[i] + gamma * f[i] - xNew[i];
+            lu.solve(dx.data());
+            for (size_t i = 0; i < n; i++) xNew[i] += dx[i];
+            double size = norm(dx, xNew);
+            if (size <= 0.01) return true;
+            if (it > 0 && size > 0.9 * previous) return false; // diverging or too slow
+            previous = size;
+        }
+        return false;
+    }
+
+public:
+    explicit DynamicSimulator(Flowsheet& fs, DynamicOptions opts = DynamicOptions())
+        : sheet(fs), options(opts), step(opts.initialStep) {}
+
+    /**
+     * @brief Evaluate residuals on a thread pool, or serially with nullptr.
+     */
+    void setThreadPool(ThreadPool* p) { pool = p; }
+
+    double getTime() const { return time; }
+    void setTime(double t) { time = t; history = 0; }
+    const DynamicStats& getStats() const { return stats; }
+
+    /**
+     * @brief Number of states integrated.
+     */
+    size_t stateCount() {
+        if (planVersion != sheet.getWiringVersion()) rebuildPlan();
+        return x.size();
+    }
+
+    /**
+     * @brief Number of structural nonzeros of the Jacobian.
+     */
+    size_t jacobianNonZeros() {
+        stateCount();
+        return cols.size();
+    }
+
+    /**
+     * @brief Number of column groups, i.e. residuals per Jacobian evaluation.
+     */
+    size_t jacobianColors() {
+        stateCount();
+        return colors;
+    }
+
+    /**
+     * @brief Integrate up to a time, leaving the flowsheet evaluated at the final state.
+     *
+     * Feeds may be changed between calls. The states are read back from the
+     * devices after a rewiring; otherwise the integration continues from the
+     * last state and step size, and a setHoldup() made meanwhile is ignored.
+     *
+     * @throws DeviceException StepTooSmall if the step falls below DynamicOptions::minStep.
+     */
+    void advance(double endTime) {
+        if (planVersion != sheet.getWiringVersion()) rebuildPlan();
+        size_t n = x.size();
+        vector<double> f0(n), f(n), psi(n), predicted(n), xNew(n), difference(n);
+        residual(x.data(), f0.data());
+        jacobianCurrent = false;
+
+        while (time < endTime && n > 0) {
+            double h = min({step, options.maxStep, endTime - time});
+            if (endTime - time - h < 1e-12 * max(1.0, abs(endTime))) h = endTime - time;
+
+            // Coefficients and predictor of the step.
+            int order = history >= 2 ? 2 : 1;
+            double gamma, errorConstant;
+            if (order == 1) {
+                gamma = h;
+                for (size_t i = 0; i < n; i++) psi[i] = x[i];
+                if (history == 0) {
+                    for (size_t i = 0; i < n; i++) predicted[i] = x[i] + h * f0[i];
+                    errorConstant = 0.5;
+                } else {
+                    double r = h / (time - pastT[0]);
+                    for (size_t i = 0; i < n; i++) predicted[i] = x[i] + r * (x[i] - pastX[0][i]);
+                    errorConstant = 1.0 / 3.0;
+                }
+            } else {
+                double w = h / (time - pastT[0]);
+                gamma = h * (1 + w) / (1 + 2 * w);
+                double a = (1 + w) * (1 + w) / (1 + 2 * w), b = w * w / (1 + 2 * w);
+                for (size_t i = 0; i < n; i++) psi[i] = a * x[i] - b * pastX[0][i];
+                // Quadratic through the last three points, evaluated at time + h.
+                double t0 = pastT[1], t1 = pastT[0], t2 = time, t = time + h;
+                double l0 = (t - t1) * (t - t2) / ((t0 - t1) * (t0 - t2));
+                double l1 = (t - t0) * (t - t2) / ((t1 - t0) * (t1 - t2));
+                double l2 = (t - t0) * (t - t1) / ((t2 - t0) * (t2 - t1));
+                for (size_t i = 0; i < n; i++) predicted[i] = l0 * pastX[1][i] + l1 * pastX[0][i] + l2 * x[i];
+                errorConstant = 2.0 / 11.0;
+            }
+
+            if (!haveJacobian) {
+                evaluateJacobian(x.data(), f0.data());
+                jacobianCurrent = true;
+            }
+            if (!haveFactors || abs(gamma - factoredGamma) > 0.3 * factoredGamma) factorNewtonMatrix(gamma);
+
+            xNew = predicted;
+            if (!newton(psi, gamma, xNew, f)) {
+                stats.newtonFailures++;
+                if (!jacobianCurrent) {
+                    evaluateJacobian(x.data(), f0.data());
+                    jacobianCurrent = true;
+                } else {
+                    step = h * 0.25;
+                    haveFactors = false;
+                    if (step < options.minStep) throw DeviceException(DeviceError::StepTooSmall);
+                }
+                continue;
+            }
+
+            for (size_t i = 0; i < n; i++) difference[i] = xNew[i] - predicted[i];
+            double error = errorConstant * norm(difference, xNew);
+            double factor = error > 0.0 ? 0.9 * pow(error, -1.0 / (order + 1)) : 2.0;
+            if (error > 1.0) {
+                stats.rejectedSteps++;
+                step = h * max(0.2, factor);
+                if (step < options.minStep) throw DeviceException(DeviceError::StepTooSmall);
+                continue;
+            }
+
+            pastX[1].swap(pastX[0]);
+            pastT[1] = pastT[0];
+            pastX[0] = x;
+            pastT[0] = time;
+            history = min<size_t>(history + 1, 2);
+            x = xNew;
+            f0 = f; // derivative at the last Newton iterate, close enough for the next predictor
+            time += h;
+            step = h * min(2.0, max(0.2, factor));
+            jacobianCurrent = false;
+            stats.steps++;
+        }
+
+        for (size_t i = 0; i < dynamic.size(); i++) dynamic[i]->writeState(x.data() + offset[i]);
+        if (pool) sheet.evaluateParallel(*pool);
+        else sheet.evaluate();
+    }
+};
+#endif // DYNAMIC_SIMULATOR_CPP
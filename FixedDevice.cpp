@@ -0,0 +1,208 @@
+#ifndef FIXED_DEVICE_CPP
+#define FIXED_DEVICE_CPP
+
+/**
+ * @file FixedDevice.cpp
+ *
+ * @brief Devices with a port count fixed at compile time.
+ */
+
+#include "Separator.cpp"
+#include <array>
+#include <bitset>
+
+using namespace std;
+
+/**
+ * @class FixedDevice
+ * @brief Base of the devices with NIn inputs and NOut outputs known at compile time.
+ *
+ * Ports are std::arrays of stream indices, so a fixed device holds no heap
+ * memory and no virtual table. Connecting a port outside of the range is a
+ * compile-time error with connectInput<I>() / connectOutput<J>(). Fixed devices
+ * work on the mass flows of a StreamTable (component flows are not handled).
+ */
+template <size_t NIn, size_t NOut>
+class FixedDevice
+{
+    static_assert(NIn > 0, "a device needs at least one input");
+    static_assert(NOut > 0, "a device needs at least one output");
+
+protected:
+    StreamTable* table = nullptr;  ///< Table holding the state of every connected stream.
+    array<uint32_t, NIn> in{};     ///< Table indices of the input streams.
+    array<uint32_t, NOut> out{};   ///< Table indices of the output streams.
+    bitset<NIn + NOut> connected;  ///< Ports connected so far, inputs first.
+
+    void bindTable(const Stream& s) {
+        if (!table) table = &s.getTable();
+        else if (table != &s.getTable()) throw DeviceException(DeviceError::DifferentTables);
+    }
+
+public:
+    static constexpr size_t inputCount = NIn;
+    static constexpr size_t outputCount = NOut;
+
+    /**
+     * @brief Connect a stream to input port I.
+     */
+    template <size_t I> requires (I < NIn)
+    void connectInput(const Stream& s) {
+        bindTable(s);
+        in[I] = s.getIndex();
+        connected.set(I);
+    }
+
+    /**
+     * @brief Connect a stream to output port J.
+     */
+    template <size_t J> requires (J < NOut)
+    void connectOutput(const Stream& s) {
+        bindTable(s);
+        out[J] = s.getIndex();
+        connected.set(NIn + J);
+    }
+
+    /**
+     * @brief Connect every input and output at once, in port order.
+     */
+    void connect(const array<const Stream*, NIn>& inputs, const array<const Stream*, NOut>& outputs) {
+        for (size_t i = 0; i < NIn; i++) {
+            bindTable(*inputs[i]);
+            in[i] = inputs[i]->getIndex();
+        }
+        for (size_t j = 0; j < NOut; j++) {
+            bindTable(*outputs[j]);
+            out[j] = outputs[j]->getIndex();
+        }
+        connected.set();
+    }
+
+    /**
+     * @brief Whether every port was connected.
+     */
+    bool portsComplete() const { return connected.all(); }
+
+    StreamTable* getTable() const { return table; }
+    const array<uint32_t, NIn>& getInputIds() const { return in; }
+    const array<uint32_t, NOut>& getOutputIds() const { return out; }
+};
+
+/**
+ * @class FixedMixer
+ * @brief Mixer with NIn inputs, sharing the summed flow equally between NOut outputs.
+ *
+ * Sums with compensation like Mixer, so both agree to the last bit.
+ */
+template <size_t NIn, size_t NOut = 1>
+class FixedMixer : public FixedDevice<NIn, NOut>
+{
+public:
+    static constexpr DeviceKind kind = DeviceKind::Mixer;
+
+    void updateOutputs(double* flow) const {
+        NeumaierSum sum;
+        for (size_t i = 0; i < NIn; i++) sum.add(flow[this->in[i]]);
+        double share = sum.result() / NOut;
+        for (size_t j = 0; j < NOut; j++) flow[this->out[j]] = share;
+    }
+
+    void updateOutputs() const { updateOutputs(this->table->data()); }
+};
+
+/**
+ * @class FixedSplitter
+ * @brief Single-input device sending a fixed fraction of its input to each of NOut outputs.
+ */
+template <size_t NOut>
+class FixedSplitter : public FixedDevice<1, NOut>
+{
+private:
+    array<double, NOut> fractions; ///< Fraction of the input sent to every output.
+
+public:
+    static constexpr DeviceKind kind = DeviceKind::Separator;
+
+    /**
+     * @brief Create a splitter with equal fractions.
+     */
+    FixedSplitter() { fractions.fill(1.0 / NOut); }
+
+    /**
+     * @brief Create a splitter with given fractions, normalized to sum to one.
+     * @throws DeviceException SplitFractions, as normalizeSplit().
+     */
+    explicit FixedSplitter(const array<double, NOut>& f) {
+        vector<double> normalized = normalizeSplit(vector<double>(f.begin(), f.end()));
+        copy(normalized.begin(), normalized.end(), fractions.begin());
+    }
+
+    const array<double, NOut>& getFractions() const { return fractions; }
+
+    void updateOutputs(double* flow) const {
+        double inputMass = flow[this->in[0]];
+        for (size_t j = 0; j < NOut; j++) flow[this->out[j]] = inputMass * fractions[j];
+    }
+
+    void updateOutputs() const { updateOutputs(this->table->data()); }
+};
+
+/**
+ * @brief Fixed counterpart of Separator: one input, two equal outputs.
+ */
+using FixedSeparator = FixedSplitter<2>;
+
+/**
+ * @class FixedReactor
+ * @brief Fixed counterpart of Reactor: one input split equally between NOut outputs.
+ */
+template <size_t NOut = 1>
+class FixedReactor : public FixedDevice<1, NOut>
+{
+public:
+    static constexpr DeviceKind kind = DeviceKind::Reactor;
+
+    void updateOutputs(double* flow) const {
+        double inputMass = flow[this->in[0]];
+        for (size_t j = 0; j < NOut; j++) flow[this->out[j]] = inputMass * (1.0 / NOut);
+    }
+
+    void updateOutputs() const { updateOutputs(this->table->data()); }
+};
+
+/**
+ * @class FixedDeviceFarm
+ * @brief Contiguous array of fixed devices of one type, swept without virtual dispatch.
+ *
+ * The devices must be connected to the same table and must not read each
+ * other's outputs (e.g. one dependency level).
+ */
+template <class T>
+class FixedDeviceFarm
+{
+private:
+    vector<T> units;
+
+public:
+    /**
+     * @brief Append a device; its ports can be connected through the returned reference.
+     *
+     * The reference is invalidated by the next add().
+     */
+    template <class... Args>
+    T& add(Args&&... args) { return units.emplace_back(std::forward<Args>(args)...); }
+
+    void reserve(size_t n) { units.reserve(n); }
+    size_t size() const { return units.size(); }
+    T& operator[](size_t i) { return units[i]; }
+
+    /**
+     * @brief Evaluate every device of the farm.
+     */
+    void updateOutputs() {
+        if (units.empty()) return;
+        double* flow = units.front().getTable()->data();
+        for (const T& u : units) u.updateOutputs(flow);
+    }
+};
+#endif // FIXED_DEVICE_CPP
@@ -0,0 +1,755 @@
+#ifndef FLOWSHEET_CPP
+#define FLOWSHEET_CPP
+
+/**
+ * @file Flowsheet.cpp
+ *
+ * @brief A container that owns devices and streams and evaluates them in dependency order.
+ */
+
+#include "Separator.cpp"
+#include "RecycleSolver.cpp"
+#include "BatchKernels.cpp"
+#include "Arena.cpp"
+#include "ThreadPool.cpp"
+#include "FlowsheetFile.cpp"
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+using namespace std;
+
+/**
+ * @class Flowsheet
+ * @brief Owns a set of devices and the streams wiring them together.
+ *
+ * The device dependency graph is derived from the inputs/outputs of every device:
+ * a device depends on the device producing any of its input streams. The
+ * topological order is cached and recomputed only after the wiring changes, so
+ * a steady-state evaluate() is a flat loop over the cached order.
+ *
+ * Recycle loops are detected and evaluated as a block by a RecycleSolver,
+ * which converges their tear streams.
+ *
+ * Streams created with addStream() keep their state in the flowsheet's own
+ * StreamTable. They and the devices created with addDevice<T>() are placed in
+ * the flowsheet's Arena and handed out as non-owning shared pointers: no
+ * per-object heap allocation or reference counting, and everything is released
+ * at once with the flowsheet. They must not be used after the flowsheet is
+ * destroyed.
+ */
+class Flowsheet
+{
+public:
+    /**
+     * @brief A unit of evaluation: one device, or the devices of one recycle loop.
+     */
+    struct Block {
+        uint32_t begin, end;         ///< Range of the block in order.
+        uint32_t tearBegin, tearEnd; ///< Range of the tear streams of a recycle loop in tears.
+    };
+
+private:
+    Arena arena;                         ///< Storage of the streams and devices created by the flowsheet.
+    StreamTable table;                   ///< State of the streams created by the flowsheet.
+    vector<shared_ptr<Stream>> streams;  ///< Streams owned by the flowsheet.
+    vector<shared_ptr<Device>> devices;  ///< Devices owned by the flowsheet, in insertion order.
+    vector<Device*> order;               ///< Cached topological evaluation order, block by block.
+    vector<Block> blocks;                ///< Blocks in topological order.
+    vector<uint32_t> blockOf;            ///< Block of every position in order.
+    vector<TearStream> tears;            ///< Tear streams of all recycle loops.
+    bool hasRecycle = false;             ///< Whether any block is a recycle loop.
+    vector<uint32_t> levelBlocks;        ///< Blocks grouped by dependency level (wavefront).
+    vector<size_t> levelStart;           ///< Offsets of every level in levelBlocks, plus the end.
+    vector<BatchPlan> levelPlans;        ///< Batched evaluation plan of the single-device blocks of every level.
+    vector<vector<uint32_t>> levelLoops; ///< Recycle blocks of every level.
+    unsigned long planVersion = ~0ul;    ///< Wiring version the batch plans were built for.
+    RecycleSolver solver;                ///< Converges recycle loops during serial evaluation.
+    int lastSweeps = 0;                  ///< Recycle sweeps done by the last evaluation.
+    vector<uint32_t> consumerStart;      ///< CSR offsets of consumers per stream of the own table.
+    vector<uint32_t> consumerPos;        ///< Positions in order of the devices consuming each stream.
+    vector<uint8_t> queued;              ///< Whether a position is already scheduled by recomputeDirty().
+    vector<uint32_t> dirtyHeap;          ///< Min-heap of scheduled positions in order.
+    vector<uint32_t> changedScratch;     ///< Reused buffer for the table change log.
+    vector<double> outputScratch;        ///< Reused buffer for the previous output values.
+    unsigned long wiringVersion = 0;     ///< Bumped by devices whenever a port is connected.
+    unsigned long orderVersion = ~0ul;   ///< Wiring version the cached order was built for.
+    int streamCounter = 0;               ///< Used to generate unique stream names.
+
+    /**
+     * @brief Rebuild the cached evaluation order.
+     *
+     * Devices are grouped into blocks: a single device, or the devices of one
+     * recycle loop (strongly connected component, Tarjan's algorithm). Blocks
+     * are emitted in topological order (Kahn's algorithm on the condensed
+     * graph), taking ready blocks in insertion order, which keeps the order
+     * deterministic for a given wiring. Inside a recycle block, the streams of
+     * the DFS back edges are torn and the remaining devices are ordered
+     * topologically.
+     *
+     * The flowsheet is validated first, once per wiring version, since the
+     * device updates do not check their ports.
+     *
+     * @throws DeviceException with the code of the first problem found by validate().
+     */
+    void rebuildOrder() {
+        vector<Diagnostic> found = validate();
+        if (!found.empty()) throw DeviceException(found.front().code);
+
+        size_t n = devices.size();
+        unordered_map<const Stream*, size_t> producer;
+        for (size_t d = 0; d < n; d++) {
+            for (const auto& s : devices[d]->getOutputs()) producer.emplace(s.get(), d);
+        }
+
+        // Edges producer -> consumer, labelled with the stream carrying them.
+        vector<vector<pair<size_t, const Stream*>>> consumers(n);
+        for (size_t d = 0; d < n; d++) {
+            for (const auto& s : devices[d]->getInputs()) {
+                auto it = producer.find(s.get());
+                if (it == producer.end()) continue; // feed stream
+                consumers[it->second].emplace_back(d, s.get());
+            }
+        }
+
+        vector<size_t> comp = stronglyConnectedComponents(consumers);
+        size_t compCount = 0;
+        for (size_t c : comp) compCount = max(compCount, c + 1);
+
+        // Members of every component, in insertion order.
+        vector<vector<size_t>> members(compCount);
+        for (size_t d = 0; d < n; d++) members[comp[d]].push_back(d);
+
+        // Kahn's algorithm on the condensed graph; components are ranked by
+        // their first member so that a DAG keeps its insertion order.
+        vector<size_t> pending(compCount, 0);
+        for (size_t d = 0; d < n; d++) {
+            for (auto& e : consumers[d]) if (comp[e.first] != comp[d]) pending[comp[e.first]]++;
+        }
+        vector<size_t> byFirst(compCount);
+        for (size_t c = 0; c < compCount; c++) byFirst[c] = c;
+        sort(byFirst.begin(), byFirst.end(), [&](size_t a, size_t b) { return members[a][0] < members[b][0]; });
+        vector<size_t> ready;
+        for (size_t c : byFirst) if (pending[c] == 0) ready.push_back(c);
+
+        order.clear();
+        blocks.clear();
+        tears.clear();
+        blockOf.clear();
+        hasRecycle = false;
+        vector<size_t> blockLevel;
+        vector<size_t> compBlock(compCount);
+        for (size_t head = 0; head < ready.size(); head++) {
+            size_t c = ready[head];
+            Block blk;
+            blk.begin = static_cast<uint32_t>(order.size());
+            blk.tearBegin = static_cast<uint32_t>(tears.size());
+            bool loop = members[c].size() > 1;
+            for (auto& e : consumers[members[c][0]]) loop = loop || e.first == members[c][0];
+            if (loop) orderLoop(members[c], comp, consumers);
+            else order.push_back(devices[members[c][0]].get());
+            blk.end = static_cast<uint32_t>(order.size());
+            blk.tearEnd = static_cast<uint32_t>(tears.size());
+            hasRecycle = hasRecycle || loop;
+
+            size_t lvl = 0;
+            for (size_t d : members[c]) {
+                for (const auto& s : devices[d]->getInputs()) {
+                    auto it = producer.find(s.get());
+                    if (it != producer.end() && comp[it->second] != c) lvl = max(lvl, blockLevel[compBlock[comp[it->second]]] + 1);
+                }
+            }
+            compBlock[c] = blocks.size();
+            blockLevel.push_back(lvl);
+            blocks.push_back(blk);
+            blockOf.resize(order.size(), static_cast<uint32_t>(blocks.size() - 1));
+
+            for (size_t d : members[c]) {
+                for (auto& e : consumers[d]) {
+                    if (comp[e.first] != c && --pending[comp[e.first]] == 0) ready.push_back(comp[e.first]);
+                }
+            }
+        }
+
+        buildConsumerIndex();
+
+        // Counting sort of the blocks by level keeps the topological order within a level.
+        size_t levelCount = 0;
+        for (size_t l : blockLevel) levelCount = max(levelCount, l + 1);
+        levelStart.assign(levelCount + 1, 0);
+        for (size_t l : blockLevel) levelStart[l + 1]++;
+        for (size_t l = 0; l < levelCount; l++) levelStart[l + 1] += levelStart[l];
+        levelBlocks.assign(blocks.size(), 0);
+        vector<size_t> fill(levelStart.begin(), levelStart.end() - 1);
+        for (size_t b = 0; b < blocks.size(); b++) levelBlocks[fill[blockLevel[b]]++] = static_cast<uint32_t>(b);
+
+        orderVersion = wiringVersion;
+    }
+
+    /**
+     * @brief Tarjan's strongly connected components, iterative to survive long chains.
+     * @return The component of every device.
+     */
+    static vector<size_t> stronglyConnectedComponents(const vector<vector<pair<size_t, const Stream*>>>& consumers) {
+        size_t n = consumers.size();
+        const size_t none = ~size_t(0);
+        vector<size_t> index(n, none), low(n, 0), comp(n, none);
+        vector<size_t> stack;
+        vector<pair<size_t, size_t>> call; // (device, next edge)
+        size_t counter = 0, compCount = 0;
+        for (size_t root = 0; root < n; root++) {
+            if (index[root] != none) continue;
+            index[root] = low[root] = counter++;
+            stack.push_back(root);
+            call.emplace_back(root, 0);
+            while (!call.empty()) {
+                size_t v = call.back().first;
+                size_t e = call.back().second;
+                if (e < consumers[v].size()) {
+                    call.back().second++;
+                    size_t w = consumers[v][e].first;
+                    if (index[w] == none) {
+                        index[w] = low[w] = counter++;
+                        stack.push_back(w);
+                        call.emplace_back(w, 0);
+                    } else if (comp[w] == none) {
+                        low[v] = min(low[v], index[w]);
+                    }
+                    continue;
+                }
+                if (low[v] == index[v]) {
+                    size_t w;
+                    do {
+                        w = stack.back();
+                        stack.pop_back();
+                        comp[w] = compCount;
+                    } while (w != v);
+                    compCount++;
+                }
+                call.pop_back();
+                if (!call.empty()) low[call.back().first] = min(low[call.back().first], low[v]);
+            }
+        }
+        return comp;
+    }
+
+    /**
+     * @brief Choose the tear streams of a recycle loop and append its devices to the order.
+     * @param loop Devices of the loop, in insertion order.
+     */
+    void orderLoop(const vector<size_t>& loop, const vector<size_t>& comp,
+                   const vector<vector<pair<size_t, const Stream*>>>& consumers) {
+        size_t c = comp[loop[0]];
+        unordered_map<size_t, int> state; // 1 on the DFS stack, 2 done
+        vector<const Stream*> torn;
+        vector<pair<size_t, size_t>> call{{loop[0], 0}};
+        state[loop[0]] = 1;
+        while (!call.empty()) {
+            size_t v = call.back().first;
+            size_t e = call.back().second;
+            if (e == consumers[v].size()) {
+                state[v] = 2;
+                call.pop_back();
+                continue;
+            }
+            call.back().second++;
+            auto [w, s] = consumers[v][e];
+            if (comp[w] != c) continue;
+            if (state[w] == 1) {
+                if (find(torn.begin(), torn.end(), s) == torn.end()) torn.push_back(s);
+            } else if (state[w] == 0) {
+                state[w] = 1;
+                call.emplace_back(w, 0);
+            }
+        }
+
+        auto isTorn = [&](const Stream* s) { return find(torn.begin(), torn.end(), s) != torn.end(); };
+        unordered_map<size_t, size_t> pending;
+        for (size_t d : loop) {
+            for (auto& e : consumers[d]) if (comp[e.first] == c && !isTorn(e.second)) pending[e.first]++;
+        }
+        vector<size_t> ready;
+        for (size_t d : loop) if (pending[d] == 0) ready.push_back(d);
+        for (size_t head = 0; head < ready.size(); head++) {
+            size_t d = ready[head];
+            order.push_back(devices[d].get());
+            for (auto& e : consumers[d]) {
+                if (comp[e.first] == c && !isTorn(e.second) && --pending[e.first] == 0) ready.push_back(e.first);
+            }
+        }
+        for (const Stream* s : torn) tears.push_back(TearStream{&s->getTable(), s->getIndex()});
+    }
+
+    /**
+     * @brief Rebuild the batched evaluation plans, one per dependency level.
+     */
+    void rebuildPlans() {
+        levelPlans.clear();
+        levelLoops.assign(levelStart.size() - 1, {});
+        for (size_t l = 0; l + 1 < levelStart.size(); l++) {
+            vector<Device*> single;
+            for (size_t i = levelStart[l]; i < levelStart[l + 1]; i++) {
+                const Block& blk = blocks[levelBlocks[i]];
+                if (blk.tearBegin == blk.tearEnd) single.push_back(order[blk.begin]);
+                else levelLoops[l].push_back(levelBlocks[i]);
+            }
+            levelPlans.emplace_back(single, &table);
+        }
+        planVersion = orderVersion;
+    }
+
+    /**
+     * @brief Evaluate one block: a single device, or a recycle loop converged to tolerance.
+     * @return Number of sweeps done.
+     * @throws DeviceException NotConverged if the loop did not converge.
+     */
+    int evaluateBlock(const Block& blk, RecycleSolver& loopSolver) {
+        if (blk.tearBegin == blk.tearEnd) {
+            order[blk.begin]->update();
+            return 1;
+        }
+        PROFILE_START(start);
+        int sweeps = loopSolver.solve(order.data() + blk.begin, blk.end - blk.begin,
+                                      tears.data() + blk.tearBegin, blk.tearEnd - blk.tearBegin);
+        PROFILE_RECYCLE(sweeps, start);
+        if (sweeps < 0) throw DeviceException(DeviceError::NotConverged);
+        return sweeps;
+    }
+
+    /**
+     * @brief Build the stream-to-consumer index used by recomputeDirty().
+     *
+     * Only streams of the flowsheet's own table are tracked.
+     */
+    void buildConsumerIndex() {
+        consumerStart.assign(table.size() + 1, 0);
+        for (Device* d : order) {
+            if (d->getTable() != &table) continue;
+            for (uint32_t id : d->getInputIds()) consumerStart[id + 1]++;
+        }
+        for (size_t i = 0; i < table.size(); i++) consumerStart[i + 1] += consumerStart[i];
+        consumerPos.assign(consumerStart.back(), 0);
+        vector<uint32_t> fill(consumerStart.begin(), consumerStart.end() - 1);
+        for (size_t p = 0; p < order.size(); p++) {
+            if (order[p]->getTable() != &table) continue;
+            for (uint32_t id : order[p]->getInputIds()) consumerPos[fill[id]++] = static_cast<uint32_t>(p);
+        }
+        queued.assign(order.size(), 0);
+    }
+
+    /**
+     * @brief Schedule the consumers of a stream for recomputation.
+     * @param id The changed stream.
+     * @param from Consumers at a position before this one are not scheduled.
+     */
+    void scheduleConsumers(uint32_t id, uint32_t from = 0) {
+        if (id + 1 >= consumerStart.size()) return; // created after the last rebuild, no consumers
+        for (uint32_t i = consumerStart[id]; i < consumerStart[id + 1]; i++) {
+            uint32_t p = consumerPos[i];
+            if (p < from || queued[p]) continue;
+            queued[p] = 1;
+            dirtyHeap.push_back(p);
+            push_heap(dirtyHeap.begin(), dirtyHeap.end(), greater<uint32_t>());
+        }
+    }
+
+public:
+    Flowsheet() = default;
+    Flowsheet(const Flowsheet&) = delete;
+    Flowsheet& operator=(const Flowsheet&) = delete;
+
+    ~Flowsheet() {
+        for (auto& d : devices) d->setWiringVersion(nullptr);
+    }
+
+    /**
+     * @brief Create a new stream owned by the flowsheet.
+     *
+     * The stream lives in the flowsheet's arena. The returned pointer does not
+     * own it (use_count() is 0, copies share no control block): it dangles once
+     * the flowsheet is destroyed, however many copies are kept.
+     *
+     * @return A non-owning shared pointer to the new stream.
+     */
+    shared_ptr<Stream> addStream() {
+        shared_ptr<Stream> s(shared_ptr<void>(), arena.create<Stream>(table, ++streamCounter));
+        streams.push_back(s);
+        return s;
+    }
+
+    /**
+     * @brief Take ownership of an existing stream.
+     * @param s The stream to add.
+     */
+    void addStream(shared_ptr<Stream> s) { streams.push_back(std::move(s)); }
+
+    /**
+     * @brief Create a device owned by the flowsheet.
+     *
+     * As with addStream(), the device lives in the arena and the returned
+     * pointer does not own it: it dangles once the flowsheet is destroyed.
+     *
+     * @param args Arguments forwarded to the device constructor.
+     * @return A non-owning shared pointer to the new device.
+     */
+    template <class T, class... Args>
+    shared_ptr<T> addDevice(Args&&... args) {
+        shared_ptr<T> d(shared_ptr<void>(), arena.create<T>(std::forward<Args>(args)...));
+        addDevice(d);
+        return d;
+    }
+
+    /**
+     * @brief Take ownership of an existing device.
+     * @param d The device to add. Its current and future wiring is tracked.
+     */
+    void addDevice(shared_ptr<Device> d) {
+        d->setWiringVersion(&wiringVersion);
+        devices.push_back(std::move(d));
+        ++wiringVersion;
+    }
+
+    /**
+     * @brief Connect a stream to a device input.
+     */
+    void connectInput(Device& d, shared_ptr<Stream> s) { d.addInput(std::move(s)); }
+
+    /**
+     * @brief Connect a stream to a device output.
+     */
+    void connectOutput(Device& d, shared_ptr<Stream> s) { d.addOutput(std::move(s)); }
+
+    /**
+     * @brief Reserve room for a number of streams created by addStream().
+     */
+    void reserveStreams(size_t n) { table.reserve(n); streams.reserve(n); }
+
+    /**
+     * @brief Reserve room for a number of devices.
+     */
+    void reserveDevices(size_t n) { devices.reserve(n); }
+
+    /**
+     * @brief Bytes of arena memory used by the streams and devices created so far.
+     */
+    size_t arenaBytes() const { return arena.bytesUsed(); }
+
+    /**
+     * @brief Set the number of components carried by the streams of the flowsheet.
+     *
+     * Existing component flows are reset to zero.
+     */
+    void setComponentCount(size_t n) {
+        table.setComponentCount(n);
+        orderVersion = ~0ul; // validated again for the new count
+        planVersion = ~0ul;
+    }
+    size_t componentCount() const { return table.componentCount(); }
+
+    StreamTable& getTable() { return table; }
+    const vector<shared_ptr<Stream>>& getStreams() const { return streams; }
+    const vector<shared_ptr<Device>>& getDevices() const { return devices; }
+
+    /**
+     * @brief Set the convergence settings of recycle loops.
+     */
+    void setConvergenceOptions(const ConvergenceOptions& o) { solver.setOptions(o); }
+    const ConvergenceOptions& getConvergenceOptions() const { return solver.getOptions(); }
+
+    /**
+     * @brief Number of recycle sweeps done by the last evaluation or recomputeDirty().
+     */
+    int getLastRecycleSweeps() const { return lastSweeps; }
+
+    /**
+     * @brief Get the tear streams chosen for the recycle loops of the current wiring.
+     */
+    const vector<TearStream>& tearStreams() {
+        evaluationOrder();
+        return tears;
+    }
+
+    /**
+     * @brief Check every device and the wiring once, before check-free evaluation.
+     *
+     * Device updates do not check their ports or parameters (unless compiled
+     * with DEVICE_CHECKED). Evaluation runs this check whenever the wiring, a
+     * sized device parameter (Reactor::setConversion(),
+     * Separator::setSplit(), Separator::setComponentSplit()) or the component
+     * count changed and throws the first problem; call it directly to get
+     * every problem.
+     *
+     * @return Every problem found, empty if the flowsheet can be evaluated.
+     */
+    vector<Diagnostic> validate() const {
+        vector<Diagnostic> found;
+        unordered_map<const Stream*, const Device*> producer;
+        for (const auto& d : devices) {
+            if (DeviceError e = d->validate(); e != DeviceError::None) found.push_back(Diagnostic{e, d.get()});
+            for (const auto& s : d->getOutputs()) {
+                auto [it, added] = producer.emplace(s.get(), d.get());
+                if (!added) found.push_back(Diagnostic{DeviceError::SeveralProducers, it->second, s->getIndex()});
+            }
+        }
+        return found;
+    }
+
+    /**
+     * @brief Get the topological evaluation order, rebuilding it if the wiring changed.
+     * @return Devices in an order where every producer precedes its consumers.
+     */
+    const vector<Device*>& evaluationOrder() {
+        if (orderVersion != wiringVersion) rebuildOrder();
+        return order;
+    }
+
+    /**
+     * @brief Get the evaluation blocks of the current wiring, in topological order.
+     *
+     * Block ranges index evaluationOrder() and tearStreams().
+     */
+    const vector<Block>& evaluationBlocks() {
+        evaluationOrder();
+        return blocks;
+    }
+
+    /**
+     * @brief Counter bumped whenever a device is added or a port is connected.
+     */
+    unsigned long getWiringVersion() const { return wiringVersion; }
+
+    /**
+     * @brief Number of dependency levels (wavefronts) in the current wiring.
+     */
+    size_t levelCount() {
+        evaluationOrder();
+        return levelStart.size() - 1;
+    }
+
+    /**
+     * @brief Get the devices of one dependency level.
+     * @param l The level, 0 being the blocks fed only by feed streams.
+     * @return The devices of the level; the devices of a recycle loop are adjacent.
+     */
+    vector<Device*> level(size_t l) {
+        evaluationOrder();
+        vector<Device*> result;
+        for (size_t i = levelStart[l]; i < levelStart[l + 1]; i++) {
+            const Block& blk = blocks[levelBlocks[i]];
+            result.insert(result.end(), order.begin() + blk.begin, order.begin() + blk.end);
+        }
+        return result;
+    }
+
+    /**
+     * @brief Evaluate every device once, in topological order, converging recycle loops.
+     */
+    void evaluate() {
+        const vector<Device*>& devs = evaluationOrder();
+        lastSweeps = 0;
+        if (!hasRecycle) {
+            for (Device* d : devs) {
+                d->update();
+            }
+        } else {
+            for (const Block& blk : blocks) {
+                if (blk.tearBegin != blk.tearEnd) lastSweeps += evaluateBlock(blk, solver);
+                else order[blk.begin]->update();
+            }
+        }
+        table.clearChanged();
+    }
+
+    /**
+     * @brief Evaluate every device once, running devices of the same type as one batch.
+     *
+     * Within every dependency level, devices are grouped by kind and port count
+     * and each group is run by a single SIMD kernel over contiguous port arrays
+     * (see BatchPlan), instead of one virtual updateOutputs() call per device.
+     * The plans are cached with the evaluation order.
+     */
+    void evaluateBatched() {
+        evaluationOrder();
+        if (planVersion != orderVersion) rebuildPlans();
+        lastSweeps = 0;
+        for (size_t l = 0; l < levelPlans.size(); l++) {
+            levelPlans[l].run();
+            for (uint32_t b : levelLoops[l]) lastSweeps += evaluateBlock(blocks[b], solver);
+        }
+        table.clearChanged();
+    }
+
+    /**
+     * @brief Evaluate every device once, running each dependency level on a thread pool.
+     *
+     * Blocks in a level only read streams produced by earlier levels and every
+     * stream has a single producer, so the result is identical to evaluate()
+     * regardless of the thread count or scheduling. A recycle loop is converged
+     * by a single task.
+     *
+     * @param pool The pool running the devices.
+     * @param grain Number of blocks per task.
+     */
+    void evaluateParallel(ThreadPool& pool, size_t grain = 64) {
+        evaluationOrder();
+        ConvergenceOptions options = solver.getOptions();
+        atomic<int> sweeps{0};
+        lastSweeps = 0;
+        for (size_t l = 0; l + 1 < levelStart.size(); l++) {
+            const uint32_t* first = levelBlocks.data() + levelStart[l];
+            pool.parallelFor(levelStart[l + 1] - levelStart[l], grain, [this, first, &options, &sweeps](size_t begin, size_t end) {
+                int taskSweeps = 0;
+                for (size_t i = begin; i < end; i++) {
+                    const Block& blk = blocks[first[i]];
+                    if (blk.tearBegin == blk.tearEnd) {
+                        order[blk.begin]->update();
+                    } else {
+                        RecycleSolver loopSolver(options);
+                        taskSweeps += evaluateBlock(blk, loopSolver);
+                    }
+                }
+                if (taskSweeps) sweeps.fetch_add(taskSweeps, memory_order_relaxed);
+            });
+        }
+        lastSweeps = sweeps.load(memory_order_relaxed);
+        table.clearChanged();
+    }
+
+    /**
+     * @brief Write a snapshot of the flowsheet to a binary file (see FlowsheetFile.cpp).
+     *
+     * The file holds the streams of the flowsheet's table with their current
+     * flows and names, and the devices in evaluation order with their wiring
+     * and parameters, ready to be mapped and evaluated by MappedFlowsheet.
+     * Only Mixer, Reactor and Separator devices connected to the flowsheet's
+     * own table can be saved.
+     *
+     * @param path The file to create or overwrite.
+     * @throws DeviceException DifferentTables or UnsupportedDevice for a device that cannot be saved.
+     */
+    void save(const string& path) {
+        evaluationOrder();
+        vector<FileDevice> fileDevices;
+        vector<uint32_t> ports;
+        vector<double> params;
+        fileDevices.reserve(order.size());
+        for (Device* d : order) {
+            if (d->getTable() != &table) throw DeviceException(DeviceError::DifferentTables);
+            FileDevice fd{static_cast<uint32_t>(d->kind()), static_cast<uint32_t>(ports.size()),
+                          static_cast<uint32_t>(d->getInputIds().size()), static_cast<uint32_t>(d->getOutputIds().size()),
+                          static_cast<uint32_t>(params.size()), 0};
+            ports.insert(ports.end(), d->getInputIds().begin(), d->getInputIds().end());
+            ports.insert(ports.end(), d->getOutputIds().begin(), d->getOutputIds().end());
+            if (auto* r = dynamic_cast<Reactor*>(d)) {
+                params.insert(params.end(), r->getConversion().begin(), r->getConversion().end());
+            } else if (auto* sep = dynamic_cast<Separator*>(d)) {
+                params.insert(params.end(), sep->getSplit().begin(), sep->getSplit().begin() + fd.outCount);
+                params.insert(params.end(), sep->getComponentSplit().begin(), sep->getComponentSplit().end());
+            } else if (!dynamic_cast<Mixer*>(d)) {
+                throw DeviceException(DeviceError::UnsupportedDevice);
+            }
+            fd.paramCount = static_cast<uint32_t>(params.size() - fd.paramBegin);
+            fileDevices.push_back(fd);
+        }
+
+        vector<FileBlock> fileBlocks;
+        fileBlocks.reserve(blocks.size());
+        for (const Block& b : blocks) fileBlocks.push_back(FileBlock{b.begin, b.end, b.tearBegin, b.tearEnd});
+        vector<uint32_t> tearIds;
+        for (const TearStream& t : tears) tearIds.push_back(t.index);
+
+        size_t n = table.size();
+        vector<uint32_t> nameIds(n);
+        for (size_t i = 0; i < n; i++) nameIds[i] = table.nameId(static_cast<uint32_t>(i));
+        const vector<string>& pool = table.getNamePool();
+        vector<uint64_t> nameOffsets{0};
+        string nameChars;
+        for (const string& name : pool) {
+            nameChars += name;
+            nameOffsets.push_back(nameChars.size());
+        }
+
+        FlowsheetFileWriter writer(n, table.componentCount());
+        writer.add(&FlowsheetFileHeader::flows, table.data(), n);
+        writer.add(&FlowsheetFileHeader::componentFlows, table.componentData(0), n * table.componentCount());
+        writer.add(&FlowsheetFileHeader::nameIds, nameIds.data(), n);
+        writer.add(&FlowsheetFileHeader::nameOffsets, nameOffsets.data(), nameOffsets.size());
+        writer.add(&FlowsheetFileHeader::nameChars, nameChars.data(), nameChars.size());
+        writer.add(&FlowsheetFileHeader::devices, fileDevices.data(), fileDevices.size());
+        writer.add(&FlowsheetFileHeader::ports, ports.data(), ports.size());
+        writer.add(&FlowsheetFileHeader::params, params.data(), params.size());
+        writer.add(&FlowsheetFileHeader::blocks, fileBlocks.data(), fileBlocks.size());
+        writer.add(&FlowsheetFileHeader::tears, tearIds.data(), tearIds.size());
+        writer.write(path);
+    }
+
+    /**
+     * @brief Re-run only the devices downstream of streams changed since the last evaluation.
+     *
+     * Streams changed through Stream::setMassFlow mark their consumers dirty.
+     * Dirty devices are re-run in topological order, and a device only dirties
+     * its own consumers when one of its outputs moved by more than the tolerance.
+     * A dirty device inside a recycle loop re-converges the whole loop.
+     * A full evaluate() is done instead when the wiring changed.
+     *
+     * @param tolerance Absolute change below which an output is considered unchanged.
+     * @return The number of devices that were re-run.
+     */
+    size_t recomputeDirty(double tolerance = 0.0) {
+        if (orderVersion != wiringVersion) {
+            evaluate();
+            return order.size();
+        }
+
+        table.takeChanged(changedScratch);
+        for (uint32_t id : changedScratch) scheduleConsumers(id);
+
+        size_t recomputed = 0;
+        lastSweeps = 0;
+        double* flow = table.data();
+        while (!dirtyHeap.empty()) {
+            pop_heap(dirtyHeap.begin(), dirtyHeap.end(), greater<uint32_t>());
+            uint32_t p = dirtyHeap.back();
+            dirtyHeap.pop_back();
+            queued[p] = 0;
+
+            const Block& blk = blocks[blockOf[p]];
+            size_t nc = table.componentCount();
+            outputScratch.clear();
+            for (uint32_t q = blk.begin; q < blk.end; q++) {
+                if (order[q]->getTable() != &table) continue;
+                for (uint32_t id : order[q]->getOutputIds()) {
+                    outputScratch.push_back(flow[id]);
+                    outputScratch.insert(outputScratch.end(), table.componentData(id), table.componentData(id) + nc);
+                }
+            }
+
+            if (blk.tearBegin == blk.tearEnd) {
+                order[p]->update();
+            } else {
+                lastSweeps += evaluateBlock(blk, solver);
+                // The whole loop is converged, drop its other scheduled devices.
+                while (!dirtyHeap.empty() && dirtyHeap.front() < blk.end) {
+                    pop_heap(dirtyHeap.begin(), dirtyHeap.end(), greater<uint32_t>());
+                    queued[dirtyHeap.back()] = 0;
+                    dirtyHeap.pop_back();
+                }
+            }
+            recomputed += blk.end - blk.begin;
+
+            size_t k = 0;
+            for (uint32_t q = blk.begin; q < blk.end; q++) {
+                if (order[q]->getTable() != &table) continue;
+                for (uint32_t id : order[q]->getOutputIds()) {
+                    bool moved = abs(flow[id] - outputScratch[k++]) > tolerance;
+                    const double* comps = table.componentData(id);
+                    for (size_t c = 0; c < nc; c++) moved = abs(comps[c] - outputScratch[k++]) > tolerance || moved;
+                    if (moved) scheduleConsumers(id, blk.end);
+                }
+            }
+        }
+        return recomputed;
+    }
+};
+#endif // FLOWSHEET_CPP
@@ -0,0 +1,143 @@
+#ifndef FLOWSHEET_FILE_CPP
+#define FLOWSHEET_FILE_CPP
+
+/**
+ * @file FlowsheetFile.cpp
+ *
+ * @brief Layout of the binary flowsheet file, written by Flowsheet::save() and mapped by MappedFlowsheet.
+ */
+
+#include "DeviceError.cpp"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * The file is a fixed header followed by sections of plain arrays, each one
+ * starting at a multiple of FlowsheetFileAlign bytes so that it can be used
+ * in place once the file is mapped. All values are little-endian.
+ *
+ *   flows           double[streamCount]            mass flow of every stream
+ *   componentFlows  double[streamCount * components]
+ *   nameIds         uint32[streamCount]            StreamTable::nameId() of every stream
+ *   nameOffsets     uint64[namePool + 1]           offsets of the pooled names in nameChars
+ *   nameChars       char[]                         pooled names, not null terminated
+ *   devices         FileDevice[deviceCount]        in evaluation order
+ *   ports           uint32[]                       inputs then outputs of every device
+ *   params          double[]                       parameters of every device
+ *   blocks          FileBlock[blockCount]          evaluation blocks (see Flowsheet)
+ *   tears           uint32[]                       tear streams of the recycle blocks
+ *
+ * Device parameters: none for a Mixer, the conversion matrix for a Reactor
+ * (possibly empty), and for a Separator the fraction of every output followed
+ * by the component split (possibly empty).
+ */
+
+const char FlowsheetFileMagic[8] = {'F', 'L', 'O', 'W', 'S', 'H', 'T', '\0'};
+const uint32_t FlowsheetFileVersion = 2;
+const uint32_t FlowsheetFileByteOrder = 0x01020304u; ///< Reads back differently on a big-endian machine.
+const size_t FlowsheetFileAlign = 64;
+
+/**
+ * @brief Position of one array in the file.
+ */
+struct FileSection
+{
+    uint64_t offset; ///< From the start of the file.
+    uint64_t count;  ///< Number of elements.
+};
+
+struct FlowsheetFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t fileSize;
+    uint64_t streamCount;
+    uint64_t componentCount;
+    FileSection flows, componentFlows, nameIds, nameOffsets, nameChars;
+    FileSection devices, ports, params, blocks, tears;
+};
+
+/**
+ * @brief One device: its kind and where its ports and parameters are.
+ */
+struct FileDevice
+{
+    uint32_t kind;       ///< DeviceKind.
+    uint32_t portBegin;  ///< First input in ports; outputs follow the inputs.
+    uint32_t inCount;
+    uint32_t outCount;
+    uint32_t paramBegin; ///< First parameter in params.
+    uint32_t paramCount;
+};
+
+/**
+ * @brief One evaluation block: a single device or the devices of a recycle loop.
+ */
+struct FileBlock
+{
+    uint32_t begin, end;         ///< Range of the block in devices.
+    uint32_t tearBegin, tearEnd; ///< Range of the tear streams in tears, empty for a single device.
+};
+
+/**
+ * @class FlowsheetFileWriter
+ * @brief Lays out the sections of a flowsheet file and writes them.
+ */
+class FlowsheetFileWriter
+{
+private:
+    struct Part {
+        const void* data;
+        size_t bytes;
+        uint64_t offset;
+    };
+
+    FlowsheetFileHeader header{};
+    vector<Part> parts;
+    uint64_t end = (sizeof(FlowsheetFileHeader) + FlowsheetFileAlign - 1) / FlowsheetFileAlign * FlowsheetFileAlign;
+
+public:
+    FlowsheetFileWriter(uint64_t streamCount, uint64_t componentCount) {
+        memcpy(header.magic, FlowsheetFileMagic, sizeof(header.magic));
+        header.version = FlowsheetFileVersion;
+        header.byteOrder = FlowsheetFileByteOrder;
+        header.streamCount = streamCount;
+        header.componentCount = componentCount;
+    }
+
+    /**
+     * @brief Append a section; the data must stay alive until write().
+     */
+    template <class T>
+    void add(FileSection FlowsheetFileHeader::*section, const T* data, size_t count) {
+        header.*section = FileSection{end, count};
+        parts.push_back(Part{data, count * sizeof(T), end});
+        end = (end + count * sizeof(T) + FlowsheetFileAlign - 1) / FlowsheetFileAlign * FlowsheetFileAlign;
+    }
+
+    /**
+     * @throws DeviceException FileAccess if the file cannot be created or written.
+     */
+    void write(const string& path) {
+        header.fileSize = end;
+        ofstream file(path, ios::binary | ios::trunc);
+        if (!file) throw DeviceException(DeviceError::FileAccess);
+        vector<char> zeros(FlowsheetFileAlign, 0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        uint64_t at = sizeof(header);
+        for (const Part& p : parts) {
+            file.write(zeros.data(), p.offset - at);
+            file.write(static_cast<const char*>(p.data), p.bytes);
+            at = p.offset + p.bytes;
+        }
+        file.write(zeros.data(), end - at);
+        if (!file) throw DeviceException(DeviceError::FileAccess);
+    }
+};
+#endif // FLOWSHEET_FILE_CPP
@@ -0,0 +1,240 @@
+#ifndef FLOWSHEET_TAPE_CPP
+#define FLOWSHEET_TAPE_CPP
+
+/**
+ * @file FlowsheetTape.cpp
+ *
+ * @brief A flowsheet compiled to a flat tape of fused instructions over the stream table.
+ */
+
+#include "Flowsheet.cpp"
+
+using namespace std;
+
+/**
+ * @class FlowsheetTape
+ * @brief Evaluates a flowsheet by interpreting a compiled instruction tape.
+ *
+ * Every Mixer, Reactor and Separator sends a fraction (outputFraction()) of
+ * the sum of its inputs to each output. Such a device becomes one instruction:
+ * a weighted sum of input streams, then one product per output stream, read
+ * and written directly in the stream table. Running the tape is one loop over
+ * flat arrays, with no virtual call, port vector or Stream object touched.
+ *
+ * A device with a single output whose stream has a single consumer, and that
+ * nobody observes (see observe()), is fused into that consumer: its weighted
+ * inputs are added to the consumer's sum, and the intermediate stream is
+ * never written (it keeps a stale value). Chains such as Mixer, Reactor,
+ * Separator collapse this way into one instruction. Feeds and products are
+ * never elided, nor are tear streams or streams read by other devices.
+ *
+ * Other devices stay on the tape as calls to their update(), reading and
+ * writing real streams. Recycle loops are converged by the flowsheet's
+ * convergence options. Fusion changes the order of the additions, so the
+ * flows match evaluate() to rounding. Only total mass flows are compiled: the
+ * flowsheet must not track components.
+ */
+class FlowsheetTape
+{
+private:
+    /**
+     * @brief One instruction: flow[out] = fraction * sum(weight * flow[term]) for every output.
+     */
+    struct Instruction {
+        uint32_t termBegin, termEnd;  ///< Range of terms and weights.
+        uint32_t outBegin, outEnd;    ///< Range of outputs and fractions.
+        Device* call;                 ///< Device whose update() runs instead, or null.
+    };
+
+    /**
+     * @brief A range of instructions, iterated over tear streams for a recycle loop.
+     */
+    struct Segment {
+        uint32_t begin, end;          ///< Range of instructions.
+        uint32_t tearBegin, tearEnd;  ///< Range of tearIds, empty outside loops.
+    };
+
+    Flowsheet& sheet;
+    vector<Instruction> tape;
+    vector<uint32_t> terms, outs;     ///< Stream indices read and written by the instructions.
+    vector<double> weights, fractions;
+    vector<Segment> segments;
+    vector<uint32_t> tearIds;
+    vector<uint8_t> observed;         ///< Per stream, set by observe().
+    size_t elided = 0;
+    unsigned long planVersion = ~0ul;
+    RecycleSolver solver;
+    int lastSweeps = 0;
+
+    void compile() {
+        StreamTable& table = sheet.getTable();
+        if (table.componentCount() != 0) throw DeviceException(DeviceError::UnsupportedComponents);
+        const vector<Device*>& order = sheet.evaluationOrder();
+        const vector<TearStream>& tears = sheet.tearStreams();
+        size_t n = table.size();
+        observed.resize(n, 0);
+
+        vector<uint32_t> consumers(n, 0);
+        vector<uint8_t> isTear(n, 0);
+        for (Device* d : order) {
+            for (uint32_t id : d->getInputIds()) if (d->getTable() == &table) consumers[id]++;
+        }
+        for (const TearStream& t : tears) isTear[t.index] = 1;
+
+        // Pending instructions, one per device, with their own term lists so
+        // that a fused producer can be spliced into its consumer.
+        struct Pending {
+            vector<uint32_t> terms, outs;
+            vector<double> weights, fractions;
+            Device* call = nullptr;
+            bool live = true;
+            bool readsTear = false;
+        };
+        vector<Pending> pending(order.size());
+        vector<uint32_t> producer(n, ~0u); // pending instruction writing a stream, if fusable
+        elided = 0;
+        for (uint32_t p = 0; p < order.size(); p++) {
+            Device* d = order[p];
+            Pending& ins = pending[p];
+            bool kernel = d->kind() != DeviceKind::Other && d->getTable() == &table && d->portsComplete();
+            if (!kernel) {
+                ins.call = d;
+                continue;
+            }
+            for (uint32_t id : d->getInputIds()) {
+                uint32_t q = producer[id];
+                if (q != ~0u && consumers[id] == 1 && !observed[id] && !pending[q].readsTear) {
+                    // Fuse: the producer's terms read streams that no longer change.
+                    Pending& from = pending[q];
+                    double f = from.fractions[0];
+                    for (size_t k = 0; k < from.terms.size(); k++) {
+                        ins.terms.push_back(from.terms[k]);
+                        ins.weights.push_back(from.weights[k] * f);
+                    }
+                    from.live = false;
+                    elided++;
+                } else {
+                    ins.terms.push_back(id);
+                    ins.weights.push_back(1.0);
+                    ins.readsTear = ins.readsTear || isTear[id];
+                }
+            }
+            for (size_t j = 0; j < d->getOutputIds().size(); j++) {
+                ins.outs.push_back(d->getOutputIds()[j]);
+                ins.fractions.push_back(d->outputFraction(j));
+            }
+            if (ins.outs.size() == 1 && !isTear[ins.outs[0]]) producer[ins.outs[0]] = p;
+        }
+
+        tape.clear();
+        terms.clear();
+        weights.clear();
+        outs.clear();
+        fractions.clear();
+        segments.clear();
+        tearIds.clear();
+        for (const Flowsheet::Block& blk : sheet.evaluationBlocks()) {
+            Segment seg{static_cast<uint32_t>(tape.size()), 0, static_cast<uint32_t>(tearIds.size()), 0};
+            for (uint32_t t = blk.tearBegin; t < blk.tearEnd; t++) tearIds.push_back(tears[t].index);
+            for (uint32_t p = blk.begin; p < blk.end; p++) {
+                Pending& ins = pending[p];
+                if (!ins.live) continue;
+                tape.push_back(Instruction{static_cast<uint32_t>(terms.size()), 0, static_cast<uint32_t>(outs.size()), 0, ins.call});
+                terms.insert(terms.end(), ins.terms.begin(), ins.terms.end());
+                weights.insert(weights.end(), ins.weights.begin(), ins.weights.end());
+                outs.insert(outs.end(), ins.outs.begin(), ins.outs.end());
+                fractions.insert(fractions.end(), ins.fractions.begin(), ins.fractions.end());
+                tape.back().termEnd = static_cast<uint32_t>(terms.size());
+                tape.back().outEnd = static_cast<uint32_t>(outs.size());
+            }
+            seg.end = static_cast<uint32_t>(tape.size());
+            seg.tearEnd = static_cast<uint32_t>(tearIds.size());
+            // Merge runs of loop-free blocks into one segment.
+            if (!segments.empty() && seg.tearBegin == seg.tearEnd && segments.back().tearBegin == segments.back().tearEnd) {
+                segments.back().end = seg.end;
+            } else if (seg.begin != seg.end) {
+                segments.push_back(seg);
+            }
+        }
+        planVersion = sheet.getWiringVersion();
+    }
+
+    void run(uint32_t begin, uint32_t end) {
+        double* flow = sheet.getTable().data();
+        const uint32_t* term = terms.data();
+        const double* weight = weights.data();
+        const uint32_t* out = outs.data();
+        const double* fraction = fractions.data();
+        for (const Instruction* ins = tape.data() + begin, *last = tape.data() + end; ins != last; ins++) {
+            if (ins->call) {
+                ins->call->update();
+                continue;
+            }
+            NeumaierSum sum;
+            for (uint32_t k = ins->termBegin; k < ins->termEnd; k++) sum.add(weight[k] * flow[term[k]]);
+            double total = sum.result();
+            for (uint32_t k = ins->outBegin; k < ins->outEnd; k++) flow[out[k]] = total * fraction[k];
+        }
+    }
+
+public:
+    explicit FlowsheetTape(Flowsheet& fs): sheet(fs) {}
+
+    /**
+     * @brief Keep a stream written by evaluate(), even if fusion could elide it.
+     * @throws DeviceException DifferentTables for a stream of another table.
+     */
+    void observe(const Stream& s) {
+        if (&s.getTable() != &sheet.getTable()) throw DeviceException(DeviceError::DifferentTables);
+        if (observed.size() <= s.getIndex()) observed.resize(s.getIndex() + 1, 0);
+        if (!observed[s.getIndex()]) planVersion = ~0ul;
+        observed[s.getIndex()] = 1;
+    }
+
+    /**
+     * @brief Number of instructions on the tape (fused devices count once).
+     */
+    size_t instructionCount() {
+        if (planVersion != sheet.getWiringVersion()) compile();
+        return tape.size();
+    }
+
+    /**
+     * @brief Number of intermediate streams removed by fusion.
+     */
+    size_t elidedStreamCount() {
+        if (planVersion != sheet.getWiringVersion()) compile();
+        return elided;
+    }
+
+    /**
+     * @brief Number of recycle sweeps done by the last evaluate().
+     */
+    int getLastRecycleSweeps() const { return lastSweeps; }
+
+    /**
+     * @brief Run the tape once, recompiling it if the wiring changed.
+     * @throws DeviceException UnsupportedComponents if the flowsheet has
+     * components, NotConverged if a loop does not converge.
+     */
+    void evaluate() {
+        if (planVersion != sheet.getWiringVersion()) compile();
+        lastSweeps = 0;
+        StreamTable& table = sheet.getTable();
+        solver.setOptions(sheet.getConvergenceOptions());
+        for (const Segment& seg : segments) {
+            if (seg.tearBegin == seg.tearEnd) {
+                run(seg.begin, seg.end);
+                continue;
+            }
+            PROFILE_START(start);
+            int sweeps = solver.solve([&] { run(seg.begin, seg.end); }, table.data(), nullptr, 0,
+                                      tearIds.data() + seg.tearBegin, seg.tearEnd - seg.tearBegin);
+            PROFILE_RECYCLE(sweeps, start);
+            if (sweeps < 0) throw DeviceException(DeviceError::NotConverged);
+            lastSweeps += sweeps;
+        }
+        table.clearChanged();
+    }
+};
+#endif // FLOWSHEET_TAPE_CPP
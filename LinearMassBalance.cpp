@@ -0,0 +1,196 @@
+#ifndef LINEAR_MASS_BALANCE_CPP
+#define LINEAR_MASS_BALANCE_CPP
+
+/**
+ * @file LinearMassBalance.cpp
+ *
+ * @brief Direct solution of the mass balance of a flowsheet as one sparse linear system.
+ */
+
+#include "Flowsheet.cpp"
+#include "SparseLU.cpp"
+
+using namespace std;
+
+/**
+ * @class LinearMassBalance
+ * @brief Computes every stream flow of a flowsheet with one sparse LU solve, recycles included.
+ *
+ * Mixer, Reactor and Separator devices send a fixed fraction of the sum of
+ * their inputs to each output (see Device::outputFraction()), so the flows of
+ * the produced streams x satisfy
+ *
+ *   x_o - f_o * sum of the produced inputs x_i = f_o * sum of the feed inputs
+ *
+ * i.e. (I - F) x = b, with the feeds only in b. The unknowns are numbered in
+ * evaluation order, which makes I - F lower triangular outside recycle loops,
+ * so the LU factors have fill only inside the loops. F is nonnegative with a
+ * spectral radius below one for any loop that converges by substitution,
+ * which makes I - F an M-matrix: it is factored without pivoting.
+ *
+ * The factorization is cached and reused while the wiring is unchanged, so a feed update costs one forward and one back substitution.
+ * Only total mass flows are computed; the flowsheet must not track components.
+ */
+class LinearMassBalance
+{
+private:
+    /**
+     * @brief A sparse row of F: column indices and values, sorted by column.
+     */
+    struct Row {
+        vector<uint32_t> cols;
+        vector<double> vals;
+    };
+
+    Flowsheet& sheet;
+    unsigned long assembledVersion = ~0ul;
+    vector<uint32_t> unknownOf;     ///< Unknown of every stream of the table, ~0u for a feed.
+    vector<uint32_t> streamOf;      ///< Stream of every unknown.
+    vector<Row> coupling;           ///< Row o: produced inputs i and coefficients f_o (F without the minus sign).
+    vector<Row> feedTerms;          ///< Row o: feed streams and coefficients f_o, for the right-hand side.
+    SparseLU lu;                    ///< Factors of I - F.
+    vector<double> rhs;             ///< Reused right-hand side and solution.
+    bool factored = false;
+    size_t factorizations = 0;
+
+    /**
+     * @brief Build the rows of I - F and of the feed terms from the current wiring and fractions.
+     * @return Whether the coefficients differ from the factored ones.
+     */
+    bool assemble() {
+        StreamTable& table = sheet.getTable();
+        if (table.componentCount() != 0) throw DeviceException(DeviceError::UnsupportedComponents);
+        const vector<Device*>& order = sheet.evaluationOrder();
+
+        vector<uint32_t> unknowns(table.size(), ~0u);
+        vector<uint32_t> streams;
+        for (Device* d : order) {
+            if (d->kind() == DeviceKind::Other || d->getTable() != &table || !d->portsComplete()) {
+                throw DeviceException(DeviceError::UnsupportedDevice);
+            }
+            for (uint32_t id : d->getOutputIds()) {
+                unknowns[id] = static_cast<uint32_t>(streams.size());
+                streams.push_back(id);
+            }
+        }
+
+        vector<Row> newCoupling(streams.size()), newFeeds(streams.size());
+        for (Device* d : order) {
+            const vector<uint32_t>& in = d->getInputIds();
+            for (size_t j = 0; j < d->getOutputIds().size(); j++) {
+                uint32_t o = unknowns[d->getOutputIds()[j]];
+                double f = d->outputFraction(j);
+                for (uint32_t id : in) {
+                    Row& row = unknowns[id] == ~0u ? newFeeds[o] : newCoupling[o];
+                    row.cols.push_back(unknowns[id] == ~0u ? id : unknowns[id]);
+                    row.vals.push_back(f);
+                }
+            }
+        }
+        for (Row& row : newCoupling) mergeDuplicates(row);
+
+        bool changed = !factored || streams != streamOf;
+        for (size_t o = 0; !changed && o < streams.size(); o++) {
+            changed = newCoupling[o].cols != coupling[o].cols || newCoupling[o].vals != coupling[o].vals;
+        }
+        unknownOf.swap(unknowns);
+        streamOf.swap(streams);
+        coupling.swap(newCoupling);
+        feedTerms.swap(newFeeds);
+        assembledVersion = sheet.getWiringVersion();
+        return changed;
+    }
+
+    /**
+     * @brief Sort a row by column and add up the coefficients of repeated columns.
+     */
+    static void mergeDuplicates(Row& row) {
+        vector<size_t> idx(row.cols.size());
+        for (size_t k = 0; k < idx.size(); k++) idx[k] = k;
+        sort(idx.begin(), idx.end(), [&](size_t a, size_t b) { return row.cols[a] < row.cols[b]; });
+        Row merged;
+        for (size_t k : idx) {
+            if (!merged.cols.empty() && merged.cols.back() == row.cols[k]) merged.vals.back() += row.vals[k];
+            else {
+                merged.cols.push_back(row.cols[k]);
+                merged.vals.push_back(row.vals[k]);
+            }
+        }
+        row = std::move(merged);
+    }
+
+    /**
+     * @brief Factor I - F.
+     */
+    void factor() {
+        size_t n = streamOf.size();
+        vector<uint32_t> rowStart(n + 1, 0), cols;
+        vector<double> vals;
+        for (size_t o = 0; o < n; o++) {
+            cols.push_back(static_cast<uint32_t>(o));
+            vals.push_back(1.0);
+            for (size_t k = 0; k < coupling[o].cols.size(); k++) {
+                cols.push_back(coupling[o].cols[k]);
+                vals.push_back(-coupling[o].vals[k]);
+            }
+            rowStart[o + 1] = static_cast<uint32_t>(cols.size());
+        }
+        try {
+            lu.factor(n, rowStart.data(), cols.data(), vals.data());
+        } catch (const DeviceException&) {
+            factored = false;
+            assembledVersion = ~0ul;
+            throw;
+        }
+        factored = true;
+        factorizations++;
+    }
+
+public:
+    explicit LinearMassBalance(Flowsheet& fs): sheet(fs) {}
+
+    /**
+     * @brief Compute the flow of every produced stream from the current feed flows.
+     *
+     * The system is reassembled after a wiring change (fractions follow the
+     * wiring) and refactored only if a coefficient actually changed. The
+     * flows are written to the flowsheet's table and its change log is
+     * cleared, as after Flowsheet::evaluate().
+     *
+     * @throws DeviceException UnsupportedComponents if the flowsheet has
+     * components, UnsupportedDevice for a device that is not a fixed split
+     * (kind Other), SingularMatrix if the flows are not determined.
+     */
+    void solve() {
+        if (assembledVersion != sheet.getWiringVersion() && assemble()) factor();
+
+        StreamTable& table = sheet.getTable();
+        const double* flow = table.data();
+        size_t n = streamOf.size();
+        rhs.assign(n, 0.0);
+        for (size_t o = 0; o < n; o++) {
+            double b = 0.0;
+            for (size_t k = 0; k < feedTerms[o].cols.size(); k++) b += feedTerms[o].vals[k] * flow[feedTerms[o].cols[k]];
+            rhs[o] = b;
+        }
+        lu.solve(rhs.data());
+        for (size_t o = 0; o < n; o++) table.setFlow(streamOf[o], rhs[o]);
+        table.clearChanged();
+    }
+
+    /**
+     * @brief Number of unknowns (produced streams) of the last assembled system.
+     */
+    size_t unknownCount() const { return streamOf.size(); }
+
+    /**
+     * @brief Number of off-diagonal nonzeros of the cached L and U factors.
+     */
+    size_t factorNonZeros() const { return lu.nonZeros(); }
+
+    /**
+     * @brief Number of factorizations done so far.
+     */
+    size_t factorizationCount() const { return factorizations; }
+};
+#endif // LINEAR_MASS_BALANCE_CPP
@@ -0,0 +1,284 @@
+#ifndef LIVE_FLOWSHEET_CPP
+#define LIVE_FLOWSHEET_CPP
+
+/**
+ * @file LiveFlowsheet.cpp
+ *
+ * @brief Continuous evaluation on a background thread, fed and read concurrently without locks.
+ */
+
+#include "Flowsheet.cpp"
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+
+using namespace std;
+
+/**
+ * @class FeedMailbox
+ * @brief Latest pending value of each of a fixed set of feeds, published lock-free by any thread.
+ *
+ * Each feed has a slot holding its newest value. The first publish() to a
+ * slot since the last drain also pushes the slot on a lock-free list; drain()
+ * takes the whole list with one exchange (so there is no ABA problem) and
+ * reads the newest value of every listed slot. Values published between two
+ * drains collapse into the last one.
+ */
+class FeedMailbox
+{
+private:
+    static constexpr uint32_t Empty = ~0u;
+
+    struct alignas(64) Slot {
+        atomic<double> value{0.0};
+        atomic<uint32_t> next{Empty};
+        atomic<bool> queued{false};
+    };
+
+    unique_ptr<Slot[]> slots;
+    size_t count;
+    atomic<uint32_t> head{Empty};
+
+public:
+    explicit FeedMailbox(size_t feeds): slots(new Slot[feeds]), count(feeds) {}
+
+    size_t size() const { return count; }
+
+    /**
+     * @brief Make m the pending value of a feed. Wait-free unless another writer pushes at the same time.
+     * @return Whether the slot was pushed on the pending list (it had no pending value).
+     */
+    bool publish(size_t feed, double m) {
+        Slot& s = slots[feed];
+        s.value.store(m);
+        if (s.queued.exchange(true)) return false;
+        uint32_t h = head.load(memory_order_relaxed);
+        do {
+            s.next.store(h, memory_order_relaxed);
+        } while (!head.compare_exchange_weak(h, static_cast<uint32_t>(feed), memory_order_release, memory_order_relaxed));
+        return true;
+    }
+
+    /**
+     * @brief Whether some feed has a value not drained yet.
+     */
+    bool pending() const { return head.load() != Empty; }
+
+    /**
+     * @brief Take every pending value. Only one thread may drain.
+     * @param apply Called with (feed, value) for every feed published since the last drain.
+     * @return Number of feeds applied.
+     */
+    template <class Apply>
+    size_t drain(Apply apply) {
+        size_t applied = 0;
+        for (uint32_t i = head.exchange(Empty, memory_order_acquire); i != Empty; applied++) {
+            Slot& s = slots[i];
+            uint32_t next = s.next.load(memory_order_relaxed);
+            // Clear the flag before reading the value: a publish() racing with
+            // this read either is seen here or queues the slot again.
+            s.queued.store(false);
+            apply(i, s.value.load());
+            i = next;
+        }
+        return applied;
+    }
+};
+
+/**
+ * @class FlowSnapshot
+ * @brief Double-buffered copy of the stream flows, written by one thread and read by any number.
+ *
+ * The writer fills the buffer readers are not pointed at, then switches them
+ * over. Each buffer is guarded by a sequence counter (seqlock), so a reader
+ * retries only if the writer published twice during its copy; readers never
+ * block the writer.
+ */
+class FlowSnapshot
+{
+private:
+    struct Buffer {
+        atomic<uint64_t> sequence{0};   ///< Odd while the buffer is being written.
+        atomic<uint64_t> epoch{0};      ///< Number of the snapshot held.
+        unique_ptr<atomic<double>[]> values;
+    };
+
+    size_t count;
+    Buffer buffers[2];
+    atomic<uint32_t> current{0};
+    uint64_t published = 0;
+
+public:
+    explicit FlowSnapshot(size_t streams): count(streams) {
+        for (Buffer& b : buffers) b.values.reset(new atomic<double>[streams]());
+    }
+
+    size_t size() const { return count; }
+
+    /**
+     * @brief Publish a new snapshot. Only one thread may publish.
+     * @return The epoch of the snapshot, counting from 1.
+     */
+    uint64_t publish(const double* flows) {
+        uint32_t target = 1 - current.load(memory_order_relaxed);
+        Buffer& b = buffers[target];
+        uint64_t seq = b.sequence.load(memory_order_relaxed);
+        b.sequence.store(seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        for (size_t i = 0; i < count; i++) b.values[i].store(flows[i], memory_order_relaxed);
+        b.epoch.store(++published, memory_order_relaxed);
+        b.sequence.store(seq + 2, memory_order_release);
+        current.store(target, memory_order_release);
+        return published;
+    }
+
+    /**
+     * @brief Copy the latest snapshot.
+     * @param out Receives size() flows, all from the same snapshot.
+     * @return The epoch of the snapshot, 0 before the first publish().
+     */
+    uint64_t read(double* out) const {
+        for (;;) {
+            const Buffer& b = buffers[current.load(memory_order_acquire)];
+            uint64_t before = b.sequence.load(memory_order_acquire);
+            if (before & 1) continue;
+            for (size_t i = 0; i < count; i++) out[i] = b.values[i].load(memory_order_relaxed);
+            uint64_t epoch = b.epoch.load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (b.sequence.load(memory_order_relaxed) == before) return epoch;
+        }
+    }
+};
+
+/**
+ * @class LiveFlowsheet
+ * @brief Keeps a flowsheet evaluated on a background thread while other threads feed it and read it.
+ *
+ * Writers call setFeed() instead of Stream::setMassFlow(); the values go to a
+ * FeedMailbox and the solver thread applies them between sweeps, then
+ * re-runs the affected devices (Flowsheet::recomputeDirty()) and publishes
+ * every stream flow to a FlowSnapshot. Readers call read() and always get the
+ * flows of one finished sweep. No lock is shared by writers, readers and the
+ * solver; only the solver thread touches the flowsheet while it runs, so the
+ * flowsheet must not be used directly between start() and stop().
+ */
+class LiveFlowsheet
+{
+private:
+    Flowsheet& sheet;
+    vector<shared_ptr<Stream>> feeds;
+    FeedMailbox mailbox;
+    FlowSnapshot snapshot;
+    atomic<uint32_t> wake{0};       ///< Bumped to wake the solver thread.
+    atomic<bool> stopping{false};
+    atomic<bool> busy{false};       ///< Set while the solver thread applies a drain.
+    atomic<bool> finished{false};   ///< Set once the solver thread returned, after failure is stored.
+    thread solver;
+    exception_ptr failure;
+
+    void loop() {
+        try {
+            sheet.evaluate();
+            snapshot.publish(sheet.getTable().data());
+            for (;;) {
+                uint32_t seen = wake.load();
+                if (stopping.load()) break;
+                busy.store(true);
+                size_t applied = mailbox.drain([this](size_t f, double m) { feeds[f]->setMassFlow(m); });
+                if (applied) {
+                    sheet.recomputeDirty();
+                    snapshot.publish(sheet.getTable().data());
+                }
+                busy.store(false);
+                if (!applied) wake.wait(seen);
+            }
+        } catch (...) {
+            failure = current_exception();
+            finished.store(true, memory_order_release); // before busy, so that flush() sees the failure
+            busy.store(false);
+            return;
+        }
+        finished.store(true, memory_order_release);
+    }
+
+public:
+    /**
+     * @brief Wrap a flowsheet.
+     * @param fs The flowsheet; its wiring must not change while running.
+     * @param feedStreams The streams writers may set, by feed number.
+     */
+    LiveFlowsheet(Flowsheet& fs, vector<shared_ptr<Stream>> feedStreams)
+        : sheet(fs), feeds(std::move(feedStreams)), mailbox(feeds.size()), snapshot(fs.getTable().size()) {}
+
+    ~LiveFlowsheet() {
+        try {
+            stop();
+        } catch (...) {
+        }
+    }
+
+    /**
+     * @brief Evaluate the flowsheet once and start the solver thread.
+     */
+    void start() {
+        if (solver.joinable()) return;
+        stopping.store(false);
+        busy.store(true); // until the first snapshot is published
+        finished.store(false);
+        failure = nullptr;
+        solver = thread([this] { loop(); });
+    }
+
+    /**
+     * @brief Stop the solver thread. Feeds still pending are applied to the streams but not evaluated.
+     *
+     * Rethrows an exception raised by the solver thread (e.g. a recycle loop
+     * that did not converge).
+     */
+    void stop() {
+        if (!solver.joinable()) return;
+        stopping.store(true);
+        wake.fetch_add(1);
+        wake.notify_one();
+        solver.join();
+        mailbox.drain([this](size_t f, double m) { feeds[f]->setMassFlow(m); });
+        if (failure) rethrow_exception(failure);
+    }
+
+    /**
+     * @brief Set a feed from any thread, without blocking.
+     * @param feed The feed number, an index into the feed streams.
+     * @param m The new mass flow.
+     */
+    void setFeed(size_t feed, double m) {
+        if (mailbox.publish(feed, m)) {
+            wake.fetch_add(1, memory_order_release);
+            wake.notify_one();
+        }
+    }
+
+    /**
+     * @brief Copy the flows of every stream from the latest finished sweep.
+     * @param out Resized to the number of streams, indexed by stream index.
+     * @return The number of sweeps published so far (the snapshot epoch).
+     */
+    uint64_t read(vector<double>& out) const {
+        out.resize(snapshot.size());
+        return snapshot.read(out.data());
+    }
+
+    /**
+     * @brief Wait until every feed set before the call is evaluated and published.
+     *
+     * Returns early if the solver thread stopped. Rethrows the exception that
+     * stopped it, if any; stop() rethrows it as well.
+     */
+    void flush() const {
+        while ((mailbox.pending() || busy.load()) && !stopping.load() && !finished.load(memory_order_acquire)) {
+            this_thread::yield();
+        }
+        if (finished.load(memory_order_acquire) && failure) rethrow_exception(failure);
+    }
+};
+#endif // LIVE_FLOWSHEET_CPP
@@ -0,0 +1,334 @@
+#ifndef MAPPED_FLOWSHEET_CPP
+#define MAPPED_FLOWSHEET_CPP
+
+/**
+ * @file MappedFlowsheet.cpp
+ *
+ * @brief Evaluation of a flowsheet straight from a memory-mapped snapshot file.
+ */
+
+#include "Flowsheet.cpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * @class MappedFlowsheet
+ * @brief A flowsheet file written by Flowsheet::save(), mapped in memory and evaluated in place.
+ *
+ * Loading maps the file, checks its header and section bounds, and checks in
+ * one pass over the wiring that every stream index, port, parameter, block and
+ * tear range stays inside its section: no parsing and no Stream or Device
+ * objects. Evaluation then reads the wiring from the mapped arrays without
+ * checks and writes the flows in place. The mapping is private: changes are
+ * never written back to the file, pages are copied on first write only, and
+ * save() writes a new snapshot.
+ */
+class MappedFlowsheet
+{
+private:
+    char* base = nullptr;
+    size_t size = 0;
+    const FlowsheetFileHeader* header = nullptr;
+    double* flows = nullptr;
+    double* components = nullptr;
+    const uint32_t* nameIds = nullptr;
+    const uint64_t* nameOffsets = nullptr;
+    const char* nameChars = nullptr;
+    const FileDevice* devices = nullptr;
+    const uint32_t* ports = nullptr;
+    const double* params = nullptr;
+    const FileBlock* blocks = nullptr;
+    const uint32_t* tears = nullptr;
+    RecycleSolver solver;
+    int lastSweeps = 0;
+    vector<double> compensation;  ///< Scratch of the Mixer component sums.
+
+    template <class T>
+    T* section(const FileSection& s) const {
+        if (s.offset % alignof(T) != 0 || s.offset > size || s.count > (size - s.offset) / sizeof(T)) {
+            throw DeviceException(DeviceError::FileFormat);
+        }
+        return reinterpret_cast<T*>(base + s.offset);
+    }
+
+    /**
+     * @brief Whether [begin, begin + count) lies inside a section of total elements.
+     */
+    static bool inRange(uint64_t begin, uint64_t count, uint64_t total) { return begin <= total && count <= total - begin; }
+
+    /**
+     * @brief Check every index run() and evaluate() follow, once, so that they run check-free.
+     * @throws DeviceException FileFormat for an index out of its section, or the
+     * code of Device::validate() for a device that cannot be updated.
+     */
+    void checkWiring() const {
+        uint64_t nc = header->componentCount;
+        uint64_t streams = header->streamCount;
+        for (size_t i = 0; i < header->devices.count; i++) {
+            const FileDevice& d = devices[i];
+            if (!inRange(d.portBegin, uint64_t(d.inCount) + d.outCount, header->ports.count)
+                || !inRange(d.paramBegin, d.paramCount, header->params.count)) {
+                throw DeviceException(DeviceError::FileFormat);
+            }
+            for (uint64_t k = 0; k < uint64_t(d.inCount) + d.outCount; k++) {
+                if (ports[d.portBegin + k] >= streams) throw DeviceException(DeviceError::FileFormat);
+            }
+            if (d.outCount == 0) throw DeviceException(DeviceError::MissingOutput);
+            switch (static_cast<DeviceKind>(d.kind)) {
+            case DeviceKind::Mixer:
+                break;
+            case DeviceKind::Reactor:
+                if (d.inCount == 0) throw DeviceException(DeviceError::MissingInput);
+                if (nc && d.paramCount != 0 && d.paramCount != nc * nc) throw DeviceException(DeviceError::ConversionSize);
+                break;
+            case DeviceKind::Separator: {
+                if (d.inCount == 0) throw DeviceException(DeviceError::MissingInput);
+                if (d.paramCount < d.outCount) throw DeviceException(DeviceError::SplitFractions);
+                uint64_t splitCount = d.paramCount - d.outCount;
+                if (nc && splitCount != 0 && (splitCount != nc || d.outCount != 2)) throw DeviceException(DeviceError::SplitSize);
+                break;
+            }
+            default:
+                throw DeviceException(DeviceError::UnsupportedDevice);
+            }
+        }
+        for (size_t b = 0; b < header->blocks.count; b++) {
+            const FileBlock& blk = blocks[b];
+            if (blk.begin > blk.end || blk.end > header->devices.count
+                || blk.tearBegin > blk.tearEnd || blk.tearEnd > header->tears.count) {
+                throw DeviceException(DeviceError::FileFormat);
+            }
+        }
+        for (size_t t = 0; t < header->tears.count; t++) {
+            if (tears[t] >= streams) throw DeviceException(DeviceError::FileFormat);
+        }
+        uint64_t names = header->nameOffsets.count;
+        if (names == 0 || nameOffsets[0] != 0) throw DeviceException(DeviceError::FileFormat);
+        for (uint64_t n = 1; n < names; n++) {
+            if (nameOffsets[n] < nameOffsets[n - 1]) throw DeviceException(DeviceError::FileFormat);
+        }
+        if (nameOffsets[names - 1] > header->nameChars.count) throw DeviceException(DeviceError::FileFormat);
+        for (size_t i = 0; i < streams; i++) {
+            uint32_t id = nameIds[i];
+            if (!(id & StreamTable::AutoName) && uint64_t(id) + 1 >= names) throw DeviceException(DeviceError::FileFormat);
+        }
+    }
+
+    double* componentData(uint32_t i) { return components + size_t(i) * header->componentCount; }
+
+    /**
+     * @brief Evaluate one device, with the same arithmetic as its updateOutputs().
+     *
+     * Does no checking: the wiring was checked on load (checkWiring()).
+     */
+    void run(const FileDevice& d) {
+        const uint32_t* in = ports + d.portBegin;
+        const uint32_t* out = in + d.inCount;
+        const double* p = params + d.paramBegin;
+        size_t nc = header->componentCount;
+        switch (static_cast<DeviceKind>(d.kind)) {
+        case DeviceKind::Mixer: {
+            NeumaierSum sum;
+            for (uint32_t i = 0; i < d.inCount; i++) sum.add(flows[in[i]]);
+            for (uint32_t j = 0; j < d.outCount; j++) flows[out[j]] = sum.result() / d.outCount;
+            if (nc) {
+                double share = 1.0 / d.outCount;
+                double* first = componentData(out[0]);
+                fill(first, first + nc, 0.0);
+                compensation.assign(nc, 0.0);
+                for (uint32_t i = 0; i < d.inCount; i++) {
+                    const double* c = componentData(in[i]);
+                    for (size_t k = 0; k < nc; k++) neumaierAdd(first[k], compensation[k], c[k]);
+                }
+                for (size_t k = 0; k < nc; k++) first[k] = (first[k] + compensation[k]) * share;
+                for (uint32_t j = 1; j < d.outCount; j++) copy(first, first + nc, componentData(out[j]));
+            }
+            break;
+        }
+        case DeviceKind::Reactor: {
+            double inputMass = flows[in[0]];
+            for (uint32_t j = 0; j < d.outCount; j++) flows[out[j]] = inputMass * (1.0 / d.outCount);
+            if (nc) {
+                const double* c = componentData(in[0]);
+                double* first = componentData(out[0]);
+                double share = 1.0 / d.outCount;
+                double inTotal = 0.0, total = 0.0;
+                for (size_t k = 0; k < nc; k++) {
+                    double converted = c[k];
+                    if (d.paramCount) {
+                        converted = 0.0;
+                        for (size_t m = 0; m < nc; m++) converted += p[k * nc + m] * c[m];
+                    }
+                    first[k] = converted * share;
+                    inTotal += c[k];
+                    total += first[k];
+                }
+                double outputMass = componentOutputFlow(inputMass, total, inTotal, share);
+                for (uint32_t j = 0; j < d.outCount; j++) {
+                    if (j > 0) copy(first, first + nc, componentData(out[j]));
+                    flows[out[j]] = outputMass;
+                }
+            }
+            break;
+        }
+        case DeviceKind::Separator: {
+            double inputMass = flows[in[0]];
+            for (uint32_t j = 0; j < d.outCount; j++) flows[out[j]] = inputMass * p[j];
+            if (nc) {
+                const double* split = p + d.outCount;
+                size_t splitCount = d.paramCount - d.outCount;
+                const double* c = componentData(in[0]);
+                double inTotal = 0.0;
+                for (size_t k = 0; k < nc; k++) inTotal += c[k];
+                uint32_t last = d.outCount - 1;
+                for (uint32_t j = 0; j < last; j++) {
+                    double* part = componentData(out[j]);
+                    double total = 0.0;
+                    for (size_t k = 0; k < nc; k++) {
+                        part[k] = c[k] * (splitCount ? split[k] : p[j]);
+                        total += part[k];
+                    }
+                    flows[out[j]] = componentOutputFlow(inputMass, total, inTotal, p[j]);
+                }
+                double* rest = componentData(out[last]);
+                double total = 0.0;
+                for (size_t k = 0; k < nc; k++) {
+                    double r = c[k];
+                    for (uint32_t j = 0; j < last; j++) r -= componentData(out[j])[k];
+                    rest[k] = r;
+                    total += r;
+                }
+                flows[out[last]] = componentOutputFlow(inputMass, total, inTotal, p[last]);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+public:
+    /**
+     * @brief Map a flowsheet file.
+     * @param path A file written by Flowsheet::save().
+     * @throws DeviceException FileAccess if the file cannot be opened or mapped,
+     * FileFormat if it is not a valid flowsheet file, or the code of the first
+     * device that cannot be updated.
+     */
+    explicit MappedFlowsheet(const string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw DeviceException(DeviceError::FileAccess);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(FlowsheetFileHeader)) {
+            close(fd);
+            throw DeviceException(DeviceError::FileFormat);
+        }
+        size = st.st_size;
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) throw DeviceException(DeviceError::FileAccess);
+        base = static_cast<char*>(p);
+
+        try {
+            header = reinterpret_cast<const FlowsheetFileHeader*>(base);
+            if (memcmp(header->magic, FlowsheetFileMagic, sizeof(header->magic)) != 0
+                || header->byteOrder != FlowsheetFileByteOrder || header->version != FlowsheetFileVersion
+                || header->fileSize != size) {
+                throw DeviceException(DeviceError::FileFormat);
+            }
+            if (header->flows.count != header->streamCount || header->nameIds.count != header->streamCount
+                || (header->componentCount != 0 && header->streamCount > UINT64_MAX / header->componentCount)
+                || header->componentFlows.count != header->streamCount * header->componentCount) {
+                throw DeviceException(DeviceError::FileFormat);
+            }
+            flows = section<double>(header->flows);
+            components = section<double>(header->componentFlows);
+            nameIds = section<const uint32_t>(header->nameIds);
+            nameOffsets = section<const uint64_t>(header->nameOffsets);
+            nameChars = section<const char>(header->nameChars);
+            devices = section<const FileDevice>(header->devices);
+            ports = section<const uint32_t>(header->ports);
+            params = section<const double>(header->params);
+            blocks = section<const FileBlock>(header->blocks);
+            tears = section<const uint32_t>(header->tears);
+            checkWiring();
+        } catch (...) {
+            munmap(base, size);
+            throw;
+        }
+    }
+
+    MappedFlowsheet(const MappedFlowsheet&) = delete;
+    MappedFlowsheet& operator=(const MappedFlowsheet&) = delete;
+
+    ~MappedFlowsheet() { munmap(base, size); }
+
+    size_t streamCount() const { return header->streamCount; }
+    size_t deviceCount() const { return header->devices.count; }
+    size_t componentCount() const { return header->componentCount; }
+
+    double flow(uint32_t i) const { return flows[i]; }
+    void setFlow(uint32_t i, double m) { flows[i] = m; }
+    const double* componentFlows(uint32_t i) const { return components + size_t(i) * header->componentCount; }
+
+    /**
+     * @brief Direct access to the mapped mass flow array.
+     */
+    double* data() { return flows; }
+
+    string streamName(uint32_t i) const {
+        uint32_t id = nameIds[i];
+        if (id & StreamTable::AutoName) return "s" + to_string(id & ~StreamTable::AutoName);
+        return string(nameChars + nameOffsets[id], nameOffsets[id + 1] - nameOffsets[id]);
+    }
+
+    void setConvergenceOptions(const ConvergenceOptions& o) { solver.setOptions(o); }
+    const ConvergenceOptions& getConvergenceOptions() const { return solver.getOptions(); }
+
+    /**
+     * @brief Number of recycle sweeps done by the last evaluate().
+     */
+    int getLastRecycleSweeps() const { return lastSweeps; }
+
+    /**
+     * @brief Evaluate every device once in the saved order, converging recycle loops.
+     *
+     * Gives the same flows as Flowsheet::evaluate() on the saved flowsheet.
+     *
+     * @throws DeviceException NotConverged if a recycle loop did not converge.
+     */
+    void evaluate() {
+        lastSweeps = 0;
+        for (size_t b = 0; b < header->blocks.count; b++) {
+            const FileBlock& blk = blocks[b];
+            if (blk.tearBegin == blk.tearEnd) {
+                for (uint32_t d = blk.begin; d < blk.end; d++) run(devices[d]);
+                continue;
+            }
+            PROFILE_START(start);
+            int sweeps = solver.solve([&] { for (uint32_t d = blk.begin; d < blk.end; d++) run(devices[d]); },
+                                      flows, components, header->componentCount,
+                                      tears + blk.tearBegin, blk.tearEnd - blk.tearBegin);
+            PROFILE_RECYCLE(sweeps, start);
+            if (sweeps < 0) throw DeviceException(DeviceError::NotConverged);
+            lastSweeps += sweeps;
+        }
+    }
+
+    /**
+     * @brief Write the mapped flowsheet, with its current flows, to a new snapshot file.
+     * @param path Must not be the mapped file itself.
+     * @throws DeviceException FileAccess if the file cannot be created or written.
+     */
+    void save(const string& path) const {
+        ofstream file(path, ios::binary | ios::trunc);
+        if (!file) throw DeviceException(DeviceError::FileAccess);
+        file.write(base, size);
+        if (!file) throw DeviceException(DeviceError::FileAccess);
+    }
+};
+#endif // MAPPED_FLOWSHEET_CPP
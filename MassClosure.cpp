@@ -0,0 +1,174 @@
+#ifndef MASS_CLOSURE_CPP
+#define MASS_CLOSURE_CPP
+
+/**
+ * @file MassClosure.cpp
+ *
+ * @brief Whole-flowsheet audit of the mass balance of every device.
+ */
+
+#include "Flowsheet.cpp"
+#include "CompensatedSum.cpp"
+
+using namespace std;
+
+/**
+ * @struct ClosureOffender
+ * @brief Mass balance of one device.
+ */
+struct ClosureOffender
+{
+    const Device* device;
+    double inflow;     ///< Sum of the input flows.
+    double outflow;    ///< Sum of the output flows.
+    double imbalance;  ///< inflow - outflow.
+    double relative;   ///< |imbalance| / max(inflow, outflow), 0 when both are 0.
+};
+
+/**
+ * @struct ClosureReport
+ * @brief Result of MassClosureAudit::run().
+ */
+struct ClosureReport
+{
+    size_t devicesChecked = 0;
+    double maxRelative = 0.0;         ///< Largest relative imbalance of a device.
+    vector<ClosureOffender> worst;    ///< Devices with the largest relative imbalance, largest first.
+    double feedFlow = 0.0;            ///< Sum of the feeds (streams produced by no device).
+    double productFlow = 0.0;         ///< Sum of the products (streams read by no device).
+    double sheetRelative = 0.0;       ///< Relative imbalance of the whole flowsheet.
+
+    /**
+     * @brief Whether every device and the flowsheet close within a relative tolerance.
+     */
+    bool closed(double tolerance) const { return maxRelative <= tolerance && sheetRelative <= tolerance; }
+};
+
+/**
+ * @class MassClosureAudit
+ * @brief Checks the input against the output mass flow of every device of a flowsheet.
+ *
+ * Meant to run after every sweep: the ports of the devices are compiled into
+ * flat arrays once per wiring, and a run is one pass over them, cut into
+ * chunks of devices that a thread pool can check in parallel. Every sum is
+ * compensated (see NeumaierSum) and the chunks are fixed, so a report is the
+ * same bit for bit whatever the number of threads: a closure check does not
+ * flake with the schedule. Ties between offenders go to the device first in
+ * evaluation order.
+ *
+ * Devices with a state (a Tank) accumulate mass and are not checked; the
+ * flowsheet balance then includes their accumulation. Only devices on the
+ * flowsheet's own table are checked, on their total mass flow.
+ */
+class MassClosureAudit
+{
+private:
+    static constexpr size_t Chunk = 1024;  ///< Devices per parallel task.
+
+    Flowsheet& sheet;
+    unsigned long planVersion = ~0ul;
+    vector<const Device*> devices;         ///< Devices checked, in evaluation order.
+    vector<uint32_t> portStart;            ///< Ports of device d at portStart[d], outputs from outputStart[d].
+    vector<uint32_t> outputStart;
+    vector<uint32_t> ports;
+    vector<uint32_t> feeds, products;
+    vector<ClosureOffender> found;         ///< Per chunk, up to the requested number of offenders.
+    vector<double> chunkMax;
+
+    void rebuildPlan() {
+        StreamTable& table = sheet.getTable();
+        devices.clear();
+        portStart.assign(1, 0);
+        outputStart.clear();
+        ports.clear();
+        vector<uint8_t> produced(table.size(), 0), consumed(table.size(), 0);
+        for (Device* d : sheet.evaluationOrder()) {
+            if (d->getTable() != &table) continue;
+            for (uint32_t id : d->getInputIds()) consumed[id] = 1;
+            for (uint32_t id : d->getOutputIds()) produced[id] = 1;
+            if (d->stateCount() > 0) continue;
+            devices.push_back(d);
+            ports.insert(ports.end(), d->getInputIds().begin(), d->getInputIds().end());
+            outputStart.push_back(static_cast<uint32_t>(ports.size()));
+            ports.insert(ports.end(), d->getOutputIds().begin(), d->getOutputIds().end());
+            portStart.push_back(static_cast<uint32_t>(ports.size()));
+        }
+        feeds.clear();
+        products.clear();
+        for (uint32_t s = 0; s < table.size(); s++) {
+            if (consumed[s] && !produced[s]) feeds.push_back(s);
+            if (produced[s] && !consumed[s]) products.push_back(s);
+        }
+        planVersion = sheet.getWiringVersion();
+    }
+
+    static double relativeImbalance(double in, double out) {
+        double scale = max(abs(in), abs(out));
+        return scale > 0.0 ? abs(in - out) / scale : 0.0;
+    }
+
+    /**
+     * @brief Larger relative imbalance first, then earlier device (by checking order).
+     */
+    static bool worse(const ClosureOffender& a, size_t ia, const ClosureOffender& b, size_t ib) {
+        return a.relative != b.relative ? a.relative > b.relative : ia < ib;
+    }
+
+public:
+    explicit MassClosureAudit(Flowsheet& fs): sheet(fs) {}
+
+    /**
+     * @brief Check every device against the current flows.
+     * @param worstCount Number of offenders to report.
+     * @param pool Pool checking the chunks of devices, or nullptr to check on the caller.
+     */
+    ClosureReport run(size_t worstCount = 10, ThreadPool* pool = nullptr) {
+        if (planVersion != sheet.getWiringVersion()) rebuildPlan();
+        const double* flow = sheet.getTable().data();
+        size_t n = devices.size();
+        size_t chunks = (n + Chunk - 1) / Chunk;
+        size_t keep = min(worstCount, Chunk);
+        found.assign(chunks * keep, ClosureOffender{nullptr, 0.0, 0.0, 0.0, -1.0});
+        chunkMax.assign(chunks, 0.0);
+
+        auto body = [&](size_t begin, size_t end) {
+            vector<pair<ClosureOffender, size_t>> local;
+            for (size_t k = begin; k < end; k++) {
+                local.clear();
+                size_t last = min(n, (k + 1) * Chunk);
+                for (size_t d = k * Chunk; d < last; d++) {
+                    NeumaierSum in, out;
+                    for (uint32_t p = portStart[d]; p < outputStart[d]; p++) in.add(flow[ports[p]]);
+                    for (uint32_t p = outputStart[d]; p < portStart[d + 1]; p++) out.add(flow[ports[p]]);
+                    double i = in.result(), o = out.result();
+                    ClosureOffender c{devices[d], i, o, i - o, relativeImbalance(i, o)};
+                    chunkMax[k] = max(chunkMax[k], c.relative);
+                    local.emplace_back(c, d);
+                }
+                size_t top = min(keep, local.size());
+                partial_sort(local.begin(), local.begin() + top, local.end(),
+                             [](const auto& a, const auto& b) { return worse(a.first, a.second, b.first, b.second); });
+                for (size_t j = 0; j < top; j++) found[k * keep + j] = local[j].first;
+            }
+        };
+        if (pool && chunks > 1) pool->parallelFor(chunks, 1, body);
+        else body(0, chunks);
+
+        ClosureReport report;
+        report.devicesChecked = n;
+        for (double m : chunkMax) report.maxRelative = max(report.maxRelative, m);
+        // Chunks hold increasing device ranges, so the position in found orders ties like the device index.
+        vector<size_t> order;
+        for (size_t j = 0; j < found.size(); j++) if (found[j].device) order.push_back(j);
+        size_t top = min(worstCount, order.size());
+        partial_sort(order.begin(), order.begin() + top, order.end(),
+                     [&](size_t a, size_t b) { return worse(found[a], a, found[b], b); });
+        for (size_t j = 0; j < top; j++) report.worst.push_back(found[order[j]]);
+
+        report.feedFlow = reproducibleSum(feeds.size(), [&](size_t i) { return flow[feeds[i]]; }, pool);
+        report.productFlow = reproducibleSum(products.size(), [&](size_t i) { return flow[products[i]]; }, pool);
+        report.sheetRelative = relativeImbalance(report.feedFlow, report.productFlow);
+        return report;
+    }
+};
+#endif // MASS_CLOSURE_CPP
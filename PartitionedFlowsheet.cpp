@@ -0,0 +1,615 @@
+#ifndef PARTITIONED_FLOWSHEET_CPP
+#define PARTITIONED_FLOWSHEET_CPP
+
+/**
+ * @file PartitionedFlowsheet.cpp
+ *
+ * @brief Evaluation of a flowsheet cut into partitions, each run by its own NUMA-pinned worker.
+ */
+
+#include "Flowsheet.cpp"
+#include <barrier>
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <map>
+#include <new>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <thread>
+
+using namespace std;
+
+/**
+ * @brief The CPUs of every NUMA node, read from /sys/devices/system/node.
+ * @return One list of CPU numbers per node; empty if the machine reports no nodes.
+ */
+inline vector<vector<int>> numaNodeCpus() {
+    vector<vector<int>> nodes;
+    DIR* dir = opendir("/sys/devices/system/node");
+    if (!dir) return nodes;
+    vector<int> ids;
+    while (dirent* e = readdir(dir)) {
+        int id;
+        if (sscanf(e->d_name, "node%d", &id) == 1) ids.push_back(id);
+    }
+    closedir(dir);
+    sort(ids.begin(), ids.end());
+    for (int id : ids) {
+        ifstream file("/sys/devices/system/node/node" + to_string(id) + "/cpulist");
+        string list;
+        if (!getline(file, list)) continue;
+        vector<int> cpus;
+        for (size_t pos = 0; pos < list.size();) {
+            int first = 0, last = 0, used = 0;
+            if (sscanf(list.c_str() + pos, "%d%n", &first, &used) != 1) break;
+            pos += used;
+            last = first;
+            if (pos < list.size() && list[pos] == '-' && sscanf(list.c_str() + pos + 1, "%d%n", &last, &used) == 1) pos += used + 1;
+            for (int c = first; c <= last; c++) cpus.push_back(c);
+            if (pos < list.size() && list[pos] == ',') pos++;
+            else break;
+        }
+        if (!cpus.empty()) nodes.push_back(std::move(cpus));
+    }
+    return nodes;
+}
+
+/**
+ * @class SharedRing
+ * @brief Single-producer single-consumer ring of doubles in shared memory.
+ *
+ * The ring lives in an anonymous MAP_SHARED mapping and only uses lock-free
+ * atomics, so it works between threads and between processes forked after
+ * its creation.
+ */
+class SharedRing
+{
+private:
+    struct Header {
+        alignas(64) atomic<uint64_t> head; ///< Values written.
+        alignas(64) atomic<uint64_t> tail; ///< Values read.
+    };
+
+    void* memory = nullptr;
+    size_t bytes = 0;
+    Header* header = nullptr;
+    double* data = nullptr;
+    size_t capacity = 0;     ///< Power of two.
+
+public:
+    /**
+     * @brief Map a ring holding at least minCapacity values.
+     * @throws DeviceException SharedMemory if the ring cannot be mapped.
+     */
+    explicit SharedRing(size_t minCapacity) {
+        capacity = 1;
+        while (capacity < max<size_t>(1, minCapacity)) capacity <<= 1;
+        bytes = sizeof(Header) + capacity * sizeof(double);
+        memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) throw DeviceException(DeviceError::SharedMemory);
+        header = new (memory) Header{};
+        data = reinterpret_cast<double*>(static_cast<char*>(memory) + sizeof(Header));
+    }
+
+    ~SharedRing() {
+        header->~Header();
+        munmap(memory, bytes);
+    }
+
+    SharedRing(const SharedRing&) = delete;
+    SharedRing& operator=(const SharedRing&) = delete;
+
+    /**
+     * @brief Append n values, waiting while the ring is too full. n must not exceed the capacity.
+     */
+    void push(const double* values, size_t n) {
+        uint64_t head = header->head.load(memory_order_relaxed);
+        while (capacity - (head - header->tail.load(memory_order_acquire)) < n) this_thread::yield();
+        for (size_t i = 0; i < n; i++) data[(head + i) & (capacity - 1)] = values[i];
+        header->head.store(head + n, memory_order_release);
+    }
+
+    /**
+     * @brief Take n values, waiting until they are available.
+     */
+    void pop(double* values, size_t n) {
+        uint64_t tail = header->tail.load(memory_order_relaxed);
+        while (header->head.load(memory_order_acquire) - tail < n) this_thread::yield();
+        for (size_t i = 0; i < n; i++) values[i] = data[(tail + i) & (capacity - 1)];
+        header->tail.store(tail + n, memory_order_release);
+    }
+};
+
+/**
+ * @class Partitioning
+ * @brief Assignment of the evaluation blocks of a flowsheet to balanced partitions with few cut streams.
+ *
+ * Blocks (single devices and whole recycle loops, see Flowsheet::Block) are
+ * never split. Partitions are first grown breadth-first over the block graph
+ * up to the target weight (number of devices), which keeps connected parts
+ * together, then refined by moving boundary blocks to the neighbouring
+ * partition holding more of their connections, within 5 % of the target.
+ */
+class Partitioning
+{
+private:
+    size_t parts;
+    vector<uint32_t> blockPart;  ///< Partition of every block.
+    vector<size_t> weights;      ///< Number of devices of every partition.
+    size_t cut = 0;              ///< Streams read by another partition than their producer's.
+
+public:
+    /**
+     * @brief Partition the blocks of a flowsheet.
+     * @param fs The flowsheet.
+     * @param partCount Number of partitions wanted; fewer are used if there are fewer blocks.
+     */
+    Partitioning(Flowsheet& fs, size_t partCount) {
+        const vector<Device*>& order = fs.evaluationOrder();
+        const vector<Flowsheet::Block>& blocks = fs.evaluationBlocks();
+        size_t nb = blocks.size();
+        parts = max<size_t>(1, min(partCount, nb));
+        StreamTable& table = fs.getTable();
+
+        vector<uint32_t> producer(table.size(), ~0u);
+        vector<size_t> blockWeight(nb);
+        for (uint32_t b = 0; b < nb; b++) {
+            blockWeight[b] = blocks[b].end - blocks[b].begin;
+            for (uint32_t p = blocks[b].begin; p < blocks[b].end; p++) {
+                for (uint32_t id : order[p]->getOutputIds()) producer[id] = b;
+            }
+        }
+
+        // Undirected block graph, one edge per (stream, consumer) pair.
+        vector<pair<uint32_t, uint32_t>> edges;
+        for (uint32_t b = 0; b < nb; b++) {
+            for (uint32_t p = blocks[b].begin; p < blocks[b].end; p++) {
+                if (order[p]->getTable() != &table) continue;
+                for (uint32_t id : order[p]->getInputIds()) {
+                    uint32_t a = producer[id];
+                    if (a != ~0u && a != b) {
+                        edges.push_back({a, b});
+                        edges.push_back({b, a});
+                    }
+                }
+            }
+        }
+        vector<uint32_t> start(nb + 1, 0), adjacent(edges.size());
+        for (auto& e : edges) start[e.first + 1]++;
+        for (size_t b = 0; b < nb; b++) start[b + 1] += start[b];
+        vector<uint32_t> fill(start.begin(), start.end() - 1);
+        for (auto& e : edges) adjacent[fill[e.first]++] = e.second;
+
+        size_t total = 0;
+        for (size_t w : blockWeight) total += w;
+        size_t target = (total + parts - 1) / parts;
+
+        blockPart.assign(nb, ~0u);
+        weights.assign(parts, 0);
+        vector<uint32_t> queue;
+        uint32_t nextSeed = 0;
+        for (uint32_t part = 0; part < parts; part++) {
+            bool last = part + 1 == parts;
+            queue.clear();
+            size_t head = 0;
+            while (last || weights[part] < target) {
+                if (head == queue.size()) {
+                    while (nextSeed < nb && blockPart[nextSeed] != ~0u) nextSeed++;
+                    if (nextSeed == nb) break;
+                    blockPart[nextSeed] = part;
+                    queue.push_back(nextSeed);
+                }
+                uint32_t b = queue[head++];
+                weights[part] += blockWeight[b];
+                for (uint32_t k = start[b]; k < start[b + 1]; k++) {
+                    uint32_t n = adjacent[k];
+                    if (blockPart[n] == ~0u && (last || weights[part] < target)) {
+                        blockPart[n] = part;
+                        queue.push_back(n);
+                    }
+                }
+            }
+            // Blocks queued but not reached keep their assignment.
+            for (; head < queue.size(); head++) weights[part] += blockWeight[queue[head]];
+        }
+
+        size_t cap = max(target + 1, target + target / 20);
+        vector<int> links(parts, 0);
+        vector<uint32_t> touched;
+        for (int pass = 0; pass < 4; pass++) {
+            bool moved = false;
+            for (uint32_t b = 0; b < nb; b++) {
+                uint32_t own = blockPart[b];
+                touched.clear();
+                for (uint32_t k = start[b]; k < start[b + 1]; k++) {
+                    uint32_t q = blockPart[adjacent[k]];
+                    if (links[q]++ == 0) touched.push_back(q);
+                }
+                uint32_t best = own;
+                int bestGain = 0;
+                for (uint32_t q : touched) {
+                    int gain = links[q] - links[own];
+                    if (q != own && gain > bestGain && weights[q] + blockWeight[b] <= cap && weights[own] > blockWeight[b]) {
+                        best = q;
+                        bestGain = gain;
+                    }
+                }
+                for (uint32_t q : touched) links[q] = 0;
+                if (best != own) {
+                    weights[own] -= blockWeight[b];
+                    weights[best] += blockWeight[b];
+                    blockPart[b] = best;
+                    moved = true;
+                }
+            }
+            if (!moved) break;
+        }
+
+        vector<uint8_t> isCut(table.size(), 0);
+        for (uint32_t b = 0; b < nb; b++) {
+            for (uint32_t p = blocks[b].begin; p < blocks[b].end; p++) {
+                if (order[p]->getTable() != &table) continue;
+                for (uint32_t id : order[p]->getInputIds()) {
+                    if (producer[id] != ~0u && blockPart[producer[id]] != blockPart[b] && !isCut[id]) {
+                        isCut[id] = 1;
+                        cut++;
+                    }
+                }
+            }
+        }
+    }
+
+    size_t partCount() const { return parts; }
+    uint32_t partOfBlock(size_t block) const { return blockPart[block]; }
+    size_t weight(size_t part) const { return weights[part]; }
+    size_t cutStreamCount() const { return cut; }
+};
+
+/**
+ * @class PartitionedFlowsheet
+ * @brief Evaluates a flowsheet as partitions run concurrently, exchanging only their boundary streams.
+ *
+ * Every partition is compiled to local arrays: the streams it produces, then
+ * copies of the feeds and boundary streams it reads. A worker thread per
+ * partition, pinned to the CPUs of a NUMA node (round robin over the nodes),
+ * allocates these arrays itself so that they live in that node's memory.
+ *
+ * Evaluation goes in rounds. In every round each worker sweeps its partition,
+ * recomputing only devices downstream of a changed input after the first
+ * round, and converges the recycle loops it holds; then it sends its boundary
+ * values to the partitions reading them through a SharedRing per partition
+ * pair and receives theirs. Rounds stop when no boundary value moved by more
+ * than the convergence tolerance anywhere: this is a substitution over the
+ * cut streams, which coordinates recycle loops spanning several partitions
+ * and ends after a few rounds when the cut streams carry no loop.
+ *
+ * Like ScenarioBatch, only Mixer, Reactor and Separator devices without
+ * components are supported.
+ */
+class PartitionedFlowsheet
+{
+private:
+    struct Step {
+        uint32_t portBegin;  ///< First input in ports; outputs follow the inputs.
+        uint32_t inCount, outCount;
+    };
+
+    struct LocalBlock {
+        uint32_t stepBegin, stepEnd;
+        uint32_t tearBegin, tearEnd; ///< Range in tears; empty for a single device.
+    };
+
+    /**
+     * @brief Boundary values sent from one partition to another every round.
+     */
+    struct Link {
+        uint32_t from, to;
+        vector<uint32_t> sendIds;     ///< Local ids in the sending partition.
+        vector<uint32_t> receiveIds;  ///< Local ids in the receiving partition, same order.
+        unique_ptr<SharedRing> ring;
+    };
+
+    struct Partition {
+        vector<uint32_t> globalOf;   ///< Table index of every local stream.
+        uint32_t ownedCount = 0;     ///< Local streams [0, ownedCount) are produced here.
+        vector<Step> steps;
+        vector<uint32_t> ports;      ///< Local stream ids.
+        vector<double> fractions;    ///< Output fraction of every output port, parallel to ports.
+        vector<LocalBlock> blocks;
+        vector<uint32_t> tears;      ///< Local ids of the tear streams.
+        vector<uint32_t> sends, receives; ///< Indices of the links.
+        vector<double> flows;        ///< Local values, allocated by the worker.
+        vector<uint8_t> dirty;       ///< Whether a local stream changed since the last step reading it.
+        vector<double> message;
+        RecycleSolver solver;
+        int node = -1;               ///< NUMA node the worker is pinned to, -1 if not pinned.
+        bool localized = false;
+        int sweeps = 0;
+    };
+
+    Flowsheet& sheet;
+    size_t wanted;
+    bool pin;
+    unsigned long planVersion = ~0ul;
+    unique_ptr<Partitioning> partitioning;
+    vector<Partition> partitions;
+    vector<Link> links;
+    vector<vector<int>> nodeCpus;
+    int lastRounds = 0;
+    int lastSweeps = 0;
+
+    void rebuildPlan() {
+        StreamTable& table = sheet.getTable();
+        if (table.componentCount() != 0) throw DeviceException(DeviceError::UnsupportedComponents);
+        const vector<Device*>& order = sheet.evaluationOrder();
+        const vector<Flowsheet::Block>& blocks = sheet.evaluationBlocks();
+        const vector<TearStream>& tears = sheet.tearStreams();
+        for (Device* d : order) {
+            if (d->kind() == DeviceKind::Other || d->getTable() != &table || !d->portsComplete()) {
+                throw DeviceException(DeviceError::UnsupportedDevice);
+            }
+        }
+        partitioning = make_unique<Partitioning>(sheet, wanted);
+        size_t np = partitioning->partCount();
+        partitions = vector<Partition>(np);
+        links.clear();
+
+        // Owned streams first, so that every stream has one (partition, local id).
+        vector<uint32_t> ownerPart(table.size(), ~0u), ownerLocal(table.size(), ~0u);
+        for (uint32_t b = 0; b < blocks.size(); b++) {
+            uint32_t part = partitioning->partOfBlock(b);
+            Partition& pt = partitions[part];
+            for (uint32_t p = blocks[b].begin; p < blocks[b].end; p++) {
+                for (uint32_t id : order[p]->getOutputIds()) {
+                    ownerPart[id] = part;
+                    ownerLocal[id] = static_cast<uint32_t>(pt.globalOf.size());
+                    pt.globalOf.push_back(id);
+                }
+            }
+        }
+        for (Partition& pt : partitions) pt.ownedCount = static_cast<uint32_t>(pt.globalOf.size());
+
+        map<pair<uint32_t, uint32_t>, size_t> linkOf;
+        vector<uint32_t> ghostLocal(table.size(), ~0u);
+        for (uint32_t part = 0; part < np; part++) {
+            Partition& pt = partitions[part];
+            auto local = [&](uint32_t id) {
+                if (ownerPart[id] == part) return ownerLocal[id];
+                if (ghostLocal[id] == ~0u) {
+                    ghostLocal[id] = static_cast<uint32_t>(pt.globalOf.size());
+                    pt.globalOf.push_back(id);
+                    if (ownerPart[id] != ~0u) {
+                        auto key = make_pair(ownerPart[id], part);
+                        auto it = linkOf.find(key);
+                        if (it == linkOf.end()) {
+                            it = linkOf.emplace(key, links.size()).first;
+                            links.push_back(Link{ownerPart[id], part, {}, {}, nullptr});
+                        }
+                        links[it->second].sendIds.push_back(ownerLocal[id]);
+                        links[it->second].receiveIds.push_back(ghostLocal[id]);
+                    }
+                }
+                return ghostLocal[id];
+            };
+            for (uint32_t b = 0; b < blocks.size(); b++) {
+                if (partitioning->partOfBlock(b) != part) continue;
+                LocalBlock lb{static_cast<uint32_t>(pt.steps.size()), 0, static_cast<uint32_t>(pt.tears.size()), 0};
+                for (uint32_t p = blocks[b].begin; p < blocks[b].end; p++) {
+                    Device* d = order[p];
+                    Step step{static_cast<uint32_t>(pt.ports.size()), static_cast<uint32_t>(d->getInputIds().size()),
+                              static_cast<uint32_t>(d->getOutputIds().size())};
+                    for (uint32_t id : d->getInputIds()) pt.ports.push_back(local(id));
+                    for (uint32_t id : d->getOutputIds()) pt.ports.push_back(local(id));
+                    pt.fractions.resize(pt.ports.size() - step.outCount, 0.0);
+                    for (size_t j = 0; j < step.outCount; j++) pt.fractions.push_back(d->outputFraction(j));
+                    pt.steps.push_back(step);
+                }
+                for (uint32_t t = blocks[b].tearBegin; t < blocks[b].tearEnd; t++) pt.tears.push_back(local(tears[t].index));
+                lb.stepEnd = static_cast<uint32_t>(pt.steps.size());
+                lb.tearEnd = static_cast<uint32_t>(pt.tears.size());
+                pt.blocks.push_back(lb);
+            }
+            for (size_t i = pt.ownedCount; i < pt.globalOf.size(); i++) ghostLocal[pt.globalOf[i]] = ~0u;
+        }
+
+        for (size_t l = 0; l < links.size(); l++) {
+            links[l].ring = make_unique<SharedRing>(2 * links[l].sendIds.size());
+            partitions[links[l].from].sends.push_back(static_cast<uint32_t>(l));
+            partitions[links[l].to].receives.push_back(static_cast<uint32_t>(l));
+        }
+        if (pin && nodeCpus.size() > 1) {
+            for (size_t part = 0; part < np; part++) partitions[part].node = static_cast<int>(part % nodeCpus.size());
+        }
+        planVersion = sheet.getWiringVersion();
+    }
+
+    /**
+     * @brief Pin the calling worker to its node and move the partition's arrays to memory it touches first.
+     */
+    void localize(Partition& pt) {
+        if (pt.node >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int c : nodeCpus[pt.node]) CPU_SET(c, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+        if (pt.localized) return;
+        pt.steps = vector<Step>(pt.steps);
+        pt.ports = vector<uint32_t>(pt.ports);
+        pt.fractions = vector<double>(pt.fractions);
+        pt.flows.assign(pt.globalOf.size(), 0.0);
+        pt.dirty.assign(pt.globalOf.size(), 0);
+        pt.localized = true;
+    }
+
+    void runStep(Partition& pt, const Step& step, bool force) {
+        const uint32_t* in = pt.ports.data() + step.portBegin;
+        const uint32_t* out = in + step.inCount;
+        bool stale = force;
+        for (uint32_t i = 0; i < step.inCount && !stale; i++) stale = pt.dirty[in[i]];
+        if (!stale) return;
+        NeumaierSum sum;
+        for (uint32_t i = 0; i < step.inCount; i++) sum.add(pt.flows[in[i]]);
+        const double* frac = pt.fractions.data() + step.portBegin + step.inCount;
+        for (uint32_t j = 0; j < step.outCount; j++) {
+            double v = sum.result() * frac[j];
+            if (v != pt.flows[out[j]]) {
+                pt.flows[out[j]] = v;
+                pt.dirty[out[j]] = 1;
+            }
+        }
+    }
+
+    /**
+     * @brief Sweep a partition once, converging its recycle loops.
+     * @param force Run every device, not only those with a changed input.
+     */
+    void sweep(Partition& pt, bool force) {
+        for (const LocalBlock& lb : pt.blocks) {
+            if (lb.tearBegin == lb.tearEnd) {
+                for (uint32_t s = lb.stepBegin; s < lb.stepEnd; s++) runStep(pt, pt.steps[s], force);
+                continue;
+            }
+            bool stale = force;
+            for (uint32_t s = lb.stepBegin; s < lb.stepEnd && !stale; s++) {
+                const Step& step = pt.steps[s];
+                for (uint32_t i = 0; i < step.inCount && !stale; i++) stale = pt.dirty[pt.ports[step.portBegin + i]];
+            }
+            if (!stale) continue;
+            const uint32_t* t = pt.tears.data() + lb.tearBegin;
+            size_t tearCount = lb.tearEnd - lb.tearBegin;
+            int sweeps = pt.solver.iterate(
+                tearCount, [&] { for (uint32_t s = lb.stepBegin; s < lb.stepEnd; s++) runStep(pt, pt.steps[s], true); },
+                [&](double* x) { for (size_t i = 0; i < tearCount; i++) x[i] = pt.flows[t[i]]; },
+                [&](const double* x) { for (size_t i = 0; i < tearCount; i++) pt.flows[t[i]] = x[i]; });
+            if (sweeps < 0) throw DeviceException(DeviceError::NotConverged);
+            pt.sweeps += sweeps;
+        }
+    }
+
+public:
+    /**
+     * @brief Prepare the partitioned evaluation of a flowsheet.
+     * @param fs The flowsheet; its wiring may change later, the partitions follow it.
+     * @param partCount Number of partitions (and worker threads).
+     * @param pinToNodes Pin the workers to the NUMA nodes, round robin, when there are several.
+     */
+    PartitionedFlowsheet(Flowsheet& fs, size_t partCount, bool pinToNodes = true)
+        : sheet(fs), wanted(max<size_t>(1, partCount)), pin(pinToNodes), nodeCpus(numaNodeCpus()) {}
+
+    /**
+     * @brief The partitioning of the current wiring.
+     */
+    const Partitioning& getPartitioning() {
+        if (planVersion != sheet.getWiringVersion()) rebuildPlan();
+        return *partitioning;
+    }
+
+    /**
+     * @brief Number of exchange rounds done by the last evaluate().
+     */
+    int getLastRounds() const { return lastRounds; }
+
+    /**
+     * @brief Number of local recycle sweeps done by the last evaluate(), over every partition.
+     */
+    int getLastRecycleSweeps() const { return lastSweeps; }
+
+    /**
+     * @brief Evaluate every partition until the boundary streams agree, and write the flows to the table.
+     *
+     * The flowsheet must not be used by another thread meanwhile.
+     *
+     * @throws DeviceException UnsupportedComponents or UnsupportedDevice for a
+     * flowsheet that cannot be partitioned, NotConverged if a recycle loop or
+     * the exchange did not converge.
+     */
+    void evaluate() {
+        if (planVersion != sheet.getWiringVersion()) rebuildPlan();
+        const ConvergenceOptions& options = sheet.getConvergenceOptions();
+        double* table = sheet.getTable().data();
+        size_t np = partitions.size();
+
+        atomic<bool> anyChange{false}, failed{false};
+        bool done = false, converged = false;
+        int rounds = 0;
+        auto endRound = [&]() noexcept {
+            rounds++;
+            converged = !anyChange.exchange(false);
+            done = failed.load() || converged || rounds >= options.maxIterations;
+        };
+        barrier<decltype(endRound)> sync(static_cast<ptrdiff_t>(np), endRound);
+        vector<exception_ptr> failures(np);
+
+        auto work = [&](size_t part) {
+            Partition& pt = partitions[part];
+            bool ok = true;
+            try {
+                localize(pt);
+                pt.solver.setOptions(options);
+                pt.sweeps = 0;
+                for (size_t i = pt.ownedCount; i < pt.globalOf.size(); i++) pt.flows[i] = table[pt.globalOf[i]];
+                for (size_t i = 0; i < pt.ownedCount; i++) pt.flows[i] = table[pt.globalOf[i]];
+            } catch (...) {
+                failures[part] = current_exception();
+                failed.store(true);
+                ok = false;
+            }
+            for (bool first = true;; first = false) {
+                if (ok) {
+                    try {
+                        sweep(pt, first);
+                    } catch (...) {
+                        failures[part] = current_exception();
+                        failed.store(true);
+                        ok = false;
+                    }
+                }
+                fill(pt.dirty.begin(), pt.dirty.end(), 0);
+                for (uint32_t l : pt.sends) {
+                    Link& link = links[l];
+                    pt.message.resize(link.sendIds.size());
+                    for (size_t i = 0; i < link.sendIds.size(); i++) pt.message[i] = ok ? pt.flows[link.sendIds[i]] : 0.0;
+                    link.ring->push(pt.message.data(), pt.message.size());
+                }
+                bool changed = false;
+                for (uint32_t l : pt.receives) {
+                    Link& link = links[l];
+                    pt.message.resize(link.receiveIds.size());
+                    link.ring->pop(pt.message.data(), pt.message.size());
+                    if (!ok) continue;
+                    for (size_t i = 0; i < link.receiveIds.size(); i++) {
+                        double& v = pt.flows[link.receiveIds[i]];
+                        double m = pt.message[i];
+                        if (m == v) continue;
+                        changed = changed || abs(m - v) > options.tolerance * max(1.0, abs(m));
+                        v = m;
+                        pt.dirty[link.receiveIds[i]] = 1;
+                    }
+                }
+                if (changed) anyChange.store(true);
+                sync.arrive_and_wait();
+                if (done) break;
+            }
+            if (ok) {
+                for (size_t i = 0; i < pt.ownedCount; i++) table[pt.globalOf[i]] = pt.flows[i];
+            }
+        };
+
+        vector<thread> workers;
+        for (size_t part = 0; part < np; part++) workers.emplace_back(work, part);
+        for (thread& t : workers) t.join();
+
+        lastRounds = rounds;
+        lastSweeps = 0;
+        for (const Partition& pt : partitions) lastSweeps += pt.sweeps;
+        for (exception_ptr& e : failures) {
+            if (e) rethrow_exception(e);
+        }
+        if (!converged) throw DeviceException(DeviceError::NotConverged);
+        sheet.getTable().clearChanged();
+    }
+};
+#endif // PARTITIONED_FLOWSHEET_CPP
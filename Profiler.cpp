@@ -0,0 +1,525 @@
+#ifndef PROFILER_CPP
+#define PROFILER_CPP
+
+/**
+ * @file Profiler.cpp
+ *
+ * @brief Optional timing of device updates and recycle loops, with trace and flat profile export.
+ *
+ * Instrumentation is compiled in only when DEVICE_PROFILING is defined; the
+ * PROFILE_* macros expand to nothing otherwise.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class ProfileStats
+ * @brief Call count, total time and a log-scale histogram of the durations of one unit or type.
+ *
+ * Durations fall in buckets of a quarter of an octave (percentiles are exact
+ * to about 19%). Only the buckets that were hit are stored, so a unit whose
+ * timings are steady costs a few bytes.
+ */
+class ProfileStats
+{
+private:
+    vector<pair<uint16_t, uint64_t>> buckets; ///< Sorted (bucket, count) of the non-empty buckets.
+
+    static uint16_t bucketOf(uint64_t ns) {
+        if (ns < 16) return static_cast<uint16_t>(ns);
+        int e = 63 - __builtin_clzll(ns);
+        return static_cast<uint16_t>(16 + (e - 4) * 4 + ((ns >> (e - 2)) & 3));
+    }
+
+    static uint64_t bucketStart(uint16_t b) {
+        if (b < 16) return b;
+        int e = (b - 16) / 4 + 4;
+        return (uint64_t(4 + (b - 16) % 4)) << (e - 2);
+    }
+
+public:
+    uint64_t calls = 0;
+    uint64_t totalNs = 0;
+    uint64_t maxNs = 0;
+
+    void add(uint64_t ns) {
+        calls++;
+        totalNs += ns;
+        maxNs = max(maxNs, ns);
+        uint16_t b = bucketOf(ns);
+        auto it = lower_bound(buckets.begin(), buckets.end(), make_pair(b, uint64_t(0)));
+        if (it != buckets.end() && it->first == b) it->second++;
+        else buckets.insert(it, {b, 1});
+    }
+
+    /**
+     * @brief Add the calls recorded by another ProfileStats.
+     */
+    void merge(const ProfileStats& other) {
+        calls += other.calls;
+        totalNs += other.totalNs;
+        maxNs = max(maxNs, other.maxNs);
+        for (auto& [b, count] : other.buckets) {
+            auto it = lower_bound(buckets.begin(), buckets.end(), make_pair(b, uint64_t(0)));
+            if (it != buckets.end() && it->first == b) it->second += count;
+            else buckets.insert(it, {b, count});
+        }
+    }
+
+    /**
+     * @brief Duration below which a fraction p of the calls fall, in nanoseconds.
+     */
+    uint64_t percentileNs(double p) const {
+        uint64_t rank = static_cast<uint64_t>(p * calls);
+        uint64_t seen = 0;
+        for (auto& [b, count] : buckets) {
+            seen += count;
+            if (seen > rank) return min(bucketStart(b + 1), maxNs);
+        }
+        return maxNs;
+    }
+};
+
+/**
+ * @class Profiler
+ * @brief Collects the timings recorded by the PROFILE_* macros.
+ *
+ * Every timed call updates the statistics of its unit and of its type, and is
+ * appended to a bounded trace buffer (the oldest events are overwritten) that
+ * can be exported in the Chrome trace-event format (chrome://tracing,
+ * Perfetto). Recycle loops record their sweep counts.
+ *
+ * Units are identified by a number from newUnitId() kept by the device or
+ * batch, not by address, so a unit created where an old one was freed gets
+ * statistics of its own. Every thread records into a log of its own, under a
+ * lock only the readers ever contend for, so timing a parallel evaluation
+ * does not serialize it. The reading methods merge the logs of all threads.
+ */
+class Profiler
+{
+public:
+    /**
+     * @brief One timed span of the trace.
+     */
+    struct TraceEvent {
+        const string* name;
+        const char* category;
+        uint64_t startNs, durationNs;
+        uint32_t thread;
+        int sweeps; ///< Sweeps of a recycle loop, -1 for other events.
+    };
+
+    /**
+     * @brief Statistics of one timed unit (a device, or a batch of devices).
+     */
+    struct UnitStats {
+        string name; ///< Type name and unit number, e.g. "Mixer #3".
+        string type;
+        ProfileStats stats;
+    };
+
+private:
+    /**
+     * @brief What one thread recorded since the last reset().
+     */
+    struct ThreadLog {
+        mutex lock;                  ///< Taken by the owning thread on every record, and by the readers.
+        thread::id owner;
+        uint32_t number;             ///< Number of the thread in the trace.
+        unordered_map<uint64_t, UnitStats> units;
+        map<string, ProfileStats> types;
+        unordered_map<type_index, string> typeNames;
+        ProfileStats recycleStats;   ///< Durations of the recycle loop solves.
+        uint64_t recycleSweeps = 0;
+        uint64_t recycleFailures = 0;
+        int maxRecycleSweeps = 0;
+        vector<TraceEvent> trace;
+        size_t traceNext = 0;        ///< Total number of events recorded; trace is a ring over it.
+    };
+
+    mutex lock;                      ///< Guards logs and the merged statistics.
+    atomic<int64_t> originNs{steadyNs()};
+    atomic<size_t> traceCapacity{1 << 20};
+    vector<unique_ptr<ThreadLog>> logs;
+    unordered_map<uint64_t, UnitStats> mergedUnits;
+    const string recycleName = "recycle loop";
+
+    static int64_t steadyNs() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static uint32_t threadNumber() {
+        static atomic<uint32_t> next{0};
+        thread_local uint32_t number = next++;
+        return number;
+    }
+
+    /**
+     * @brief The log of the calling thread, registered on first use.
+     */
+    ThreadLog& local() {
+        thread_local ThreadLog* cached = nullptr;
+        thread_local const Profiler* owner = nullptr;
+        if (owner == this) return *cached;
+        lock_guard<mutex> guard(lock);
+        thread::id self = this_thread::get_id();
+        auto it = find_if(logs.begin(), logs.end(), [&](const unique_ptr<ThreadLog>& l) { return l->owner == self; });
+        if (it == logs.end()) {
+            logs.push_back(make_unique<ThreadLog>());
+            logs.back()->owner = self;
+            logs.back()->number = threadNumber();
+            it = logs.end() - 1;
+        }
+        cached = it->get();
+        owner = this;
+        return *cached;
+    }
+
+    static const string& typeName(ThreadLog& log, type_index type) {
+        auto it = log.typeNames.find(type);
+        if (it != log.typeNames.end()) return it->second;
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+        string name = status == 0 ? demangled : type.name();
+        free(demangled);
+        return log.typeNames.emplace(type, name).first->second;
+    }
+
+    static UnitStats& unit(ThreadLog& log, uint64_t u, const string& type) {
+        auto it = log.units.find(u);
+        if (it != log.units.end()) return it->second;
+        UnitStats& s = log.units[u];
+        s.type = type;
+        s.name = type + " #" + to_string(u);
+        return s;
+    }
+
+    void pushTrace(ThreadLog& log, const TraceEvent& e) {
+        size_t capacity = traceCapacity.load(memory_order_relaxed);
+        if (capacity == 0) return;
+        if (log.trace.size() < capacity) log.trace.push_back(e);
+        else log.trace[log.traceNext % capacity] = e;
+        log.traceNext++;
+    }
+
+    /**
+     * @brief Statistics of every unit over all threads; the caller holds lock.
+     *
+     * Entries are refreshed in place, so pointers handed out by unitStats() stay valid.
+     */
+    void mergeUnits() {
+        for (auto& [u, s] : mergedUnits) s.stats = ProfileStats();
+        for (auto& log : logs) {
+            lock_guard<mutex> guard(log->lock);
+            for (auto& [u, s] : log->units) {
+                auto [it, added] = mergedUnits.emplace(u, s);
+                if (!added) it->second.stats.merge(s.stats);
+            }
+        }
+    }
+
+    /**
+     * @brief Statistics of every type over all threads; the caller holds lock.
+     */
+    map<string, ProfileStats> mergeTypes() {
+        map<string, ProfileStats> types;
+        for (auto& log : logs) {
+            lock_guard<mutex> guard(log->lock);
+            for (auto& [name, s] : log->types) types[name].merge(s);
+        }
+        return types;
+    }
+
+    /**
+     * @brief Apply f to the log of every thread under its lock.
+     */
+    template <class F>
+    void forEachLog(F f) {
+        lock_guard<mutex> guard(lock);
+        for (auto& log : logs) {
+            lock_guard<mutex> logGuard(log->lock);
+            f(*log);
+        }
+    }
+
+    static void writeJsonString(ostream& out, const string& s) {
+        out << '"';
+        for (char c : s) {
+            if (c == '"' || c == '\\') out << '\\' << c;
+            else if (static_cast<unsigned char>(c) < 0x20) out << ' ';
+            else out << c;
+        }
+        out << '"';
+    }
+
+public:
+    /**
+     * @brief The profiler used by the PROFILE_* macros.
+     *
+     * Intentionally never destroyed, so units timed during static destruction stay valid.
+     */
+    static Profiler& global() {
+        static Profiler* profiler = new Profiler();
+        return *profiler;
+    }
+
+    /**
+     * @brief A new unit number, unique for the whole run.
+     */
+    static uint64_t newUnitId() {
+        static atomic<uint64_t> next{1};
+        return next.fetch_add(1, memory_order_relaxed);
+    }
+
+    uint64_t nowNs() const { return steadyNs() - originNs.load(memory_order_relaxed); }
+
+    /**
+     * @brief Record one call of a device.
+     * @param u The unit number of the device.
+     * @param type Its dynamic type.
+     */
+    void recordDevice(uint64_t u, type_index type, uint64_t startNs, uint64_t endNs) {
+        ThreadLog& log = local();
+        lock_guard<mutex> guard(log.lock);
+        const string& name = typeName(log, type);
+        UnitStats& s = unit(log, u, name);
+        s.stats.add(endNs - startNs);
+        log.types[name].add(endNs - startNs);
+        pushTrace(log, TraceEvent{&s.name, "device", startNs, endNs - startNs, log.number, -1});
+    }
+
+    /**
+     * @brief Record one run of a batch kernel over several devices.
+     * @param u The unit number of the batch.
+     * @param kind Name of the kind of the batched devices.
+     * @param devices Number of devices in the batch.
+     */
+    void recordBatch(uint64_t u, const char* kind, size_t devices, uint64_t startNs, uint64_t endNs) {
+        ThreadLog& log = local();
+        lock_guard<mutex> guard(log.lock);
+        string type = string("batch ") + kind;
+        UnitStats& s = unit(log, u, type);
+        if (s.stats.calls == 0) s.name += " (" + to_string(devices) + " devices)";
+        s.stats.add(endNs - startNs);
+        log.types[type].add(endNs - startNs);
+        pushTrace(log, TraceEvent{&s.name, "batch", startNs, endNs - startNs, log.number, -1});
+    }
+
+    /**
+     * @brief Record one recycle loop solve.
+     * @param sweeps Number of sweeps done, -1 if the loop did not converge.
+     */
+    void recordRecycle(int sweeps, uint64_t startNs, uint64_t endNs) {
+        ThreadLog& log = local();
+        lock_guard<mutex> guard(log.lock);
+        log.recycleStats.add(endNs - startNs);
+        if (sweeps < 0) log.recycleFailures++;
+        else log.recycleSweeps += sweeps;
+        log.maxRecycleSweeps = max(log.maxRecycleSweeps, sweeps);
+        pushTrace(log, TraceEvent{&recycleName, "recycle", startNs, endNs - startNs, log.number, sweeps});
+    }
+
+    /**
+     * @brief Forget every recorded call.
+     */
+    void reset() {
+        forEachLog([](ThreadLog& log) {
+            log.units.clear();
+            log.types.clear();
+            log.recycleStats = ProfileStats();
+            log.recycleSweeps = log.recycleFailures = 0;
+            log.maxRecycleSweeps = 0;
+            log.trace.clear();
+            log.traceNext = 0;
+        });
+        lock_guard<mutex> guard(lock);
+        mergedUnits.clear();
+        originNs.store(steadyNs(), memory_order_relaxed);
+    }
+
+    /**
+     * @brief Set the number of trace events kept (0 disables the trace), dropping the current ones.
+     */
+    void setTraceCapacity(size_t n) {
+        traceCapacity.store(n, memory_order_relaxed);
+        forEachLog([](ThreadLog& log) {
+            log.trace.clear();
+            log.traceNext = 0;
+        });
+    }
+
+    /**
+     * @brief Statistics of a device or batch, over all threads.
+     * @param u The unit number (Device::getProfileId(), DeviceBatch::getProfileId()).
+     * @return Null if the unit was never timed. Valid until reset(), and
+     * refreshed by every later call of a reading method.
+     */
+    const UnitStats* unitStats(uint64_t u) {
+        lock_guard<mutex> guard(lock);
+        mergeUnits();
+        auto it = mergedUnits.find(u);
+        return it == mergedUnits.end() ? nullptr : &it->second;
+    }
+
+    /**
+     * @brief Statistics of every device type, by type name.
+     */
+    map<string, ProfileStats> typeStats() {
+        lock_guard<mutex> guard(lock);
+        return mergeTypes();
+    }
+
+    ProfileStats recycleLoopStats() {
+        ProfileStats total;
+        forEachLog([&](ThreadLog& log) { total.merge(log.recycleStats); });
+        return total;
+    }
+
+    uint64_t totalRecycleSweeps() {
+        uint64_t total = 0;
+        forEachLog([&](ThreadLog& log) { total += log.recycleSweeps; });
+        return total;
+    }
+
+    uint64_t failedRecycleLoops() {
+        uint64_t total = 0;
+        forEachLog([&](ThreadLog& log) { total += log.recycleFailures; });
+        return total;
+    }
+
+    int maxSweepsPerLoop() {
+        int most = 0;
+        forEachLog([&](ThreadLog& log) { most = max(most, log.maxRecycleSweeps); });
+        return most;
+    }
+
+    /**
+     * @brief Write the latest trace events of all threads as Chrome trace-event JSON.
+     */
+    void writeChromeTrace(ostream& out) {
+        lock_guard<mutex> guard(lock);
+        vector<TraceEvent> events;
+        for (auto& log : logs) {
+            lock_guard<mutex> logGuard(log->lock);
+            events.insert(events.end(), log->trace.begin(), log->trace.end());
+        }
+        sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) { return a.startNs < b.startNs; });
+        size_t capacity = traceCapacity.load(memory_order_relaxed);
+        size_t first = events.size() > capacity ? events.size() - capacity : 0;
+        out << "{\"traceEvents\":[";
+        for (size_t i = first; i < events.size(); i++) {
+            const TraceEvent& e = events[i];
+            out << (i > first ? ",\n" : "\n") << "{\"name\":";
+            writeJsonString(out, *e.name);
+            out << ",\"cat\":\"" << e.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+                << fixed << setprecision(3) << ",\"ts\":" << e.startNs / 1000.0 << ",\"dur\":" << e.durationNs / 1000.0
+                << defaultfloat;
+            if (e.sweeps >= 0) out << ",\"args\":{\"sweeps\":" << e.sweeps << "}";
+            out << "}";
+        }
+        out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    }
+
+    /**
+     * @brief Write a flat text profile: types, then the units by decreasing total time, then recycle loops.
+     * @param out The stream to write to.
+     * @param maxUnits Number of units listed.
+     */
+    void writeFlatProfile(ostream& out, size_t maxUnits = 50) {
+        ProfileStats recycleStats = recycleLoopStats();
+        uint64_t recycleSweeps = totalRecycleSweeps();
+        uint64_t recycleFailures = failedRecycleLoops();
+        int maxRecycleSweeps = maxSweepsPerLoop();
+
+        lock_guard<mutex> guard(lock);
+        map<string, ProfileStats> types = mergeTypes();
+        mergeUnits();
+        uint64_t total = 0;
+        for (auto& [name, s] : types) total += s.totalNs;
+
+        auto row = [&](const string& name, const ProfileStats& s) {
+            out << setw(40) << left << name << right << setw(10) << s.calls
+                << fixed << setprecision(3) << setw(12) << s.totalNs / 1e6
+                << setw(8) << setprecision(1) << (total ? 100.0 * s.totalNs / total : 0.0)
+                << setw(10) << s.percentileNs(0.5) << setw(10) << s.percentileNs(0.9)
+                << setw(10) << s.percentileNs(0.99) << setw(10) << s.maxNs << defaultfloat << '\n';
+        };
+        auto header = [&](const char* title) {
+            out << setw(40) << left << title << right << setw(10) << "calls" << setw(12) << "total ms"
+                << setw(8) << "%" << setw(10) << "p50 ns" << setw(10) << "p90 ns"
+                << setw(10) << "p99 ns" << setw(10) << "max ns" << '\n';
+        };
+
+        header("type");
+        vector<pair<const string*, const ProfileStats*>> sorted;
+        for (auto& [name, s] : types) sorted.emplace_back(&name, &s);
+        sort(sorted.begin(), sorted.end(), [](auto& a, auto& b) { return a.second->totalNs > b.second->totalNs; });
+        for (auto& [name, s] : sorted) row(*name, *s);
+
+        out << '\n';
+        header("unit");
+        vector<const UnitStats*> hot;
+        for (auto& [u, s] : mergedUnits) hot.push_back(&s);
+        sort(hot.begin(), hot.end(), [](auto* a, auto* b) { return a->stats.totalNs > b->stats.totalNs; });
+        if (hot.size() > maxUnits) hot.resize(maxUnits);
+        for (const UnitStats* s : hot) row(s->name, s->stats);
+
+        if (recycleStats.calls) {
+            out << "\nrecycle loops: " << recycleStats.calls << " solves, " << recycleSweeps << " sweeps, "
+                << "max " << maxRecycleSweeps << " sweeps per solve, " << recycleFailures << " not converged\n";
+        }
+    }
+};
+
+/**
+ * @class ProfileScope
+ * @brief Times the enclosing scope as one call of a device.
+ */
+class ProfileScope
+{
+private:
+    uint64_t unit;
+    type_index type;
+    uint64_t start;
+
+public:
+    ProfileScope(uint64_t u, type_index t): unit(u), type(t), start(Profiler::global().nowNs()) {}
+    ~ProfileScope() { Profiler::global().recordDevice(unit, type, start, Profiler::global().nowNs()); }
+};
+
+#ifdef DEVICE_PROFILING
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+/// Time the rest of the enclosing scope as one call of the device d.
+#define PROFILE_DEVICE(d) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)((d)->getProfileId(), typeid(*(d)))
+/// Remember the start of a timed region.
+#define PROFILE_START(var) uint64_t var = Profiler::global().nowNs()
+/// Record the run of a batch started at start.
+#define PROFILE_BATCH(batch, kind, devices, start) \
+    Profiler::global().recordBatch((batch)->getProfileId(), (kind), (devices), (start), Profiler::global().nowNs())
+/// Record a recycle loop solve started at start.
+#define PROFILE_RECYCLE(sweeps, start) Profiler::global().recordRecycle((sweeps), (start), Profiler::global().nowNs())
+#else
+#define PROFILE_DEVICE(d) ((void)0)
+#define PROFILE_START(var) ((void)0)
+#define PROFILE_BATCH(batch, kind, devices, start) ((void)0)
+#define PROFILE_RECYCLE(sweeps, start) ((void)0)
+#endif
+#endif // PROFILER_CPP
@@ -0,0 +1,242 @@
+#ifndef RECYCLE_SOLVER_CPP
+#define RECYCLE_SOLVER_CPP
+
+/**
+ * @file RecycleSolver.cpp
+ *
+ * @brief Tear-stream convergence of recycle loops.
+ */
+
+#include "Separator.cpp"
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * @struct ConvergenceOptions
+ * @brief Settings of the recycle loop convergence.
+ */
+struct ConvergenceOptions
+{
+    /**
+     * @brief Update applied to the tear streams between two sweeps of a loop.
+     */
+    enum Method {
+        DirectSubstitution, ///< Next guess is the swept value.
+        Wegstein,           ///< Per-stream secant acceleration with a bounded q factor.
+        Broyden             ///< Quasi-Newton update of the inverse Jacobian on the whole tear vector.
+    };
+
+    Method method = Wegstein;
+    double tolerance = 1e-9;    ///< Converged when |swept - guess| <= tolerance * max(1, |swept|) on every tear.
+    int maxIterations = 200;    ///< Sweeps before giving up on a loop.
+    double wegsteinMin = -5.0;  ///< Lower bound of the Wegstein q factor.
+    double wegsteinMax = 0.0;   ///< Upper bound of the Wegstein q factor (0 is direct substitution).
+};
+
+/**
+ * @struct TearStream
+ * @brief A stream cut to break a recycle loop.
+ */
+struct TearStream
+{
+    StreamTable* table;
+    uint32_t index;
+};
+
+/**
+ * @class RecycleSolver
+ * @brief Iterates the devices of one recycle loop until the tear streams converge.
+ *
+ * The devices of the loop must be given in an order that is topological once
+ * the tear streams are cut. One sweep writes the current guess into the tear
+ * streams, runs every device and reads back the value produced for the tears.
+ * When the table tracks components, the component flows of the tears are
+ * converged together with their mass flows.
+ */
+class RecycleSolver
+{
+private:
+    ConvergenceOptions options;
+    vector<double> x, g, xPrev, gPrev, f, fPrev, h, step, scratch; ///< Reused work arrays.
+
+    /**
+     * @brief Number of unknowns of a set of tears: the mass flow plus every component flow.
+     */
+    static size_t unknownCount(const TearStream* tears, size_t n) {
+        size_t count = 0;
+        for (size_t i = 0; i < n; i++) count += 1 + tears[i].table->componentCount();
+        return count;
+    }
+
+    void writeTears(const TearStream* tears, size_t n, const double* values) {
+        for (size_t i = 0; i < n; i++) {
+            StreamTable& t = *tears[i].table;
+            t.setFlow(tears[i].index, *values++);
+            double* comps = t.componentData(tears[i].index);
+            for (size_t c = 0; c < t.componentCount(); c++) comps[c] = *values++;
+        }
+    }
+
+    void readTears(const TearStream* tears, size_t n, double* values) {
+        for (size_t i = 0; i < n; i++) {
+            const StreamTable& t = *tears[i].table;
+            *values++ = t.flow(tears[i].index);
+            const double* comps = t.componentData(tears[i].index);
+            for (size_t c = 0; c < t.componentCount(); c++) *values++ = comps[c];
+        }
+    }
+
+    bool converged(size_t n) const {
+        for (size_t i = 0; i < n; i++) {
+            if (abs(g[i] - x[i]) > options.tolerance * max(1.0, abs(g[i]))) return false;
+        }
+        return true;
+    }
+
+    void wegsteinStep(size_t n, int iteration) {
+        for (size_t i = 0; i < n; i++) {
+            double next = g[i];
+            double dx = x[i] - xPrev[i];
+            if (iteration > 0 && dx != 0.0) {
+                double s = (g[i] - gPrev[i]) / dx;
+                if (s != 1.0) {
+                    double q = clamp(s / (s - 1.0), options.wegsteinMin, options.wegsteinMax);
+                    next = q * x[i] + (1.0 - q) * g[i];
+                }
+            }
+            xPrev[i] = x[i];
+            gPrev[i] = g[i];
+            x[i] = next;
+        }
+    }
+
+    /**
+     * @brief Good Broyden update of the inverse Jacobian H of f(x) = g(x) - x, then x -= H f.
+     *
+     * H starts at -I, which makes the first step a direct substitution.
+     */
+    void broydenStep(size_t n, int iteration) {
+        for (size_t i = 0; i < n; i++) f[i] = g[i] - x[i];
+        if (iteration == 0) {
+            h.assign(n * n, 0.0);
+            for (size_t i = 0; i < n; i++) h[i * n + i] = -1.0;
+        } else {
+            // dx = x - xPrev, df = f - fPrev; H += (dx - H df) (dx^T H) / (dx^T H df)
+            for (size_t i = 0; i < n; i++) {
+                double hdf = 0.0;
+                for (size_t j = 0; j < n; j++) hdf += h[i * n + j] * (f[j] - fPrev[j]);
+                step[i] = (x[i] - xPrev[i]) - hdf;
+            }
+            double denom = 0.0;
+            for (size_t j = 0; j < n; j++) {
+                double dxh = 0.0;
+                for (size_t i = 0; i < n; i++) dxh += (x[i] - xPrev[i]) * h[i * n + j];
+                scratch[j] = dxh;
+                denom += dxh * (f[j] - fPrev[j]);
+            }
+            if (denom != 0.0) {
+                for (size_t i = 0; i < n; i++) {
+                    for (size_t j = 0; j < n; j++) h[i * n + j] += step[i] * scratch[j] / denom;
+                }
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            xPrev[i] = x[i];
+            fPrev[i] = f[i];
+        }
+        for (size_t i = 0; i < n; i++) {
+            double hf = 0.0;
+            for (size_t j = 0; j < n; j++) hf += h[i * n + j] * f[j];
+            x[i] -= hf;
+        }
+    }
+
+public:
+    RecycleSolver() = default;
+    explicit RecycleSolver(const ConvergenceOptions& o): options(o) {}
+
+    const ConvergenceOptions& getOptions() const { return options; }
+    void setOptions(const ConvergenceOptions& o) { options = o; }
+
+    /**
+     * @brief Iterate sweeps of a loop until the tear values converge.
+     * @param n Number of unknowns.
+     * @param sweep Runs every device of the loop once.
+     * @param read Copies the current tear values into an array of n values.
+     * @param write Copies an array of n values into the tears.
+     * @return Number of sweeps done, or -1 if the loop did not converge.
+     */
+    template <class Sweep, class Read, class Write>
+    int iterate(size_t n, Sweep sweep, Read read, Write write) {
+        for (auto* v : {&x, &g, &xPrev, &gPrev, &f, &fPrev, &step, &scratch}) v->assign(n, 0.0);
+        read(x.data());
+
+        for (int it = 0; it < options.maxIterations; it++) {
+            write(x.data());
+            sweep();
+            read(g.data());
+
+            if (converged(n)) return it + 1;
+
+            switch (options.method) {
+            case ConvergenceOptions::DirectSubstitution:
+                x = g;
+                break;
+            case ConvergenceOptions::Wegstein:
+                wegsteinStep(n, it);
+                break;
+            case ConvergenceOptions::Broyden:
+                broydenStep(n, it);
+                break;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * @brief Converge one recycle loop, starting from the current tear stream values.
+     * @param devices Devices of the loop, topologically ordered with the tears cut.
+     * @param deviceCount Number of devices.
+     * @param tears Tear streams of the loop.
+     * @param tearCount Number of tear streams.
+     * @return Number of sweeps done, or -1 if the loop did not converge.
+     */
+    int solve(Device* const* devices, size_t deviceCount, const TearStream* tears, size_t tearCount) {
+        return iterate(unknownCount(tears, tearCount),
+                       [&] { for (size_t d = 0; d < deviceCount; d++) devices[d]->update(); },
+                       [&](double* values) { readTears(tears, tearCount, values); },
+                       [&](const double* values) { writeTears(tears, tearCount, values); });
+    }
+
+    /**
+     * @brief Converge one recycle loop whose streams live in raw arrays.
+     * @param sweep Runs every device of the loop once.
+     * @param flow Mass flow of every stream.
+     * @param components Component flows, componentCount consecutive values per stream.
+     * @param componentCount Number of components per stream.
+     * @param tearIds Indices of the tear streams.
+     * @param tearCount Number of tear streams.
+     * @return Number of sweeps done, or -1 if the loop did not converge.
+     */
+    template <class Sweep>
+    int solve(Sweep sweep, double* flow, double* components, size_t componentCount,
+              const uint32_t* tearIds, size_t tearCount) {
+        auto read = [&](double* values) {
+            for (size_t i = 0; i < tearCount; i++) {
+                *values++ = flow[tearIds[i]];
+                const double* comps = components + size_t(tearIds[i]) * componentCount;
+                for (size_t c = 0; c < componentCount; c++) *values++ = comps[c];
+            }
+        };
+        auto write = [&](const double* values) {
+            for (size_t i = 0; i < tearCount; i++) {
+                flow[tearIds[i]] = *values++;
+                double* comps = components + size_t(tearIds[i]) * componentCount;
+                for (size_t c = 0; c < componentCount; c++) comps[c] = *values++;
+            }
+        };
+        return iterate(tearCount * (1 + componentCount), sweep, read, write);
+    }
+};
+#endif // RECYCLE_SOLVER_CPP
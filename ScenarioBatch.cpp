@@ -0,0 +1,192 @@
+#ifndef SCENARIO_BATCH_CPP
+#define SCENARIO_BATCH_CPP
+
+/**
+ * @file ScenarioBatch.cpp
+ *
+ * @brief Evaluation of many independent feed scenarios through one flowsheet in a single pass.
+ */
+
+#include "Flowsheet.cpp"
+
+using namespace std;
+
+/**
+ * @class ScenarioBatch
+ * @brief Gives every stream of a flowsheet a lane of K scenario values and evaluates all lanes at once.
+ *
+ * The lanes of one stream are contiguous (stream-major layout), so each device
+ * is visited once per pass and its inner loop runs over the K scenarios. Mixer,
+ * Reactor and Separator devices are evaluated from their kind and
+ * outputFraction(), with the same arithmetic as updateOutputs(), so every lane
+ * matches a scalar evaluate() of the same feeds exactly outside recycle loops.
+ * Other devices are run lane by lane through their updateOutputs().
+ *
+ * Recycle loops converge all lanes together, with the flowsheet's convergence
+ * options; Broyden is replaced by Wegstein, whose per-value update keeps the
+ * lanes independent (a Broyden Jacobian over every lane would be dense in K).
+ * Only total mass flows are batched: the flowsheet must not track components.
+ */
+class ScenarioBatch
+{
+private:
+    /**
+     * @brief One device of the evaluation order, compiled to port ranges.
+     */
+    struct Step {
+        uint32_t portBegin;  ///< First input in ports; outputs follow the inputs.
+        uint32_t inCount, outCount;
+        Device* fallback;    ///< Device run lane by lane, or null for a kernel step.
+    };
+
+    Flowsheet& sheet;
+    size_t lanes;
+    vector<double> values;           ///< Lane k of stream s at s * lanes + k.
+    vector<Step> steps;              ///< Devices in evaluation order.
+    vector<uint32_t> ports;          ///< Stream indices of the step ports.
+    vector<double> fractions;        ///< Output fraction of every output port, parallel to ports.
+    vector<double> sum;              ///< Scratch lane of the summed inputs.
+    vector<double> compensation;     ///< Scratch lane of their rounding errors.
+    unsigned long planVersion = ~0ul;
+    RecycleSolver solver;
+    int lastSweeps = 0;
+
+    void rebuildPlan() {
+        StreamTable& table = sheet.getTable();
+        const vector<Device*>& order = sheet.evaluationOrder();
+        steps.clear();
+        ports.clear();
+        fractions.clear();
+        for (Device* d : order) {
+            bool kernel = d->kind() != DeviceKind::Other && d->getTable() == &table && d->portsComplete();
+            Step step{static_cast<uint32_t>(ports.size()), static_cast<uint32_t>(d->getInputIds().size()),
+                      static_cast<uint32_t>(d->getOutputIds().size()), kernel ? nullptr : d};
+            ports.insert(ports.end(), d->getInputIds().begin(), d->getInputIds().end());
+            ports.insert(ports.end(), d->getOutputIds().begin(), d->getOutputIds().end());
+            fractions.resize(ports.size() - step.outCount, 0.0);
+            for (size_t j = 0; j < step.outCount; j++) fractions.push_back(kernel ? d->outputFraction(j) : 0.0);
+            steps.push_back(step);
+        }
+        growLanes();
+        planVersion = sheet.getWiringVersion();
+    }
+
+    /**
+     * @brief Give lanes to the streams created since the last call, filled with their current flow.
+     */
+    void growLanes() {
+        StreamTable& table = sheet.getTable();
+        for (size_t s = values.size() / lanes; s < table.size(); s++) {
+            values.insert(values.end(), lanes, table.flow(static_cast<uint32_t>(s)));
+        }
+    }
+
+    void run(const Step& step) {
+        const uint32_t* in = ports.data() + step.portBegin;
+        const uint32_t* out = in + step.inCount;
+        if (step.fallback) {
+            StreamTable& table = sheet.getTable();
+            for (size_t k = 0; k < lanes; k++) {
+                for (uint32_t i = 0; i < step.inCount; i++) table.setFlow(in[i], values[in[i] * lanes + k]);
+                step.fallback->update();
+                for (uint32_t j = 0; j < step.outCount; j++) values[out[j] * lanes + k] = table.flow(out[j]);
+            }
+            return;
+        }
+        double* acc = sum.data();
+        double* comp = compensation.data();
+        fill(acc, acc + lanes, 0.0);
+        fill(comp, comp + lanes, 0.0);
+        for (uint32_t i = 0; i < step.inCount; i++) {
+            const double* lane = values.data() + size_t(in[i]) * lanes;
+            for (size_t k = 0; k < lanes; k++) neumaierAdd(acc[k], comp[k], lane[k]);
+        }
+        for (size_t k = 0; k < lanes; k++) acc[k] += comp[k];
+        const double* frac = fractions.data() + step.portBegin + step.inCount;
+        for (uint32_t j = 0; j < step.outCount; j++) {
+            double* lane = values.data() + size_t(out[j]) * lanes;
+            double f = frac[j];
+            for (size_t k = 0; k < lanes; k++) lane[k] = acc[k] * f;
+        }
+    }
+
+public:
+    /**
+     * @brief Create a batch of scenarios over a flowsheet.
+     * @param fs The flowsheet; its wiring may change later, the batch follows it.
+     * @param laneCount Number of scenarios K.
+     */
+    ScenarioBatch(Flowsheet& fs, size_t laneCount): sheet(fs), lanes(max<size_t>(1, laneCount)), sum(lanes), compensation(lanes) {
+        growLanes();
+    }
+
+    size_t laneCount() const { return lanes; }
+
+    /**
+     * @brief The K scenario values of a stream of the flowsheet.
+     *
+     * The pointer is valid only until the next lane(), fillLane() or evaluate():
+     * those may reallocate the lanes when streams were added to the flowsheet.
+     *
+     * @throws DeviceException DifferentTables for a stream of another table.
+     */
+    double* lane(const Stream& s) {
+        if (&s.getTable() != &sheet.getTable()) throw DeviceException(DeviceError::DifferentTables);
+        growLanes();
+        return values.data() + size_t(s.getIndex()) * lanes;
+    }
+
+    /**
+     * @brief Set every scenario of a stream to the same value.
+     */
+    void fillLane(const Stream& s, double m) {
+        double* l = lane(s);
+        fill(l, l + lanes, m);
+    }
+
+    /**
+     * @brief Number of recycle sweeps done by the last evaluate().
+     */
+    int getLastRecycleSweeps() const { return lastSweeps; }
+
+    /**
+     * @brief Evaluate every scenario in one pass over the flowsheet.
+     *
+     * The flows of the flowsheet's own streams are left untouched, except the
+     * inputs and outputs of devices run lane by lane.
+     *
+     * @throws DeviceException UnsupportedComponents if the flowsheet has
+     * components, NotConverged if a recycle loop did not converge.
+     */
+    void evaluate() {
+        if (sheet.getTable().componentCount() != 0) throw DeviceException(DeviceError::UnsupportedComponents);
+        if (planVersion != sheet.getWiringVersion()) rebuildPlan();
+        growLanes();
+        ConvergenceOptions options = sheet.getConvergenceOptions();
+        if (options.method == ConvergenceOptions::Broyden) options.method = ConvergenceOptions::Wegstein;
+        solver.setOptions(options);
+        lastSweeps = 0;
+        const vector<TearStream>& tears = sheet.tearStreams();
+        for (const Flowsheet::Block& blk : sheet.evaluationBlocks()) {
+            if (blk.tearBegin == blk.tearEnd) {
+                for (uint32_t p = blk.begin; p < blk.end; p++) run(steps[p]);
+                continue;
+            }
+            const TearStream* t = tears.data() + blk.tearBegin;
+            size_t tearCount = blk.tearEnd - blk.tearBegin;
+            PROFILE_START(start);
+            int sweeps = solver.iterate(
+                tearCount * lanes, [&] { for (uint32_t p = blk.begin; p < blk.end; p++) run(steps[p]); },
+                [&](double* x) {
+                    for (size_t i = 0; i < tearCount; i++) copy_n(values.data() + size_t(t[i].index) * lanes, lanes, x + i * lanes);
+                },
+                [&](const double* x) {
+                    for (size_t i = 0; i < tearCount; i++) copy_n(x + i * lanes, lanes, values.data() + size_t(t[i].index) * lanes);
+                });
+            PROFILE_RECYCLE(sweeps, start);
+            if (sweeps < 0) throw DeviceException(DeviceError::NotConverged);
+            lastSweeps += sweeps;
+        }
+    }
+};
+#endif // SCENARIO_BATCH_CPP
@@ -0,0 +1,218 @@
+#ifndef SENSITIVITY_CPP
+#define SENSITIVITY_CPP
+
+/**
+ * @file Sensitivity.cpp
+ *
+ * @brief Exact derivatives of stream flows with respect to feeds and split weights, in one pass.
+ */
+
+#include "Dual.cpp"
+#include "Flowsheet.cpp"
+
+using namespace std;
+
+/**
+ * @class Sensitivity
+ * @brief Evaluates a flowsheet on dual numbers to get the derivatives of every flow with respect to N parameters.
+ *
+ * A parameter is the mass flow of a feed stream or the split weight of one
+ * output of a Separator. The weights of a separator are its current
+ * fractions, normalized again as in Separator::setSplit(), so raising one
+ * weight takes flow from the other outputs. Mixer, Reactor and Separator
+ * devices are evaluated from their kind and outputFraction(), as in
+ * ScenarioBatch, with the derivatives carried along; the values match
+ * evaluate() to rounding. One pass gives every derivative, instead of one
+ * perturbed evaluation per parameter with finite differences.
+ *
+ * Recycle loops converge values and derivatives together with the
+ * flowsheet's convergence options (Broyden is replaced by Wegstein). The
+ * flowsheet must not track components and every device must be of a known
+ * kind. The flows of the flowsheet's streams are left untouched.
+ */
+template <size_t N>
+class Sensitivity
+{
+private:
+    using Number = Dual<N>;
+
+    /**
+     * @brief One device of the evaluation order, compiled to port ranges.
+     */
+    struct Step {
+        uint32_t portBegin;  ///< First input in ports; outputs follow the inputs.
+        uint32_t inCount, outCount;
+    };
+
+    /**
+     * @brief A parameter: a feed stream, or output j of a separator.
+     */
+    struct Parameter {
+        uint32_t stream;         ///< Feed stream, unused for a split weight.
+        const Separator* split;  ///< Separator, or null for a feed.
+        size_t output;
+    };
+
+    Flowsheet& sheet;
+    vector<Parameter> parameters;
+    vector<Number> values;       ///< Value and derivatives of every stream.
+    vector<Step> steps;
+    vector<uint32_t> ports;
+    vector<Number> fractions;    ///< Output fraction of every output port, parallel to ports.
+    unsigned long planVersion = ~0ul;
+    RecycleSolver solver;
+    int lastSweeps = 0;
+
+    void rebuildPlan() {
+        StreamTable& table = sheet.getTable();
+        if (table.componentCount() != 0) throw DeviceException(DeviceError::UnsupportedComponents);
+        const vector<Device*>& order = sheet.evaluationOrder();
+        steps.clear();
+        ports.clear();
+        fractions.clear();
+        for (Device* d : order) {
+            if (d->kind() == DeviceKind::Other || d->getTable() != &table) throw DeviceException(DeviceError::UnsupportedDevice);
+            Step step{static_cast<uint32_t>(ports.size()), static_cast<uint32_t>(d->getInputIds().size()),
+                      static_cast<uint32_t>(d->getOutputIds().size())};
+            ports.insert(ports.end(), d->getInputIds().begin(), d->getInputIds().end());
+            ports.insert(ports.end(), d->getOutputIds().begin(), d->getOutputIds().end());
+            fractions.resize(ports.size() - step.outCount);
+
+            // Seeded weights of a separator, renormalized as dual numbers.
+            vector<Number> weights(step.outCount);
+            bool seeded = false;
+            for (uint32_t j = 0; j < step.outCount; j++) weights[j] = d->outputFraction(j);
+            for (size_t p = 0; p < parameters.size(); p++) {
+                if (parameters[p].split == d && parameters[p].output < step.outCount) {
+                    weights[parameters[p].output].d[p] = 1.0;
+                    seeded = true;
+                }
+            }
+            if (seeded) {
+                Number total = 0.0;
+                for (const Number& w : weights) total += w;
+                for (Number& w : weights) w /= total;
+            }
+            fractions.insert(fractions.end(), weights.begin(), weights.end());
+            steps.push_back(step);
+        }
+        planVersion = sheet.getWiringVersion();
+    }
+
+    void run(const Step& step) {
+        const uint32_t* in = ports.data() + step.portBegin;
+        const uint32_t* out = in + step.inCount;
+        Number sum = 0.0;
+        for (uint32_t i = 0; i < step.inCount; i++) sum += values[in[i]];
+        const Number* frac = fractions.data() + step.portBegin + step.inCount;
+        for (uint32_t j = 0; j < step.outCount; j++) values[out[j]] = sum * frac[j];
+    }
+
+    size_t add(const Parameter& p) {
+        if (parameters.size() == N) throw DeviceException(DeviceError::TooManyParameters);
+        parameters.push_back(p);
+        planVersion = ~0ul;
+        return parameters.size() - 1;
+    }
+
+    /**
+     * @throws DeviceException DifferentTables for a stream of another table or created after the last evaluate().
+     */
+    const Number& at(const Stream& s) const {
+        if (&s.getTable() != &sheet.getTable() || s.getIndex() >= values.size()) throw DeviceException(DeviceError::DifferentTables);
+        return values[s.getIndex()];
+    }
+
+public:
+    explicit Sensitivity(Flowsheet& fs): sheet(fs) {}
+
+    /**
+     * @brief Differentiate with respect to the mass flow of a feed stream.
+     * @return Index of the parameter.
+     * @throws DeviceException TooManyParameters past N parameters, DifferentTables for a stream of another table.
+     */
+    size_t addFeed(const Stream& feed) {
+        if (&feed.getTable() != &sheet.getTable()) throw DeviceException(DeviceError::DifferentTables);
+        return add(Parameter{feed.getIndex(), nullptr, 0});
+    }
+
+    /**
+     * @brief Differentiate with respect to the split weight of one output of a separator.
+     * @return Index of the parameter.
+     * @throws DeviceException TooManyParameters past N parameters.
+     */
+    size_t addSplitWeight(const Separator& separator, size_t output) {
+        return add(Parameter{0, &separator, output});
+    }
+
+    size_t parameterCount() const { return parameters.size(); }
+
+    /**
+     * @brief Number of recycle sweeps done by the last evaluate().
+     */
+    int getLastRecycleSweeps() const { return lastSweeps; }
+
+    /**
+     * @brief Evaluate the flows and their derivatives from the current feed flows.
+     * @throws DeviceException UnsupportedComponents if the flowsheet has components,
+     * UnsupportedDevice for a device of kind Other, NotConverged if a loop does not converge.
+     */
+    void evaluate() {
+        if (planVersion != sheet.getWiringVersion()) rebuildPlan();
+        StreamTable& table = sheet.getTable();
+        values.assign(table.size(), Number());
+        for (size_t s = 0; s < table.size(); s++) values[s].value = table.flow(static_cast<uint32_t>(s));
+        for (size_t p = 0; p < parameters.size(); p++) {
+            if (!parameters[p].split) values[parameters[p].stream].d[p] = 1.0;
+        }
+
+        ConvergenceOptions options = sheet.getConvergenceOptions();
+        if (options.method == ConvergenceOptions::Broyden) options.method = ConvergenceOptions::Wegstein;
+        solver.setOptions(options);
+        lastSweeps = 0;
+        const vector<TearStream>& tears = sheet.tearStreams();
+        for (const Flowsheet::Block& blk : sheet.evaluationBlocks()) {
+            if (blk.tearBegin == blk.tearEnd) {
+                for (uint32_t p = blk.begin; p < blk.end; p++) run(steps[p]);
+                continue;
+            }
+            const TearStream* t = tears.data() + blk.tearBegin;
+            size_t tearCount = blk.tearEnd - blk.tearBegin;
+            int sweeps = solver.iterate(
+                tearCount * (1 + N), [&] { for (uint32_t p = blk.begin; p < blk.end; p++) run(steps[p]); },
+                [&](double* x) {
+                    for (size_t i = 0; i < tearCount; i++) {
+                        const Number& v = values[t[i].index];
+                        *x++ = v.value;
+                        x = copy(v.d.begin(), v.d.end(), x);
+                    }
+                },
+                [&](const double* x) {
+                    for (size_t i = 0; i < tearCount; i++) {
+                        Number& v = values[t[i].index];
+                        v.value = *x++;
+                        copy_n(x, N, v.d.begin());
+                        x += N;
+                    }
+                });
+            if (sweeps < 0) throw DeviceException(DeviceError::NotConverged);
+            lastSweeps += sweeps;
+        }
+    }
+
+    /**
+     * @brief Mass flow of a stream found by the last evaluate().
+     */
+    double value(const Stream& s) const { return at(s).value; }
+
+    /**
+     * @brief Derivative of the mass flow of a stream with respect to a parameter.
+     */
+    double derivative(const Stream& s, size_t parameter) const { return at(s).d.at(parameter); }
+
+    /**
+     * @brief Derivatives of the mass flow of a stream with respect to every parameter.
+     */
+    const array<double, N>& gradient(const Stream& s) const { return at(s).d; }
+};
+#endif // SENSITIVITY_CPP
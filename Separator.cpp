@@ -1,25 +1,137 @@
+#ifndef SEPARATOR_CPP
+#define SEPARATOR_CPP
+
 #include "device.cpp"
 using namespace std;
 
+/**
+ * @brief Scale split weights to sum to one.
+ * @throws DeviceException SplitFractions if a weight is negative or not finite, or none is positive.
+ */
+inline vector<double> normalizeSplit(const vector<double>& weights) {
+      double total = 0.0;
+      for (double w : weights) {
+            if (!(w >= 0.0) || !isfinite(w)) throw DeviceException(DeviceError::SplitFractions);
+            total += w;
+      }
+      if (!(total > 0.0)) throw DeviceException(DeviceError::SplitFractions);
+      vector<double> normalized(weights.size());
+      for (size_t j = 0; j < weights.size(); j++) normalized[j] = weights[j] / total;
+      return normalized;
+}
+
+/**
+ * @class Separator
+ * @brief Splits one input into N outputs by fixed fractions.
+ *
+ * The fractions are normalized once, when set, and kept contiguous, so
+ * updateOutputs() is one multiply per output. The default separator has two
+ * outputs at 50/50. With components, a two-output separator may instead split
+ * every component by its own fraction (setComponentSplit()).
+ */
 class Separator : public Device {
       private:
-            int inputAmount = 1;
-            int outputAmount = 2;
-      
+            vector<double> fractions;   ///< Normalized fraction of the input sent to every output.
+            ComponentVector split; ///< Fraction of every component sent to the first output, empty to use fractions.
+
       public:
-            void updateOutputs() override {
-                  if (inputs.size() != inputAmount) {
-                        throw "INPUT STREAM LIMIT!";
-                  }
+            /**
+             * @brief Create a separator with equal outputs.
+             * @param outputs Number of outputs.
+             */
+            explicit Separator(size_t outputs = 2): Separator(vector<double>(outputs, 1.0)) {}
 
-                  if (outputs.size() != outputAmount) {
-                        throw "OUTPUT STREAM LIMIT!";
-                  }
+            /**
+             * @brief Create a separator with one output per weight.
+             * @param weights Relative share of every output, normalized to sum to one.
+             */
+            explicit Separator(const vector<double>& weights): fractions(normalizeSplit(weights)) {
+                  inputAmount = 1;
+                  outputAmount = static_cast<int>(fractions.size());
+            }
+
+            DeviceKind kind() const override { return DeviceKind::Separator; }
+            double outputFraction(size_t j) const override { return fractions[j]; }
+
+            /**
+             * @brief Change the output weights.
+             *
+             * The number of outputs may change, but not below the number of
+             * outputs already connected. Cached evaluation plans of the owning
+             * flowsheet are rebuilt.
+             *
+             * @param weights Relative share of every output, normalized to sum to one.
+             */
+            void setSplit(const vector<double>& weights) {
+                  vector<double> normalized = normalizeSplit(weights);
+                  if (normalized.size() < outputs.size()) throw DeviceException(DeviceError::SplitFractions);
+                  fractions.swap(normalized);
+                  outputAmount = static_cast<int>(fractions.size());
+                  clearMemo();
+                  wiringChanged();
+            }
+
+            /**
+             * @brief The normalized output fractions, one per output.
+             */
+            const vector<double>& getSplit() const { return fractions; }
 
-                  double inputMass = inputs.at(0)->getMassFlow();
-                  double halfMass = inputMass / 2.0;
+            /**
+             * @brief Set the per-component split.
+             *
+             * The owning flowsheet validates the new split before its next evaluation.
+             *
+             * @param componentFractions Fraction of every component sent to the first output,
+             * the rest goes to the second one.
+             */
+            void setComponentSplit(const ComponentVector& componentFractions) {
+                  split = componentFractions;
+                  clearMemo();
+                  wiringChanged();
+            }
+            const ComponentVector& getComponentSplit() const { return split; }
+
+            DeviceError validate() const override {
+                  if (DeviceError e = Device::validate(); e != DeviceError::None) return e;
+                  size_t nc = table->componentCount();
+                  if (nc && split.size() != 0 && (split.size() != nc || fractions.size() != 2)) return DeviceError::SplitSize;
+                  return DeviceError::None;
+            }
 
-                  outputs.at(0)->setMassFlow(halfMass);
-                  outputs.at(1)->setMassFlow(halfMass);
+            void updateOutputs() override {
+                  double* flow = table->data();
+                  double inputMass = flow[inputIds[0]];
+                  const double* f = fractions.data();
+                  size_t n = outputIds.size();
+
+                  for (size_t j = 0; j < n; j++) flow[outputIds[j]] = inputMass * f[j];
+
+                  if (size_t nc = table->componentCount()) {
+                        // Every output but the last takes its fraction, the last
+                        // takes the remainder so that each component closes exactly.
+                        // The mass flows follow the components (see componentOutputFlow()).
+                        const double* in = table->componentData(inputIds[0]);
+                        double inTotal = 0.0;
+                        for (size_t c = 0; c < nc; c++) inTotal += in[c];
+                        for (size_t j = 0; j + 1 < n; j++) {
+                              double* part = table->componentData(outputIds[j]);
+                              double total = 0.0;
+                              for (size_t c = 0; c < nc; c++) {
+                                    part[c] = in[c] * (split.size() ? split[c] : f[j]);
+                                    total += part[c];
+                              }
+                              flow[outputIds[j]] = componentOutputFlow(inputMass, total, inTotal, f[j]);
+                        }
+                        double* last = table->componentData(outputIds[n - 1]);
+                        double total = 0.0;
+                        for (size_t c = 0; c < nc; c++) {
+                              double rest = in[c];
+                              for (size_t j = 0; j + 1 < n; j++) rest -= table->componentData(outputIds[j])[c];
+                              last[c] = rest;
+                              total += rest;
+                        }
+                        flow[outputIds[n - 1]] = componentOutputFlow(inputMass, total, inTotal, f[n - 1]);
+                  }
             }
-};
\ No newline at end of file
+};
+#endif // SEPARATOR_CPP
@@ -0,0 +1,135 @@
+#ifndef SPARSE_LU_CPP
+#define SPARSE_LU_CPP
+
+/**
+ * @file SparseLU.cpp
+ *
+ * @brief Sparse LU factorization without pivoting, for diagonally dominant systems.
+ */
+
+#include "DeviceError.cpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class SparseLU
+ * @brief Row-by-row (up-looking) sparse LU of a square matrix, kept to solve many right-hand sides.
+ *
+ * The matrix is given in compressed rows. Rows are eliminated in their given
+ * order without pivoting, which is stable for the M-matrices met here (I - F
+ * of a mass balance, I - h J of an implicit step on a holdup network); order
+ * the unknowns so that the matrix is close to lower triangular to keep the
+ * fill low.
+ */
+class SparseLU
+{
+private:
+    /**
+     * @brief A sparse row: column indices and values, sorted by column.
+     */
+    struct Row {
+        vector<uint32_t> cols;
+        vector<double> vals;
+    };
+
+    vector<Row> lower, upper;  ///< Strict lower part of L (unit diagonal), U above the diagonal.
+    vector<double> diagonal;   ///< Diagonal of U.
+    vector<double> work;
+    vector<uint8_t> present;
+    vector<uint32_t> upperCols;
+
+public:
+    /**
+     * @brief Factor a matrix.
+     * @param n Number of rows and columns.
+     * @param rowStart Row r holds entries rowStart[r] to rowStart[r + 1] - 1 (n + 1 values).
+     * @param cols Column of every entry; repeated columns in a row are added.
+     * @param vals Value of every entry.
+     * @throws DeviceException SingularMatrix on a zero pivot.
+     */
+    void factor(size_t n, const uint32_t* rowStart, const uint32_t* cols, const double* vals) {
+        lower.assign(n, {});
+        upper.assign(n, {});
+        diagonal.assign(n, 0.0);
+        work.assign(n, 0.0);
+        present.assign(n, 0);
+        upperCols.clear();
+        priority_queue<uint32_t, vector<uint32_t>, greater<uint32_t>> pending; // lower columns still to eliminate
+
+        for (uint32_t i = 0; i < n; i++) {
+            auto touch = [&](uint32_t c, double v) {
+                if (!present[c]) {
+                    present[c] = 1;
+                    if (c < i) pending.push(c);
+                    else if (c > i) upperCols.push_back(c);
+                }
+                work[c] += v;
+            };
+            touch(i, 0.0);
+            for (uint32_t k = rowStart[i]; k < rowStart[i + 1]; k++) touch(cols[k], vals[k]);
+
+            while (!pending.empty()) {
+                uint32_t k = pending.top();
+                pending.pop();
+                double l = work[k] / diagonal[k];
+                work[k] = 0.0;
+                present[k] = 0;
+                if (l == 0.0) continue;
+                lower[i].cols.push_back(k);
+                lower[i].vals.push_back(l);
+                for (size_t m = 0; m < upper[k].cols.size(); m++) touch(upper[k].cols[m], -l * upper[k].vals[m]);
+            }
+
+            diagonal[i] = work[i];
+            work[i] = 0.0;
+            present[i] = 0;
+            if (abs(diagonal[i]) < 1e-12) throw DeviceException(DeviceError::SingularMatrix);
+            sort(upperCols.begin(), upperCols.end());
+            for (uint32_t c : upperCols) {
+                if (work[c] != 0.0) {
+                    upper[i].cols.push_back(c);
+                    upper[i].vals.push_back(work[c]);
+                }
+                work[c] = 0.0;
+                present[c] = 0;
+            }
+            upperCols.clear();
+        }
+    }
+
+    /**
+     * @brief Solve A x = b with the factors, in place.
+     * @param x On entry b, on exit x.
+     */
+    void solve(double* x) const {
+        size_t n = diagonal.size();
+        for (size_t i = 0; i < n; i++) {
+            double y = x[i];
+            for (size_t k = 0; k < lower[i].cols.size(); k++) y -= lower[i].vals[k] * x[lower[i].cols[k]];
+            x[i] = y;
+        }
+        for (size_t i = n; i-- > 0;) {
+            double v = x[i];
+            for (size_t k = 0; k < upper[i].cols.size(); k++) v -= upper[i].vals[k] * x[upper[i].cols[k]];
+            x[i] = v / diagonal[i];
+        }
+    }
+
+    size_t size() const { return diagonal.size(); }
+
+    /**
+     * @brief Number of off-diagonal nonzeros of the L and U factors.
+     */
+    size_t nonZeros() const {
+        size_t nnz = 0;
+        for (const Row& r : lower) nnz += r.cols.size();
+        for (const Row& r : upper) nnz += r.cols.size();
+        return nnz;
+    }
+};
+#endif // SPARSE_LU_CPP
@@ -0,0 +1,178 @@
+#ifndef STREAM_TABLE_CPP
+#define STREAM_TABLE_CPP
+
+/**
+ * @file StreamTable.cpp
+ *
+ * @brief Structure-of-arrays storage for stream state.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ComponentVector.cpp"
+
+using namespace std;
+
+/**
+ * @class StreamTable
+ * @brief Keeps the state of many streams in contiguous arrays.
+ *
+ * Mass flows live in one contiguous double array indexed by a 32-bit stream
+ * index, names are interned in a separate pool. Generated names ("s1", "s2", ...)
+ * are not materialized: only their number is kept until the name is asked for.
+ * Slots are never recycled, so a stream index stays valid for the lifetime of
+ * the table.
+ *
+ * Optionally every stream also carries a vector of component mass flows.
+ * The vectors of all streams share one contiguous arena, row by row, so a
+ * device reads and writes compositions without any allocation.
+ *
+ * The table also keeps a change log of streams edited from outside the
+ * devices (Stream::setMassFlow), used for incremental recomputation.
+ */
+class StreamTable
+{
+private:
+    vector<double> flows;                    ///< Mass flow of every stream, by stream index.
+    size_t components = 0;                   ///< Number of components tracked per stream.
+    vector<double> componentFlows;           ///< Component mass flows, components consecutive values per stream.
+    vector<uint32_t> nameIds;                ///< Index into namePool, or AutoName | n for the generated name "s<n>".
+    vector<string> namePool;                 ///< Interned stream names.
+    unordered_map<string, uint32_t> nameIndex; ///< Reverse lookup for interning.
+    vector<uint32_t> changed;                ///< Streams changed through markChanged() since the last takeChanged().
+    vector<uint8_t> changedFlag;             ///< Whether a stream is already in the changed list.
+
+public:
+    static constexpr uint32_t AutoName = 0x80000000u; ///< Flag of a generated name in nameIds.
+
+    /**
+     * @brief Intern a name in the name pool.
+     * @param name The name to intern.
+     * @return The pool index of the name.
+     */
+    uint32_t intern(const string& name) {
+        auto it = nameIndex.find(name);
+        if (it != nameIndex.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(namePool.size());
+        namePool.push_back(name);
+        nameIndex.emplace(name, id);
+        return id;
+    }
+
+    /**
+     * @brief Allocate a new stream slot.
+     * @param name The name of the new stream.
+     * @return The index of the new stream.
+     */
+    uint32_t add(const string& name) {
+        uint32_t id = addNumbered(0);
+        nameIds[id] = intern(name);
+        return id;
+    }
+
+    /**
+     * @brief Allocate a new stream slot named "s<n>", without building the name.
+     * @param n The number of the stream, below 2^31.
+     * @return The index of the new stream.
+     */
+    uint32_t addNumbered(uint32_t n) {
+        uint32_t id = static_cast<uint32_t>(flows.size());
+        flows.push_back(0.0);
+        componentFlows.resize(componentFlows.size() + components, 0.0);
+        nameIds.push_back(AutoName | n);
+        changedFlag.push_back(0);
+        return id;
+    }
+
+    /**
+     * @brief Reserve room for a number of streams.
+     */
+    void reserve(size_t n) {
+        flows.reserve(n);
+        componentFlows.reserve(n * components);
+        nameIds.reserve(n);
+        changedFlag.reserve(n);
+    }
+
+    /**
+     * @brief Set the number of components tracked per stream.
+     *
+     * Existing component flows are reset to zero.
+     */
+    void setComponentCount(size_t n) {
+        components = n;
+        componentFlows.assign(flows.size() * n, 0.0);
+    }
+
+    size_t componentCount() const { return components; }
+
+    /**
+     * @brief Component mass flows of a stream, componentCount() consecutive values.
+     */
+    double* componentData(uint32_t i) { return componentFlows.data() + size_t(i) * components; }
+    const double* componentData(uint32_t i) const { return componentFlows.data() + size_t(i) * components; }
+
+    size_t size() const { return flows.size(); }
+
+    double flow(uint32_t i) const { return flows[i]; }
+    void setFlow(uint32_t i, double m) { flows[i] = m; }
+
+    /**
+     * @brief Record that a stream was changed from outside the devices.
+     * @param i The index of the changed stream.
+     */
+    void markChanged(uint32_t i) {
+        if (changedFlag[i]) return;
+        changedFlag[i] = 1;
+        changed.push_back(i);
+    }
+
+    /**
+     * @brief Move the changed stream list out and reset the change log.
+     * @param out Receives the indices of the changed streams, in change order.
+     */
+    void takeChanged(vector<uint32_t>& out) {
+        out.swap(changed);
+        changed.clear();
+        for (uint32_t i : out) changedFlag[i] = 0;
+    }
+
+    /**
+     * @brief Forget every recorded change.
+     */
+    void clearChanged() {
+        for (uint32_t i : changed) changedFlag[i] = 0;
+        changed.clear();
+    }
+
+    /**
+     * @brief Direct access to the contiguous mass flow array.
+     */
+    double* data() { return flows.data(); }
+    const double* data() const { return flows.data(); }
+
+    string name(uint32_t i) const {
+        if (nameIds[i] & AutoName) return "s" + to_string(nameIds[i] & ~AutoName);
+        return namePool[nameIds[i]];
+    }
+    void setName(uint32_t i, const string& name) { nameIds[i] = intern(name); }
+
+    /**
+     * @brief Raw name of a stream: an index into getNamePool(), or AutoName | n for "s<n>".
+     */
+    uint32_t nameId(uint32_t i) const { return nameIds[i]; }
+    const vector<string>& getNamePool() const { return namePool; }
+
+    /**
+     * @brief The table used by streams created without an explicit table.
+     *
+     * Intentionally never destroyed, so streams in static storage stay valid.
+     */
+    static StreamTable& global() {
+        static StreamTable* table = new StreamTable();
+        return *table;
+    }
+};
+#endif // STREAM_TABLE_CPP
@@ -0,0 +1,377 @@
+#ifndef STREAMING_DRIVER_CPP
+#define STREAMING_DRIVER_CPP
+
+/**
+ * @file StreamingDriver.cpp
+ *
+ * @brief Time-series simulation: feed profiles in, output flows out, with pipelined I/O.
+ */
+
+#include "Flowsheet.cpp"
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+/**
+ * @class BoundedQueue
+ * @brief Blocking FIFO with a fixed capacity, used to hand chunks between pipeline stages.
+ */
+template <class T>
+class BoundedQueue
+{
+private:
+    deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    mutex lock;
+    condition_variable notEmpty, notFull;
+
+public:
+    explicit BoundedQueue(size_t capacity): capacity(capacity) {}
+
+    /**
+     * @brief Append an item, waiting while the queue is full.
+     * @return false if the queue was closed.
+     */
+    bool push(T item) {
+        unique_lock<mutex> guard(lock);
+        notFull.wait(guard, [this] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest item, waiting while the queue is empty.
+     * @return false once the queue is closed and drained.
+     */
+    bool pop(T& item) {
+        unique_lock<mutex> guard(lock);
+        notEmpty.wait(guard, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Wake every waiter; pop() still returns the remaining items.
+     */
+    void close() {
+        lock_guard<mutex> guard(lock);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+};
+
+/**
+ * @class FeedReader
+ * @brief Source of feed values: one row of values per time step.
+ */
+class FeedReader
+{
+public:
+    virtual ~FeedReader() = default;
+
+    /**
+     * @brief Read up to maxSteps rows.
+     * @param values Receives the rows, columns values each.
+     * @param columns Number of values per row.
+     * @return Number of rows read, 0 at the end of the input.
+     */
+    virtual size_t read(double* values, size_t columns, size_t maxSteps) = 0;
+};
+
+/**
+ * @class CsvFeedReader
+ * @brief Comma-separated text, one line per time step, one column per feed.
+ *
+ * A first line that does not start with a number is a header and is skipped.
+ * Empty lines are ignored. A line with another number of values than columns
+ * throws DeviceException(FileFormat).
+ */
+class CsvFeedReader : public FeedReader
+{
+private:
+    ifstream file;
+    string line;
+    bool firstLine = true;
+
+public:
+    explicit CsvFeedReader(const string& path): file(path) {
+        if (!file) throw DeviceException(DeviceError::FileAccess);
+    }
+
+    size_t read(double* values, size_t columns, size_t maxSteps) override {
+        size_t steps = 0;
+        while (steps < maxSteps && getline(file, line)) {
+            if (line.empty() || line == "\r") continue;
+            const char* p = line.c_str();
+            char* end;
+            double first = strtod(p, &end);
+            if (firstLine) {
+                firstLine = false;
+                if (end == p) continue; // header
+            }
+            double* row = values + steps * columns;
+            for (size_t c = 0; c < columns; c++) {
+                if (c > 0) {
+                    if (*end != ',') throw DeviceException(DeviceError::FileFormat);
+                    p = end + 1;
+                    first = strtod(p, &end);
+                }
+                if (end == p) throw DeviceException(DeviceError::FileFormat);
+                row[c] = first;
+            }
+            while (*end == ' ' || *end == '\r') end++;
+            if (*end != '\0') throw DeviceException(DeviceError::FileFormat);
+            steps++;
+        }
+        return steps;
+    }
+};
+
+/**
+ * @class BinaryFeedReader
+ * @brief Raw native-endian doubles, row after row, with no header.
+ *
+ * A file ending in a partial row throws DeviceException(FileFormat).
+ */
+class BinaryFeedReader : public FeedReader
+{
+private:
+    ifstream file;
+
+public:
+    explicit BinaryFeedReader(const string& path): file(path, ios::binary) {
+        if (!file) throw DeviceException(DeviceError::FileAccess);
+    }
+
+    size_t read(double* values, size_t columns, size_t maxSteps) override {
+        if (columns == 0) return 0;
+        size_t rowBytes = columns * sizeof(double);
+        file.read(reinterpret_cast<char*>(values), rowBytes * maxSteps);
+        size_t bytes = file.gcount();
+        if (bytes % rowBytes != 0) throw DeviceException(DeviceError::FileFormat);
+        return bytes / rowBytes;
+    }
+};
+
+/**
+ * @class OutputSink
+ * @brief Destination of the output flows: one row of columns values per time step.
+ */
+class OutputSink
+{
+public:
+    virtual ~OutputSink() = default;
+    virtual void write(const double* values, size_t columns, size_t steps) = 0;
+};
+
+/**
+ * @class CsvOutputSink
+ * @brief Comma-separated text with a header line of stream names, values printed round-trip exact.
+ */
+class CsvOutputSink : public OutputSink
+{
+private:
+    ofstream file;
+    string text;
+
+public:
+    CsvOutputSink(const string& path, const vector<string>& header): file(path, ios::trunc) {
+        if (!file) throw DeviceException(DeviceError::FileAccess);
+        for (size_t c = 0; c < header.size(); c++) file << (c ? "," : "") << header[c];
+        file << '\n';
+    }
+
+    void write(const double* values, size_t columns, size_t steps) override {
+        char number[32];
+        text.clear();
+        for (size_t s = 0; s < steps; s++) {
+            for (size_t c = 0; c < columns; c++) {
+                if (c) text += ',';
+                text.append(number, snprintf(number, sizeof(number), "%.17g", values[s * columns + c]));
+            }
+            text += '\n';
+        }
+        file.write(text.data(), text.size());
+        if (!file) throw DeviceException(DeviceError::FileAccess);
+    }
+};
+
+/**
+ * @class BinaryOutputSink
+ * @brief Raw native-endian doubles, row after row, with no header.
+ */
+class BinaryOutputSink : public OutputSink
+{
+private:
+    ofstream file;
+
+public:
+    explicit BinaryOutputSink(const string& path): file(path, ios::binary | ios::trunc) {
+        if (!file) throw DeviceException(DeviceError::FileAccess);
+    }
+
+    void write(const double* values, size_t columns, size_t steps) override {
+        file.write(reinterpret_cast<const char*>(values), columns * steps * sizeof(double));
+        if (!file) throw DeviceException(DeviceError::FileAccess);
+    }
+};
+
+/**
+ * @class StreamingDriver
+ * @brief Pushes feed time series through a flowsheet and records selected output streams.
+ *
+ * Three stages run concurrently: a reader thread fills chunks of feed rows,
+ * the calling thread sets the feeds of every step and re-runs the flowsheet
+ * (Flowsheet::recomputeDirty(), so only the devices downstream of a feed
+ * that moved are evaluated) and a writer thread drains chunks of output rows
+ * to the sink. The stages exchange a fixed set of chunk buffers through
+ * bounded queues, so memory use does not depend on the number of steps and
+ * a slow stage throttles the others.
+ */
+class StreamingDriver
+{
+private:
+    /**
+     * @brief A block of consecutive time steps.
+     */
+    struct Chunk {
+        vector<double> values;
+        size_t steps = 0;
+    };
+
+    Flowsheet& sheet;
+    vector<shared_ptr<Stream>> feeds;
+    vector<shared_ptr<Stream>> outputs;
+    size_t chunkSteps;
+    size_t depth;
+
+public:
+    /**
+     * @brief Create a driver.
+     * @param fs The flowsheet to drive.
+     * @param feedStreams Streams set from the feed columns, in column order.
+     * @param outputStreams Streams recorded after every step, in column order.
+     * @param chunkSteps Number of time steps per chunk.
+     * @param depth Number of chunks in flight between two stages.
+     * @throws DeviceException DifferentTables for a stream of another table than the flowsheet's.
+     */
+    StreamingDriver(Flowsheet& fs, vector<shared_ptr<Stream>> feedStreams, vector<shared_ptr<Stream>> outputStreams,
+                    size_t chunkSteps = 1024, size_t depth = 4)
+        : sheet(fs), feeds(std::move(feedStreams)), outputs(std::move(outputStreams)),
+          chunkSteps(max<size_t>(1, chunkSteps)), depth(max<size_t>(1, depth)) {
+        for (const auto* streams : {&feeds, &outputs}) {
+            for (const auto& s : *streams) {
+                if (&s->getTable() != &sheet.getTable()) throw DeviceException(DeviceError::DifferentTables);
+            }
+        }
+    }
+
+    /**
+     * @brief Names of the output streams, e.g. for the header of a CsvOutputSink.
+     */
+    vector<string> outputNames() const {
+        vector<string> names;
+        for (const auto& s : outputs) names.push_back(s->getName());
+        return names;
+    }
+
+    /**
+     * @brief Run every time step of a feed source.
+     *
+     * An exception thrown by any stage stops the pipeline and is rethrown here.
+     *
+     * @return Number of time steps simulated.
+     */
+    size_t run(FeedReader& reader, OutputSink& sink) {
+        size_t nFeeds = feeds.size(), nOut = outputs.size();
+        vector<Chunk> inChunks(depth), outChunks(depth);
+        BoundedQueue<Chunk*> freeIn(depth), filledIn(depth), freeOut(depth), filledOut(depth);
+        for (Chunk& c : inChunks) {
+            c.values.resize(chunkSteps * nFeeds);
+            freeIn.push(&c);
+        }
+        for (Chunk& c : outChunks) {
+            c.values.resize(chunkSteps * nOut);
+            freeOut.push(&c);
+        }
+
+        exception_ptr failure;
+        mutex failureLock;
+        auto fail = [&] {
+            lock_guard<mutex> guard(failureLock);
+            if (!failure) failure = current_exception();
+            for (auto* q : {&freeIn, &filledIn, &freeOut, &filledOut}) q->close();
+        };
+
+        thread readerThread([&] {
+            try {
+                Chunk* c;
+                while (freeIn.pop(c)) {
+                    c->steps = reader.read(c->values.data(), nFeeds, chunkSteps);
+                    if (c->steps == 0) break;
+                    if (!filledIn.push(c)) break;
+                }
+            } catch (...) {
+                fail();
+            }
+            filledIn.close();
+        });
+
+        thread writerThread([&] {
+            try {
+                Chunk* c;
+                while (filledOut.pop(c)) {
+                    sink.write(c->values.data(), nOut, c->steps);
+                    if (!freeOut.push(c)) break;
+                }
+            } catch (...) {
+                fail();
+            }
+        });
+
+        size_t total = 0;
+        try {
+            Chunk* in;
+            Chunk* out;
+            sheet.evaluate();
+            while (filledIn.pop(in)) {
+                if (!freeOut.pop(out)) break;
+                for (size_t s = 0; s < in->steps; s++) {
+                    const double* row = in->values.data() + s * nFeeds;
+                    for (size_t f = 0; f < nFeeds; f++) {
+                        if (feeds[f]->getMassFlow() != row[f]) feeds[f]->setMassFlow(row[f]);
+                    }
+                    sheet.recomputeDirty();
+                    double* result = out->values.data() + s * nOut;
+                    for (size_t o = 0; o < nOut; o++) result[o] = outputs[o]->getMassFlow();
+                }
+                out->steps = in->steps;
+                total += in->steps;
+                if (!filledOut.push(out) || !freeIn.push(in)) break;
+            }
+        } catch (...) {
+            fail();
+        }
+        filledOut.close();
+        freeIn.close();
+        readerThread.join();
+        writerThread.join();
+        if (failure) rethrow_exception(failure);
+        return total;
+    }
+};
+#endif // STREAMING_DRIVER_CPP
@@ -0,0 +1,93 @@
+#ifndef TANK_CPP
+#define TANK_CPP
+
+/**
+ * @file Tank.cpp
+ *
+ * @brief Well-mixed holdup: the dynamic counterpart of a Mixer or Separator.
+ */
+
+#include "Separator.cpp"
+using namespace std;
+
+/**
+ * @class Tank
+ * @brief Mixes its inputs into a holdup that drains with a fixed residence time.
+ *
+ * With holdup M and residence time tau, the tank sends M / tau out, split
+ * between the outputs by fixed fractions (as a Separator), and
+ * dM/dt = sum of the inputs - M / tau: a first-order lag of time constant
+ * tau on the outlet flow. Component holdups follow the same law, so the
+ * state is the total holdup followed by one holdup per component.
+ */
+class Tank : public Device {
+      private:
+            double residenceTime;
+            vector<double> fractions;   ///< Normalized fraction of the outflow sent to every output.
+            vector<double> holdup;      ///< Total holdup, then component holdups.
+
+      public:
+            /**
+             * @brief Create a tank.
+             * @param inputs Number of inputs.
+             * @param tau Residence time, positive.
+             * @param weights Relative share of every output, one output by default.
+             * @throws DeviceException ResidenceTime, or SplitFractions as normalizeSplit().
+             */
+            Tank(size_t inputs, double tau, const vector<double>& weights = {1.0})
+                  : residenceTime(tau), fractions(normalizeSplit(weights)), holdup(1, 0.0) {
+                  if (!(tau > 0.0)) throw DeviceException(DeviceError::ResidenceTime);
+                  inputAmount = static_cast<int>(inputs);
+                  outputAmount = static_cast<int>(fractions.size());
+            }
+
+            double getResidenceTime() const { return residenceTime; }
+
+            /**
+             * @brief Set the holdup, e.g. the steady state tau * inflow.
+             * @param total Total holdup.
+             * @param components Component holdups, empty for none.
+             */
+            void setHoldup(double total, const vector<double>& components = {}) {
+                  holdup.assign(1, total);
+                  holdup.insert(holdup.end(), components.begin(), components.end());
+                  clearMemo();
+            }
+            double getHoldup() const { return holdup[0]; }
+
+            size_t stateCount() const override { return 1 + (table ? table->componentCount() : 0); }
+
+            void readState(double* x) const override {
+                  size_t n = stateCount();
+                  for (size_t i = 0; i < n; i++) x[i] = i < holdup.size() ? holdup[i] : 0.0;
+            }
+
+            void writeState(const double* x) override {
+                  holdup.assign(x, x + stateCount());
+                  clearMemo(); // outputs follow the holdup, not the inputs
+            }
+
+            void updateOutputs() override {
+                  double* flow = table->data();
+                  size_t nc = table->componentCount();
+                  if (holdup.size() < 1 + nc) holdup.resize(1 + nc, 0.0);
+                  double outflow = holdup[0] / residenceTime;
+                  for (size_t j = 0; j < outputIds.size(); j++) {
+                        flow[outputIds[j]] = outflow * fractions[j];
+                        double* c = table->componentData(outputIds[j]);
+                        for (size_t k = 0; k < nc; k++) c[k] = holdup[1 + k] / residenceTime * fractions[j];
+                  }
+            }
+
+            void stateDerivatives(double* dxdt) const override {
+                  size_t n = stateCount();
+                  for (size_t i = 0; i < n; i++) dxdt[i] = -(i < holdup.size() ? holdup[i] : 0.0) / residenceTime;
+                  const double* flow = table->data();
+                  for (uint32_t id : inputIds) {
+                        dxdt[0] += flow[id];
+                        const double* c = table->componentData(id);
+                        for (size_t k = 1; k < n; k++) dxdt[k] += c[k - 1];
+                  }
+            }
+};
+#endif // TANK_CPP
@@ -0,0 +1,189 @@
+#ifndef THREAD_POOL_CPP
+#define THREAD_POOL_CPP
+
+/**
+ * @file ThreadPool.cpp
+ *
+ * @brief A small work-stealing thread pool for data-parallel loops.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @class ThreadPool
+ * @brief Fixed-size pool where every worker owns a task deque and steals from the others when idle.
+ *
+ * Workers pop their own deque from the back and steal from the front of the
+ * other deques. The thread calling parallelFor() takes part in the work, so a
+ * pool of N threads runs N + 1 workers for the duration of a loop.
+ */
+class ThreadPool
+{
+private:
+    /**
+     * @brief State of one parallelFor() call, shared by its chunks.
+     */
+    struct Loop {
+        const function<void(size_t, size_t)>* body;
+        atomic<size_t> remaining;
+        atomic<bool> failed{false};  ///< Set by the first throwing chunk; later chunks are skipped.
+        mutex errorLock;
+        exception_ptr error;
+    };
+
+    /**
+     * @brief A contiguous chunk of a parallelFor() range.
+     */
+    struct Task {
+        Loop* loop;
+        size_t begin;
+        size_t end;
+    };
+
+    struct Queue {
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    vector<unique_ptr<Queue>> queues;   ///< One deque per worker, the last one belongs to callers.
+    vector<thread> threads;
+    atomic<size_t> queued{0};           ///< Tasks enqueued but not yet taken.
+    atomic<bool> stopping{false};
+    mutex sleepLock;
+    condition_variable wake;
+
+    bool popOwn(size_t q, Task& t) {
+        lock_guard<mutex> guard(queues[q]->lock);
+        if (queues[q]->tasks.empty()) return false;
+        t = queues[q]->tasks.back();
+        queues[q]->tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t self, Task& t) {
+        for (size_t i = 1; i < queues.size(); i++) {
+            size_t victim = (self + i) % queues.size();
+            lock_guard<mutex> guard(queues[victim]->lock);
+            if (queues[victim]->tasks.empty()) continue;
+            t = queues[victim]->tasks.front();
+            queues[victim]->tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    bool take(size_t self, Task& t) {
+        if (popOwn(self, t) || steal(self, t)) {
+            queued.fetch_sub(1, memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    static void run(const Task& t) {
+        Loop& loop = *t.loop;
+        if (!loop.failed.load(memory_order_acquire)) {
+            try {
+                (*loop.body)(t.begin, t.end);
+            } catch (...) {
+                lock_guard<mutex> guard(loop.errorLock);
+                if (!loop.error) loop.error = current_exception();
+                loop.failed.store(true, memory_order_release);
+            }
+        }
+        loop.remaining.fetch_sub(1, memory_order_acq_rel);
+    }
+
+    void workerLoop(size_t self) {
+        Task t;
+        while (true) {
+            if (take(self, t)) {
+                run(t);
+                continue;
+            }
+            unique_lock<mutex> guard(sleepLock);
+            wake.wait(guard, [this] { return stopping.load() || queued.load() > 0; });
+            if (stopping.load() && queued.load() == 0) return;
+        }
+    }
+
+public:
+    /**
+     * @brief Create a pool with a given number of worker threads.
+     * @param threadCount Number of background threads, 0 runs everything on the caller.
+     */
+    explicit ThreadPool(size_t threadCount = thread::hardware_concurrency()) {
+        for (size_t i = 0; i <= threadCount; i++) queues.push_back(make_unique<Queue>());
+        for (size_t i = 0; i < threadCount; i++) threads.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> guard(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    /**
+     * @brief Number of threads taking part in a parallelFor(), including the caller.
+     */
+    size_t concurrency() const { return threads.size() + 1; }
+
+    /**
+     * @brief Run body over [0, n) split into chunks of at most grain items, and wait for completion.
+     * @param n Number of items.
+     * @param grain Maximum number of items per task.
+     * @param body Called with a half-open [begin, end) range.
+     *
+     * If a chunk throws, the chunks not started yet are skipped, every chunk
+     * is waited for, and the first exception is rethrown on the caller.
+     */
+    void parallelFor(size_t n, size_t grain, const function<void(size_t, size_t)>& body) {
+        if (n == 0) return;
+        if (grain == 0) grain = 1;
+        if (threads.empty() || n <= grain) {
+            body(0, n);
+            return;
+        }
+
+        size_t chunks = (n + grain - 1) / grain;
+        Loop loop;
+        loop.body = &body;
+        loop.remaining.store(chunks);
+        size_t self = queues.size() - 1;
+        // Count the tasks before publishing them, so a take() cannot drive queued below zero.
+        {
+            lock_guard<mutex> guard(sleepLock);
+            queued.fetch_add(chunks);
+        }
+        for (size_t c = 0; c < chunks; c++) {
+            size_t q = c % queues.size();
+            lock_guard<mutex> guard(queues[q]->lock);
+            queues[q]->tasks.push_back(Task{&loop, c * grain, min(n, (c + 1) * grain)});
+        }
+        wake.notify_all();
+
+        Task t;
+        while (loop.remaining.load(memory_order_acquire) > 0) {
+            if (take(self, t)) run(t);
+            else this_thread::yield();
+        }
+        if (loop.error) rethrow_exception(loop.error);
+    }
+};
+#endif // THREAD_POOL_CPP
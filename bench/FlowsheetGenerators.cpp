@@ -0,0 +1,153 @@
+#ifndef FLOWSHEET_GENERATORS_CPP
+#define FLOWSHEET_GENERATORS_CPP
+
+/**
+ * @file FlowsheetGenerators.cpp
+ *
+ * @brief Synthetic flowsheets of a given size, used by the benchmarks.
+ */
+
+#include "../Flowsheet.cpp"
+#include <random>
+
+using namespace std;
+
+/**
+ * @brief Shape of a generated flowsheet.
+ */
+enum class SheetShape { Chain, Tree, RandomDag, Recycle };
+
+/**
+ * @brief Chain of single-output reactors: feed -> r -> r -> ... (one device per stream).
+ */
+inline void buildChain(Flowsheet& fs, size_t streams) {
+    fs.reserveStreams(streams);
+    fs.reserveDevices(streams);
+    auto prev = fs.addStream();
+    prev->setMassFlow(1.0);
+    for (size_t i = 1; i < streams; i++) {
+        auto next = fs.addStream();
+        auto r = fs.addDevice<Reactor>(false);
+        r->addInput(prev);
+        r->addOutput(next);
+        prev = next;
+    }
+}
+
+/**
+ * @brief Binary tree of two-input mixers reducing streams/2 feeds to one product.
+ */
+inline void buildTree(Flowsheet& fs, size_t streams) {
+    size_t feeds = max<size_t>(2, streams / 2);
+    fs.reserveStreams(2 * feeds);
+    fs.reserveDevices(feeds);
+    vector<shared_ptr<Stream>> layer;
+    for (size_t i = 0; i < feeds; i++) {
+        layer.push_back(fs.addStream());
+        layer.back()->setMassFlow(1.0);
+    }
+    while (layer.size() > 1) {
+        vector<shared_ptr<Stream>> next;
+        for (size_t i = 0; i + 1 < layer.size(); i += 2) {
+            auto out = fs.addStream();
+            auto mix = fs.addDevice<Mixer>(2);
+            mix->addInput(layer[i]);
+            mix->addInput(layer[i + 1]);
+            mix->addOutput(out);
+            next.push_back(out);
+        }
+        if (layer.size() % 2) next.push_back(layer.back());
+        layer.swap(next);
+    }
+}
+
+/**
+ * @brief Random DAG of two-input mixers, separators and reactors fed by earlier streams.
+ */
+inline void buildRandomDag(Flowsheet& fs, size_t streams, unsigned seed = 42) {
+    mt19937 rng(seed);
+    fs.reserveStreams(streams + 2);
+    fs.reserveDevices(streams);
+    vector<shared_ptr<Stream>> pool;
+    size_t feeds = max<size_t>(4, streams / 16);
+    for (size_t i = 0; i < feeds; i++) {
+        pool.push_back(fs.addStream());
+        pool.back()->setMassFlow(1.0 + i % 7);
+    }
+    // Every stream is consumed at most once, so each device picks unused ones.
+    vector<size_t> unused;
+    for (size_t i = 0; i < pool.size(); i++) unused.push_back(i);
+    auto take = [&]() {
+        size_t k = uniform_int_distribution<size_t>(0, unused.size() - 1)(rng);
+        swap(unused[k], unused.back());
+        size_t s = unused.back();
+        unused.pop_back();
+        return pool[s];
+    };
+    auto produce = [&]() {
+        pool.push_back(fs.addStream());
+        unused.push_back(pool.size() - 1);
+        return pool.back();
+    };
+    while (pool.size() < streams && unused.size() >= 2) {
+        switch (rng() % 3) {
+        case 0: {
+            auto mix = fs.addDevice<Mixer>(2);
+            mix->addInput(take());
+            mix->addInput(take());
+            mix->addOutput(produce());
+            break;
+        }
+        case 1: {
+            auto sep = fs.addDevice<Separator>();
+            sep->addInput(take());
+            sep->addOutput(produce());
+            sep->addOutput(produce());
+            break;
+        }
+        default: {
+            auto r = fs.addDevice<Reactor>(false);
+            r->addInput(take());
+            r->addOutput(produce());
+            break;
+        }
+        }
+    }
+}
+
+/**
+ * @brief Independent recycle loops: a mixer fed by a feed and half of a separator's output.
+ */
+inline void buildRecycle(Flowsheet& fs, size_t streams) {
+    size_t loops = max<size_t>(1, streams / 4);
+    fs.reserveStreams(4 * loops);
+    fs.reserveDevices(2 * loops);
+    for (size_t i = 0; i < loops; i++) {
+        auto feed = fs.addStream();
+        auto loop = fs.addStream();
+        auto mixed = fs.addStream();
+        auto product = fs.addStream();
+        auto mix = fs.addDevice<Mixer>(2);
+        auto sep = fs.addDevice<Separator>();
+        mix->addInput(feed);
+        mix->addInput(loop);
+        mix->addOutput(mixed);
+        sep->addInput(mixed);
+        sep->addOutput(product);
+        sep->addOutput(loop);
+        feed->setMassFlow(1.0 + i % 5);
+    }
+}
+
+/**
+ * @brief Build a flowsheet of a given shape with about the given number of streams.
+ */
+inline void buildSheet(Flowsheet& fs, SheetShape shape, size_t streams) {
+    switch (shape) {
+    case SheetShape::Chain: buildChain(fs, streams); break;
+    case SheetShape::Tree: buildTree(fs, streams); break;
+    case SheetShape::RandomDag: buildRandomDag(fs, streams); break;
+    case SheetShape::Recycle: buildRecycle(fs, streams); break;
+    }
+}
+#endif // FLOWSHEET_GENERATORS_CPP
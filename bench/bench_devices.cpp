@@ -0,0 +1,314 @@
+/**
+ * @file bench_devices.cpp
+ *
+ * @brief Throughput benchmarks of the devices and of whole flowsheets.
+ *
+ * Run with --benchmark_out=<file> --benchmark_out_format=json to keep the
+ * results for regression tracking (make bench does it).
+ */
+
+#define DEVICE_NO_MAIN
+#include "FlowsheetGenerators.cpp"
+#include "../FlowsheetTape.cpp"
+#include "../LinearMassBalance.cpp"
+#include "../MassClosure.cpp"
+#include "../MappedFlowsheet.cpp"
+#include "../PartitionedFlowsheet.cpp"
+#include "../ScenarioBatch.cpp"
+#include "../Sensitivity.cpp"
+#include <benchmark/benchmark.h>
+
+using namespace std;
+
+// ---------------------------------------------------------------------------
+// Microbenchmarks: one updateOutputs() call.
+// ---------------------------------------------------------------------------
+
+static void BM_MixerUpdate(benchmark::State& state) {
+    size_t ports = state.range(0);
+    StreamTable table;
+    Mixer mix(ports);
+    for (size_t i = 0; i < ports; i++) {
+        auto s = make_shared<Stream>(table, i);
+        s->setMassFlow(i);
+        mix.addInput(s);
+    }
+    mix.addOutput(make_shared<Stream>(table, ports));
+    for (auto _ : state) {
+        mix.updateOutputs();
+        benchmark::DoNotOptimize(table.data());
+    }
+    state.SetItemsProcessed(state.iterations() * ports);
+}
+BENCHMARK(BM_MixerUpdate)->ArgName("ports")->RangeMultiplier(4)->Range(1, 1024);
+
+static void BM_ReactorUpdate(benchmark::State& state) {
+    bool isDouble = state.range(0) == 2;
+    StreamTable table;
+    Reactor r(isDouble);
+    auto in = make_shared<Stream>(table, 0);
+    in->setMassFlow(3.0);
+    r.addInput(in);
+    for (int j = 0; j < state.range(0); j++) r.addOutput(make_shared<Stream>(table, j + 1));
+    for (auto _ : state) {
+        r.updateOutputs();
+        benchmark::DoNotOptimize(table.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ReactorUpdate)->ArgName("outputs")->DenseRange(1, 2);
+
+static void BM_SeparatorUpdate(benchmark::State& state) {
+    StreamTable table;
+    vector<double> weights(state.range(0));
+    for (size_t j = 0; j < weights.size(); j++) weights[j] = 1.0 + j;
+    Separator sep(weights);
+    auto in = make_shared<Stream>(table, 0);
+    in->setMassFlow(3.0);
+    sep.addInput(in);
+    for (int64_t j = 0; j < state.range(0); j++) sep.addOutput(make_shared<Stream>(table, j + 1));
+    for (auto _ : state) {
+        sep.updateOutputs();
+        benchmark::DoNotOptimize(table.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SeparatorUpdate)->ArgName("outputs")->Arg(2)->Arg(3)->Arg(8)->Arg(20);
+
+// ---------------------------------------------------------------------------
+// Macrobenchmarks: one sweep over a generated flowsheet.
+// ---------------------------------------------------------------------------
+
+enum class SweepMode { Serial, Batched, Parallel, Dirty, Tape };
+
+template <SheetShape Shape, SweepMode Mode>
+static void BM_Sweep(benchmark::State& state) {
+    Flowsheet fs;
+    buildSheet(fs, Shape, state.range(0));
+    ThreadPool pool(Mode == SweepMode::Parallel ? thread::hardware_concurrency() : 0);
+    fs.evaluate(); // builds the order and converges recycles once
+    FlowsheetTape tape(fs);
+    if (Mode == SweepMode::Tape) tape.evaluate(); // compiles the tape
+    auto feed = fs.getStreams().front();
+
+    for (auto _ : state) {
+        switch (Mode) {
+        case SweepMode::Serial: fs.evaluate(); break;
+        case SweepMode::Batched: fs.evaluateBatched(); break;
+        case SweepMode::Parallel: fs.evaluateParallel(pool); break;
+        case SweepMode::Dirty:
+            feed->setMassFlow(feed->getMassFlow() + 1.0);
+            fs.recomputeDirty();
+            break;
+        case SweepMode::Tape: tape.evaluate(); break;
+        }
+        benchmark::DoNotOptimize(fs.getTable().data());
+    }
+    state.SetItemsProcessed(state.iterations() * fs.getDevices().size());
+    state.counters["streams"] = fs.getStreams().size();
+    state.counters["devices"] = fs.getDevices().size();
+    state.counters["levels"] = fs.levelCount();
+}
+
+#define SHEET_SIZES ->ArgName("streams")->RangeMultiplier(10)->Range(1000, 10000000)->Unit(benchmark::kMillisecond)
+
+BENCHMARK(BM_Sweep<SheetShape::Chain, SweepMode::Serial>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::Chain, SweepMode::Batched>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::Chain, SweepMode::Dirty>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::Chain, SweepMode::Tape>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::Tree, SweepMode::Serial>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::Tree, SweepMode::Batched>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::Tree, SweepMode::Parallel>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::RandomDag, SweepMode::Serial>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::RandomDag, SweepMode::Batched>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::RandomDag, SweepMode::Parallel>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::RandomDag, SweepMode::Dirty>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::RandomDag, SweepMode::Tape>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::Recycle, SweepMode::Serial>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::Recycle, SweepMode::Parallel>) SHEET_SIZES;
+BENCHMARK(BM_Sweep<SheetShape::Recycle, SweepMode::Tape>) SHEET_SIZES;
+
+// ---------------------------------------------------------------------------
+// Construction of a flowsheet.
+// ---------------------------------------------------------------------------
+
+template <SheetShape Shape>
+static void BM_Build(benchmark::State& state) {
+    for (auto _ : state) {
+        Flowsheet fs;
+        buildSheet(fs, Shape, state.range(0));
+        fs.evaluationOrder();
+        benchmark::DoNotOptimize(fs.getTable().data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_Build<SheetShape::Chain>) SHEET_SIZES;
+BENCHMARK(BM_Build<SheetShape::RandomDag>) SHEET_SIZES;
+
+// ---------------------------------------------------------------------------
+// Restart from a snapshot file.
+// ---------------------------------------------------------------------------
+
+static void BM_MappedLoadAndSweep(benchmark::State& state) {
+    const string path = "bench_snapshot.bin";
+    {
+        Flowsheet fs;
+        buildSheet(fs, SheetShape::RandomDag, state.range(0));
+        fs.save(path);
+    }
+    for (auto _ : state) {
+        MappedFlowsheet mapped(path);
+        mapped.evaluate();
+        benchmark::DoNotOptimize(mapped.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    remove(path.c_str());
+}
+BENCHMARK(BM_MappedLoadAndSweep) SHEET_SIZES;
+
+// ---------------------------------------------------------------------------
+// Many feed scenarios: one batched pass against one serial sweep per scenario.
+// ---------------------------------------------------------------------------
+
+static void BM_ScenarioBatch(benchmark::State& state) {
+    Flowsheet fs;
+    buildSheet(fs, SheetShape::RandomDag, 10000);
+    ScenarioBatch batch(fs, state.range(0));
+    for (size_t k = 0; k < batch.laneCount(); k++) batch.lane(*fs.getStreams().front())[k] = 1.0 + k;
+    for (auto _ : state) {
+        batch.evaluate();
+        benchmark::DoNotOptimize(batch.lane(*fs.getStreams().back()));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ScenarioBatch)->ArgName("scenarios")->RangeMultiplier(10)->Range(1, 10000)->Unit(benchmark::kMillisecond);
+
+static void BM_ScenarioSerial(benchmark::State& state) {
+    Flowsheet fs;
+    buildSheet(fs, SheetShape::RandomDag, 10000);
+    auto feed = fs.getStreams().front();
+    for (auto _ : state) {
+        for (int64_t k = 0; k < state.range(0); k++) {
+            feed->setMassFlow(1.0 + k);
+            fs.evaluate();
+        }
+        benchmark::DoNotOptimize(fs.getTable().data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ScenarioSerial)->ArgName("scenarios")->RangeMultiplier(10)->Range(1, 10000)->Unit(benchmark::kMillisecond);
+
+// ---------------------------------------------------------------------------
+// Direct linear solve after a feed change: the LU factors are reused, only the
+// substitutions run. Compare with BM_Sweep<..., Serial> of the same shape.
+// ---------------------------------------------------------------------------
+
+template <SheetShape Shape>
+static void BM_LinearResolve(benchmark::State& state) {
+    Flowsheet fs;
+    buildSheet(fs, Shape, state.range(0));
+    LinearMassBalance balance(fs);
+    balance.solve();
+    auto feed = fs.getStreams().front();
+    double m = 1.0;
+    for (auto _ : state) {
+        feed->setMassFlow(m += 1.0);
+        balance.solve();
+        benchmark::DoNotOptimize(fs.getTable().data());
+    }
+    state.counters["factor_nnz"] = balance.factorNonZeros();
+    state.SetItemsProcessed(state.iterations() * fs.getStreams().size());
+}
+BENCHMARK_TEMPLATE(BM_LinearResolve, SheetShape::RandomDag)->ArgName("streams")->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_LinearResolve, SheetShape::Recycle)->ArgName("streams")->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+
+// ---------------------------------------------------------------------------
+// Partitioned evaluation: one pinned worker per partition, boundary streams
+// exchanged through shared-memory rings.
+// ---------------------------------------------------------------------------
+
+template <SheetShape Shape>
+static void BM_Partitioned(benchmark::State& state) {
+    Flowsheet fs;
+    buildSheet(fs, Shape, 1000000);
+    PartitionedFlowsheet parts(fs, state.range(0));
+    parts.evaluate(); // builds the order and the partitions
+    for (auto _ : state) {
+        parts.evaluate();
+        benchmark::DoNotOptimize(fs.getTable().data());
+    }
+    state.counters["cut_streams"] = parts.getPartitioning().cutStreamCount();
+    state.counters["rounds"] = parts.getLastRounds();
+    state.SetItemsProcessed(state.iterations() * fs.getStreams().size());
+}
+BENCHMARK_TEMPLATE(BM_Partitioned, SheetShape::RandomDag)->ArgName("partitions")->RangeMultiplier(2)->Range(1, 8)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Partitioned, SheetShape::Recycle)->ArgName("partitions")->RangeMultiplier(2)->Range(1, 8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// ---------------------------------------------------------------------------
+// Gradient of the flows with respect to 8 split weights: one dual-number pass
+// against central finite differences (two sweeps per parameter).
+// ---------------------------------------------------------------------------
+
+static vector<Separator*> firstSeparators(Flowsheet& fs, size_t count) {
+    vector<Separator*> found;
+    for (const auto& d : fs.getDevices()) {
+        if (auto* sep = dynamic_cast<Separator*>(d.get()); sep && found.size() < count) found.push_back(sep);
+    }
+    return found;
+}
+
+static void BM_SensitivityDual(benchmark::State& state) {
+    Flowsheet fs;
+    buildSheet(fs, SheetShape::RandomDag, state.range(0));
+    fs.evaluate();
+    Sensitivity<8> sens(fs);
+    for (Separator* sep : firstSeparators(fs, 8)) sens.addSplitWeight(*sep, 0);
+    for (auto _ : state) {
+        sens.evaluate();
+        benchmark::DoNotOptimize(sens.gradient(*fs.getStreams().back()).data());
+    }
+}
+BENCHMARK(BM_SensitivityDual)->ArgName("streams")->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+
+static void BM_SensitivityFiniteDifference(benchmark::State& state) {
+    Flowsheet fs;
+    buildSheet(fs, SheetShape::RandomDag, state.range(0));
+    fs.evaluate();
+    vector<Separator*> seps = firstSeparators(fs, 8);
+    for (auto _ : state) {
+        for (Separator* sep : seps) {
+            vector<double> split = sep->getSplit();
+            for (double h : {1e-6, -1e-6}) {
+                vector<double> perturbed = split;
+                perturbed[0] += h;
+                sep->setSplit(perturbed);
+                fs.evaluate();
+            }
+            sep->setSplit(split);
+        }
+        benchmark::DoNotOptimize(fs.getTable().data());
+    }
+}
+BENCHMARK(BM_SensitivityFiniteDifference)->ArgName("streams")->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+
+// ---------------------------------------------------------------------------
+// Mass-closure audit of every device, as run after a sweep. Compare with
+// BM_Sweep<RandomDag, Serial> of the same size.
+// ---------------------------------------------------------------------------
+
+static void BM_MassClosureAudit(benchmark::State& state) {
+    Flowsheet fs;
+    buildSheet(fs, SheetShape::RandomDag, state.range(0));
+    fs.evaluate();
+    ThreadPool pool(max(1u, thread::hardware_concurrency()) - 1);
+    MassClosureAudit audit(fs);
+    for (auto _ : state) {
+        ClosureReport report = audit.run(10, &pool);
+        benchmark::DoNotOptimize(report.maxRelative);
+    }
+    state.SetItemsProcessed(state.iterations() * fs.getDevices().size());
+}
+BENCHMARK(BM_MassClosureAudit) SHEET_SIZES;
+
+BENCHMARK_MAIN();
@@ -0,0 +1,206 @@
+#define DEVICE_NO_MAIN
+#include "../Flowsheet.cpp"
+#include "TestFramework.cpp"
+
+// Тест 1: малый вектор компонентов хранится без кучи
+void testComponentVectorInline(TestFramework& tf) {
+    ComponentVector small{1.0, 2.0, 3.0};
+    ComponentVector large(ComponentVector::InlineCapacity + 1, 1.0);
+    ComponentVector moved = std::move(large);
+
+    tf.assertTrue(small.isInline(), "ComponentVectorInline - small is inline");
+    tf.assertTrue(!moved.isInline(), "ComponentVectorInline - large is on the heap");
+    tf.assertDoubleEqual(small.sum(), 6.0, "ComponentVectorInline - sum");
+    tf.assertDoubleEqual(moved.sum(), 5.0, "ComponentVectorInline - moved sum");
+    tf.assertTrue(large.size() == 0, "ComponentVectorInline - moved-from is empty");
+}
+
+// Тест 2: смеситель складывает покомпонентно
+void testMixerSumsComponents(TestFramework& tf) {
+    Flowsheet fs;
+    fs.setComponentCount(2);
+    auto a = fs.addStream();
+    auto b = fs.addStream();
+    auto out = fs.addStream();
+    auto mix = fs.addDevice<Mixer>(2);
+    mix->addInput(a);
+    mix->addInput(b);
+    mix->addOutput(out);
+
+    a->setComponents({1.0, 2.0});
+    b->setComponents({3.0, 4.0});
+    fs.evaluate();
+
+    tf.assertDoubleEqual(out->getComponentFlow(0), 4.0, "MixerSumsComponents - component 0");
+    tf.assertDoubleEqual(out->getComponentFlow(1), 6.0, "MixerSumsComponents - component 1");
+    tf.assertDoubleEqual(out->getMassFlow(), 10.0, "MixerSumsComponents - total");
+}
+
+// Тест 3: сепаратор делит каждый компонент по своей доле
+void testSeparatorSplitsPerComponent(TestFramework& tf) {
+    Flowsheet fs;
+    fs.setComponentCount(3);
+    auto in = fs.addStream();
+    auto top = fs.addStream();
+    auto bottom = fs.addStream();
+    auto sep = fs.addDevice<Separator>();
+    sep->addInput(in);
+    sep->addOutput(top);
+    sep->addOutput(bottom);
+    sep->setComponentSplit({1.0, 0.25, 0.0});
+
+    in->setComponents({10.0, 20.0, 30.0});
+    fs.evaluate();
+
+    tf.assertDoubleEqual(top->getMassFlow(), 15.0, "SeparatorSplitsPerComponent - top total");
+    tf.assertDoubleEqual(bottom->getMassFlow(), 45.0, "SeparatorSplitsPerComponent - bottom total");
+    tf.assertDoubleEqual(bottom->getComponentFlow(1), 15.0, "SeparatorSplitsPerComponent - bottom component 1");
+}
+
+// Тест 4: реактор применяет стехиометрическую матрицу
+void testReactorAppliesConversion(TestFramework& tf) {
+    Flowsheet fs;
+    fs.setComponentCount(2);
+    auto in = fs.addStream();
+    auto out = fs.addStream();
+    auto r = fs.addDevice<Reactor>(false);
+    r->addInput(in);
+    r->addOutput(out);
+    // 40% компонента A превращается в B
+    r->setConversion({0.6, 0.0,
+                      0.4, 1.0});
+
+    in->setComponents({10.0, 1.0});
+    fs.evaluate();
+
+    tf.assertDoubleEqual(out->getComponentFlow(0), 6.0, "ReactorAppliesConversion - A left");
+    tf.assertDoubleEqual(out->getComponentFlow(1), 5.0, "ReactorAppliesConversion - B formed");
+    tf.assertDoubleEqual(out->getMassFlow(), 11.0, "ReactorAppliesConversion - mass conserved");
+}
+
+// Тест 5: рецикл сходится и по компонентам
+void testRecycleConvergesComponents(TestFramework& tf) {
+    Flowsheet fs;
+    fs.setComponentCount(2);
+    auto feed = fs.addStream();
+    auto loop = fs.addStream();
+    auto mixed = fs.addStream();
+    auto product = fs.addStream();
+    auto mix = fs.addDevice<Mixer>(2);
+    auto sep = fs.addDevice<Separator>();
+    mix->addInput(feed);
+    mix->addInput(loop);
+    mix->addOutput(mixed);
+    sep->addInput(mixed);
+    sep->addOutput(product);
+    sep->addOutput(loop);
+    sep->setComponentSplit({0.5, 0.8});
+
+    feed->setComponents({10.0, 10.0});
+    fs.evaluate();
+
+    tf.assertDoubleEqual(product->getComponentFlow(0), 10.0, "RecycleConvergesComponents - A out", 1e-6);
+    tf.assertDoubleEqual(product->getComponentFlow(1), 10.0, "RecycleConvergesComponents - B out", 1e-6);
+    tf.assertDoubleEqual(mixed->getComponentFlow(1), 12.5, "RecycleConvergesComponents - B in loop", 1e-6);
+}
+
+// Тест 6: общий расход сохраняется, даже если компоненты не заданы
+void testTotalsKeptWithoutComponents(TestFramework& tf) {
+    Flowsheet fs;
+    fs.setComponentCount(2);
+    auto plain = fs.addStream();
+    auto split = fs.addStream();
+    auto mixed = fs.addStream();
+    auto top = fs.addStream();
+    auto bottom = fs.addStream();
+    auto reacted = fs.addStream();
+    auto mix = fs.addDevice<Mixer>(2);
+    auto sep = fs.addDevice<Separator>(vector<double>{1.0, 3.0});
+    auto r = fs.addDevice<Reactor>(false);
+    mix->addInput(plain);
+    mix->addInput(split);
+    mix->addOutput(mixed);
+    sep->addInput(mixed);
+    sep->addOutput(top);
+    sep->addOutput(bottom);
+    r->addInput(bottom);
+    r->addOutput(reacted);
+
+    plain->setMassFlow(8.0); // только общий расход, без разбивки по компонентам
+    fs.evaluate();
+    tf.assertDoubleEqual(top->getMassFlow(), 2.0, "TotalsKeptWithoutComponents - separator uses its fractions");
+    tf.assertDoubleEqual(reacted->getMassFlow(), 6.0, "TotalsKeptWithoutComponents - reactor keeps the mass");
+
+    split->setComponents({1.0, 3.0}); // на входе сепаратора 12, из них 4 по компонентам
+    sep->setComponentSplit({1.0, 0.0});
+    fs.evaluate();
+    tf.assertDoubleEqual(top->getMassFlow(), 3.0, "TotalsKeptWithoutComponents - share of the components");
+    tf.assertDoubleEqual(top->getMassFlow() + reacted->getMassFlow(), 12.0, "TotalsKeptWithoutComponents - mass closes");
+    tf.assertDoubleEqual(reacted->getComponentFlow(1), 3.0, "TotalsKeptWithoutComponents - components are a breakdown");
+}
+
+// Тест 7: матрица конверсии неверного размера, заданная после расчёта, проверяется
+void testConversionResizedAfterEvaluate(TestFramework& tf) {
+    Flowsheet fs;
+    fs.setComponentCount(3);
+    auto in = fs.addStream();
+    auto out = fs.addStream();
+    auto r = fs.addDevice<Reactor>(false);
+    r->addInput(in);
+    r->addOutput(out);
+    in->setComponents({1.0, 2.0, 3.0});
+    fs.evaluate();
+
+    r->setConversion({1.0, 0.0, 0.0, 1.0});
+    DeviceError code = DeviceError::None;
+    try {
+        fs.evaluate();
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(code == DeviceError::ConversionSize, "ConversionResizedAfterEvaluate - size reported");
+}
+
+// Тест 8: покомпонентное деление неверного размера, заданное после расчёта, проверяется
+void testComponentSplitResizedAfterEvaluate(TestFramework& tf) {
+    Flowsheet fs;
+    fs.setComponentCount(3);
+    auto in = fs.addStream();
+    auto top = fs.addStream();
+    auto bottom = fs.addStream();
+    auto sep = fs.addDevice<Separator>();
+    sep->addInput(in);
+    sep->addOutput(top);
+    sep->addOutput(bottom);
+    in->setComponents({1.0, 2.0, 3.0});
+    fs.evaluate();
+
+    sep->setComponentSplit(ComponentVector{0.5});
+    DeviceError code = DeviceError::None;
+    try {
+        fs.evaluate();
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(code == DeviceError::SplitSize, "ComponentSplitResizedAfterEvaluate - size reported");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running component tests..." << std::endl;
+    std::cout << "==========================" << std::endl;
+
+    testComponentVectorInline(tf);
+    testMixerSumsComponents(tf);
+    testSeparatorSplitsPerComponent(tf);
+    testReactorAppliesConversion(tf);
+    testRecycleConvergesComponents(tf);
+    testTotalsKeptWithoutComponents(tf);
+    testConversionResizedAfterEvaluate(tf);
+    testComponentSplitResizedAfterEvaluate(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
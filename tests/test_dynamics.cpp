@@ -0,0 +1,131 @@
+#define DEVICE_NO_MAIN
+#include "../DynamicSimulator.cpp"
+#include "TestFramework.cpp"
+
+// Тест 1: переходный процесс одной ёмкости совпадает с аналитическим решением
+void testSingleTankStepResponse(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed = fs.addStream();
+    auto out = fs.addStream();
+    auto tank = fs.addDevice<Tank>(1, 2.0);
+    tank->addInput(feed);
+    tank->addOutput(out);
+    feed->setMassFlow(5.0);
+    DynamicSimulator sim(fs);
+    sim.advance(1.0);
+    double expected1 = 5.0 * (1.0 - std::exp(-0.5));
+    tf.assertTrue(std::abs(out->getMassFlow() - expected1) < 1e-4, "SingleTankStepResponse - outflow at t = 1");
+    sim.advance(10.0);
+    double expected10 = 5.0 * (1.0 - std::exp(-5.0));
+    tf.assertTrue(std::abs(out->getMassFlow() - expected10) < 5e-4, "SingleTankStepResponse - outflow at t = 10");
+    tf.assertDoubleEqual(sim.getTime(), 10.0, "SingleTankStepResponse - lands on the end time");
+    tf.assertTrue(std::abs(tank->getHoldup() - 2.0 * expected10) < 1e-3, "SingleTankStepResponse - holdup is tau * outflow");
+}
+
+// Тест 2: жёсткая система (быстрая и медленная ёмкости) не требует мелкого шага
+void testStiffChain(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed = fs.addStream();
+    auto mid = fs.addStream();
+    auto out = fs.addStream();
+    auto fast = fs.addDevice<Tank>(1, 1e-4);
+    auto slow = fs.addDevice<Tank>(1, 10.0);
+    fast->addInput(feed);
+    fast->addOutput(mid);
+    slow->addInput(mid);
+    slow->addOutput(out);
+    feed->setMassFlow(1.0);
+    DynamicSimulator sim(fs);
+    sim.advance(50.0);
+    double expected = 1.0 - std::exp(-5.0); // быстрая ёмкость практически безынерционна
+    tf.assertTrue(std::abs(out->getMassFlow() - expected) < 1e-3, "StiffChain - slow tank follows its time constant");
+    tf.assertTrue(sim.getStats().steps < 1000, "StiffChain - step size not limited by the fast tank");
+}
+
+// Тест 3: разреженность якобиана цепочки ёмкостей и число групп столбцов
+void testChainSparsity(TestFramework& tf) {
+    Flowsheet fs;
+    auto s0 = fs.addStream();
+    auto s1 = fs.addStream();
+    auto s2 = fs.addStream();
+    auto s3 = fs.addStream();
+    auto t1 = fs.addDevice<Tank>(1, 1.0);
+    auto t2 = fs.addDevice<Tank>(1, 1.0);
+    auto t3 = fs.addDevice<Tank>(1, 1.0);
+    t1->addInput(s0);
+    t1->addOutput(s1);
+    t2->addInput(s1);
+    t2->addOutput(s2);
+    t3->addInput(s2);
+    t3->addOutput(s3);
+    DynamicSimulator sim(fs);
+    tf.assertEqual(sim.stateCount(), size_t(3), "ChainSparsity - one state per tank");
+    tf.assertEqual(sim.jacobianNonZeros(), size_t(5), "ChainSparsity - diagonal and one upstream entry");
+    tf.assertEqual(sim.jacobianColors(), size_t(2), "ChainSparsity - two residuals per jacobian");
+}
+
+// Схема: питание -> смеситель -> ёмкость -> делитель -> продукт, часть возвращается в смеситель
+struct RecycleTank {
+    Flowsheet fs;
+    shared_ptr<Stream> feed, product;
+    shared_ptr<Tank> tank;
+
+    RecycleTank() {
+        feed = fs.addStream();
+        auto mixed = fs.addStream();
+        auto drained = fs.addStream();
+        auto loop = fs.addStream();
+        product = fs.addStream();
+        auto mix = fs.addDevice<Mixer>(2);
+        tank = fs.addDevice<Tank>(1, 1.0);
+        auto sep = fs.addDevice<Separator>(vector<double>{0.5, 0.5});
+        mix->addInput(feed);
+        mix->addInput(loop);
+        mix->addOutput(mixed);
+        tank->addInput(mixed);
+        tank->addOutput(drained);
+        sep->addInput(drained);
+        sep->addOutput(product);
+        sep->addOutput(loop);
+        feed->setMassFlow(3.0);
+    }
+};
+
+// Тест 4: ёмкость в рецикле выходит на стационар, где продукт равен питанию
+void testRecycleSteadyState(TestFramework& tf) {
+    RecycleTank s;
+    DynamicSimulator sim(s.fs);
+    tf.assertEqual(sim.jacobianNonZeros(), size_t(1), "RecycleSteadyState - tank depends on itself through the loop");
+    sim.advance(60.0);
+    tf.assertTrue(std::abs(s.product->getMassFlow() - 3.0) < 1e-4, "RecycleSteadyState - product equals feed");
+    tf.assertTrue(std::abs(s.tank->getHoldup() - 6.0) < 1e-3, "RecycleSteadyState - holdup doubled by the recycle");
+}
+
+// Тест 5: параллельное вычисление невязок даёт тот же результат
+void testParallelResidualsMatch(TestFramework& tf) {
+    RecycleTank serial, parallel;
+    ThreadPool pool(2);
+    DynamicSimulator a(serial.fs), b(parallel.fs);
+    b.setThreadPool(&pool);
+    a.advance(5.0);
+    b.advance(5.0);
+    tf.assertDoubleEqual(parallel.tank->getHoldup(), serial.tank->getHoldup(), "ParallelResidualsMatch - same holdup");
+    tf.assertEqual(b.getStats().steps, a.getStats().steps, "ParallelResidualsMatch - same steps");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running dynamic simulator tests..." << std::endl;
+    std::cout << "==================================" << std::endl;
+
+    testSingleTankStepResponse(tf);
+    testStiffChain(tf);
+    testChainSparsity(tf);
+    testRecycleSteadyState(tf);
+    testParallelResidualsMatch(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+#define DEVICE_NO_MAIN
+#include "../FixedDevice.cpp"
+#include "../Separator.cpp"
+#include "TestFramework.cpp"
+
+// Подключение порта вне диапазона не компилируется
+template <class D>
+concept CanConnectInput2 = requires(D d, const Stream& s) { d.template connectInput<2>(s); };
+static_assert(CanConnectInput2<FixedMixer<3>>);
+static_assert(!CanConnectInput2<FixedMixer<2>>);
+static_assert(!CanConnectInput2<FixedSeparator>);
+static_assert(sizeof(FixedSeparator) == sizeof(FixedDevice<1, 2>) + 2 * sizeof(double));
+
+// Тест 1: фиксированный смеситель складывает входы
+void testFixedMixerSums(TestFramework& tf) {
+    StreamTable table;
+    Stream a(table, 1), b(table, 2), c(table, 3), out(table, 4);
+    a.setMassFlow(1.0);
+    b.setMassFlow(2.0);
+    c.setMassFlow(4.0);
+
+    FixedMixer<3> mix;
+    mix.connectInput<0>(a);
+    mix.connectInput<1>(b);
+    mix.connectInput<2>(c);
+    tf.assertTrue(!mix.portsComplete(), "FixedMixerSums - output missing");
+    mix.connectOutput<0>(out);
+    tf.assertTrue(mix.portsComplete(), "FixedMixerSums - ports complete");
+
+    mix.updateOutputs();
+    tf.assertDoubleEqual(out.getMassFlow(), 7.0, "FixedMixerSums - output");
+}
+
+// Тест 2: доли фиксированного делителя нормируются один раз
+void testFixedSplitterNormalizes(TestFramework& tf) {
+    StreamTable table;
+    Stream in(table, 1), a(table, 2), b(table, 3), c(table, 4);
+    in.setMassFlow(10.0);
+
+    FixedSplitter<3> split({1.0, 1.0, 2.0});
+    split.connect({&in}, {&a, &b, &c});
+    split.updateOutputs();
+
+    tf.assertDoubleEqual(split.getFractions()[2], 0.5, "FixedSplitterNormalizes - fraction");
+    tf.assertDoubleEqual(a.getMassFlow(), 2.5, "FixedSplitterNormalizes - a");
+    tf.assertDoubleEqual(c.getMassFlow(), 5.0, "FixedSplitterNormalizes - c");
+}
+
+// Тест 3: ферма фиксированных устройств совпадает с обычными устройствами
+void testFarmMatchesDevices(TestFramework& tf) {
+    StreamTable table;
+    vector<shared_ptr<Stream>> streams;
+    for (int i = 0; i < 300; i++) {
+        streams.push_back(make_shared<Stream>(table, i));
+        streams.back()->setMassFlow(i * 0.25);
+    }
+
+    FixedDeviceFarm<FixedSeparator> farm;
+    vector<Separator> reference(100);
+    for (int u = 0; u < 100; u++) {
+        farm.add().connect({streams[u].get()}, {streams[100 + u].get(), streams[200 + u].get()});
+    }
+    farm.updateOutputs();
+    vector<double> fixed(table.data(), table.data() + table.size());
+
+    for (int u = 0; u < 100; u++) {
+        reference[u].addInput(streams[u]);
+        reference[u].addOutput(streams[100 + u]);
+        reference[u].addOutput(streams[200 + u]);
+        reference[u].updateOutputs();
+    }
+    bool same = true;
+    for (size_t i = 0; i < table.size(); i++) same = same && fixed[i] == table.flow(i);
+    tf.assertTrue(same, "FarmMatchesDevices - identical stream values");
+}
+
+// Тест 4: повторное подключение порта не завершает подключение
+void testPortConnectedTwice(TestFramework& tf) {
+    StreamTable table;
+    Stream in(table, 1), a(table, 2), b(table, 3);
+
+    FixedSeparator split;
+    split.connectInput<0>(in);
+    split.connectOutput<0>(a);
+    split.connectOutput<0>(b);
+    tf.assertTrue(!split.portsComplete(), "PortConnectedTwice - second output missing");
+    split.connectOutput<1>(b);
+    tf.assertTrue(split.portsComplete(), "PortConnectedTwice - ports complete");
+}
+
+// Тест 5: отрицательные и нулевые доли отвергаются, как у Separator
+void testFixedSplitterRejectsFractions(TestFramework& tf) {
+    const array<double, 2> invalid[] = {{-1.0, 2.0}, {0.0, 0.0}};
+    for (const auto& f : invalid) {
+        DeviceError code = DeviceError::None;
+        try {
+            FixedSplitter<2> split(f);
+        } catch (const DeviceException& e) {
+            code = e.code();
+        }
+        tf.assertTrue(code == DeviceError::SplitFractions, "FixedSplitterRejectsFractions - rejected");
+    }
+}
+
+// Тест 6: фиксированный смеситель совпадает со смесителем до последнего бита
+void testFixedMixerMatchesMixer(TestFramework& tf) {
+    StreamTable table;
+    auto a = std::make_shared<Stream>(table, 1);
+    auto b = std::make_shared<Stream>(table, 2);
+    auto c = std::make_shared<Stream>(table, 3);
+    auto fixedOut = std::make_shared<Stream>(table, 4);
+    auto mixerOut = std::make_shared<Stream>(table, 5);
+    FixedMixer<3> fixed;
+    fixed.connect({a.get(), b.get(), c.get()}, {fixedOut.get()});
+    Mixer mixer(3);
+    mixer.addInput(a);
+    mixer.addInput(b);
+    mixer.addInput(c);
+    mixer.addOutput(mixerOut);
+
+    const double cases[][3] = {{1e16, 1.0, -1e16}, {0.1, 0.2, 0.3}, {1e-3, 1e17, 3.0}, {-7.25, 1e300, -1e300}};
+    bool same = true;
+    for (const auto& v : cases) {
+        a->setMassFlow(v[0]);
+        b->setMassFlow(v[1]);
+        c->setMassFlow(v[2]);
+        fixed.updateOutputs();
+        mixer.updateOutputs();
+        same = same && fixedOut->getMassFlow() == mixerOut->getMassFlow();
+    }
+    tf.assertTrue(same, "FixedMixerMatchesMixer - bit-identical sums");
+    a->setMassFlow(1e16);
+    b->setMassFlow(1.0);
+    c->setMassFlow(-1e16);
+    fixed.updateOutputs();
+    tf.assertDoubleEqual(fixedOut->getMassFlow(), 1.0, "FixedMixerMatchesMixer - cancellation compensated");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running fixed device tests..." << std::endl;
+    std::cout << "=============================" << std::endl;
+
+    testFixedMixerSums(tf);
+    testFixedSplitterNormalizes(tf);
+    testFarmMatchesDevices(tf);
+    testPortConnectedTwice(tf);
+    testFixedSplitterRejectsFractions(tf);
+    testFixedMixerMatchesMixer(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
@@ -0,0 +1,377 @@
+#define DEVICE_NO_MAIN
+#include "../Flowsheet.cpp"
+#include "TestFramework.cpp"
+
+// Тест 1: устройства вычисляются в топологическом порядке независимо от порядка добавления
+void testEvaluatesInTopologicalOrder(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed1 = fs.addStream();
+    auto feed2 = fs.addStream();
+    auto mixed = fs.addStream();
+    auto out1 = fs.addStream();
+    auto out2 = fs.addStream();
+
+    // Сепаратор добавлен раньше смесителя, который его питает
+    auto sep = fs.addDevice<Separator>();
+    auto mix = fs.addDevice<Mixer>(2);
+    fs.connectInput(*sep, mixed);
+    fs.connectOutput(*sep, out1);
+    fs.connectOutput(*sep, out2);
+    fs.connectInput(*mix, feed1);
+    fs.connectInput(*mix, feed2);
+    fs.connectOutput(*mix, mixed);
+
+    feed1->setMassFlow(10.0);
+    feed2->setMassFlow(30.0);
+    fs.evaluate();
+
+    tf.assertTrue(fs.evaluationOrder().front() == mix.get(), "TopologicalOrder - mixer first");
+    tf.assertDoubleEqual(mixed->getMassFlow(), 40.0, "TopologicalOrder - mixed");
+    tf.assertDoubleEqual(out1->getMassFlow(), 20.0, "TopologicalOrder - out1");
+    tf.assertDoubleEqual(out2->getMassFlow(), 20.0, "TopologicalOrder - out2");
+}
+
+// Тест 2: порядок кешируется и пересчитывается только при изменении связей
+void testOrderCachedUntilRewired(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed = fs.addStream();
+    auto mid = fs.addStream();
+    auto out = fs.addStream();
+
+    auto r1 = fs.addDevice<Reactor>(false);
+    fs.connectInput(*r1, feed);
+    fs.connectOutput(*r1, mid);
+
+    tf.assertTrue(fs.evaluationOrder().size() == 1, "OrderCached - single device");
+
+    auto r2 = fs.addDevice<Reactor>(false);
+    r2->addInput(mid); // прямое подключение тоже отслеживается
+    r2->addOutput(out);
+
+    feed->setMassFlow(7.0);
+    fs.evaluate();
+    tf.assertTrue(fs.evaluationOrder().size() == 2, "OrderCached - rebuilt after rewiring");
+    tf.assertDoubleEqual(out->getMassFlow(), 7.0, "OrderCached - chain evaluated");
+}
+
+// Рецикл: смеситель питается питанием и половиной выхода сепаратора
+struct RecycleSheet {
+    Flowsheet fs;
+    shared_ptr<Stream> feed, loop, mixed, product;
+    RecycleSheet() {
+        feed = fs.addStream();
+        loop = fs.addStream();
+        mixed = fs.addStream();
+        product = fs.addStream();
+        auto mix = fs.addDevice<Mixer>(2);
+        auto sep = fs.addDevice<Separator>();
+        fs.connectInput(*mix, feed);
+        fs.connectInput(*mix, loop);
+        fs.connectOutput(*mix, mixed);
+        fs.connectInput(*sep, mixed);
+        fs.connectOutput(*sep, product);
+        fs.connectOutput(*sep, loop);
+        feed->setMassFlow(10.0);
+    }
+};
+
+// Тест 3: рецикл сходится каждым из методов, ускоренные быстрее прямой подстановки
+void testConvergesRecycle(TestFramework& tf) {
+    int sweeps[3];
+    ConvergenceOptions::Method methods[3] = {ConvergenceOptions::DirectSubstitution, ConvergenceOptions::Wegstein, ConvergenceOptions::Broyden};
+    for (int m = 0; m < 3; m++) {
+        RecycleSheet sheet;
+        ConvergenceOptions options;
+        options.method = methods[m];
+        sheet.fs.setConvergenceOptions(options);
+        sheet.fs.evaluate();
+        sweeps[m] = sheet.fs.getLastRecycleSweeps();
+        tf.assertDoubleEqual(sheet.mixed->getMassFlow(), 20.0, "ConvergesRecycle - mixed", 1e-6);
+        tf.assertDoubleEqual(sheet.product->getMassFlow(), 10.0, "ConvergesRecycle - product", 1e-6);
+    }
+    RecycleSheet sheet;
+    tf.assertTrue(sheet.fs.tearStreams().size() == 1, "ConvergesRecycle - one tear stream");
+    tf.assertTrue(sweeps[1] < sweeps[0] && sweeps[2] < sweeps[0], "ConvergesRecycle - accelerated methods need fewer sweeps");
+}
+
+// Тест 3а: нехватка итераций приводит к ошибке
+void testThrowsWhenNotConverged(TestFramework& tf) {
+    RecycleSheet sheet;
+    ConvergenceOptions options;
+    options.method = ConvergenceOptions::DirectSubstitution;
+    options.maxIterations = 3;
+    sheet.fs.setConvergenceOptions(options);
+    try {
+        sheet.fs.evaluate();
+        tf.assertTrue(false, "ThrowsWhenNotConverged - should have thrown");
+    } catch (const DeviceException& e) {
+        tf.assertTrue(e.code() == DeviceError::NotConverged, "ThrowsWhenNotConverged - threw correctly");
+    }
+}
+
+// Тест 4б: несходящийся рецикл в параллельном вычислении бросает исключение вызывающему
+void testParallelThrowsWhenNotConverged(TestFramework& tf) {
+    Flowsheet fs;
+    for (int i = 0; i < 8; i++) {
+        auto feed = fs.addStream();
+        auto loop = fs.addStream();
+        auto mixed = fs.addStream();
+        auto product = fs.addStream();
+        auto mix = fs.addDevice<Mixer>(2);
+        auto sep = fs.addDevice<Separator>();
+        fs.connectInput(*mix, feed);
+        fs.connectInput(*mix, loop);
+        fs.connectOutput(*mix, mixed);
+        fs.connectInput(*sep, mixed);
+        fs.connectOutput(*sep, product);
+        fs.connectOutput(*sep, loop);
+        feed->setMassFlow(10.0 + i);
+    }
+    ConvergenceOptions options;
+    options.maxIterations = 1;
+    fs.setConvergenceOptions(options);
+    ThreadPool pool(3);
+    bool threw = false;
+    try {
+        fs.evaluateParallel(pool, 1);
+    } catch (const DeviceException& e) {
+        threw = e.code() == DeviceError::NotConverged;
+    }
+    tf.assertTrue(threw, "ParallelThrowsWhenNotConverged - error reaches the caller");
+    options.maxIterations = 200;
+    fs.setConvergenceOptions(options);
+    fs.evaluateParallel(pool, 1);
+    tf.assertDoubleEqual(fs.getStreams()[3]->getMassFlow(), 10.0, "ParallelThrowsWhenNotConverged - pool usable afterwards", 1e-6);
+}
+
+// Построение дерева: слой смесителей, каждый из которых питает реактор
+static void buildMixerReactorFarm(Flowsheet& fs, int units) {
+    for (int i = 0; i < units; i++) {
+        auto a = fs.addStream();
+        auto b = fs.addStream();
+        auto mixed = fs.addStream();
+        auto out = fs.addStream();
+        a->setMassFlow(i);
+        b->setMassFlow(0.5 * i);
+        auto mix = fs.addDevice<Mixer>(2);
+        auto r = fs.addDevice<Reactor>(false);
+        r->addInput(mixed);
+        r->addOutput(out);
+        mix->addInput(a);
+        mix->addInput(b);
+        mix->addOutput(mixed);
+    }
+}
+
+// Тест 4: устройства разбиваются на уровни зависимостей
+void testSplitsIntoLevels(TestFramework& tf) {
+    Flowsheet fs;
+    buildMixerReactorFarm(fs, 10);
+    tf.assertTrue(fs.levelCount() == 2, "SplitsIntoLevels - two levels");
+    auto first = fs.level(0);
+    tf.assertTrue(first.size() == 10, "SplitsIntoLevels - ten mixers in level 0");
+    tf.assertTrue(dynamic_cast<Mixer*>(first.front()) != nullptr, "SplitsIntoLevels - level 0 holds mixers");
+}
+
+// Тест 5: параллельное вычисление даёт тот же результат, что и последовательное
+void testParallelMatchesSerial(TestFramework& tf) {
+    Flowsheet serial, parallel;
+    buildMixerReactorFarm(serial, 500);
+    buildMixerReactorFarm(parallel, 500);
+
+    ThreadPool pool(4);
+    serial.evaluate();
+    parallel.evaluateParallel(pool, 16);
+
+    bool same = true;
+    for (size_t i = 0; i < serial.getStreams().size(); i++) {
+        same = same && serial.getStreams()[i]->getMassFlow() == parallel.getStreams()[i]->getMassFlow();
+    }
+    tf.assertTrue(same, "ParallelMatchesSerial - identical stream values");
+    tf.assertDoubleEqual(parallel.getStreams().back()->getMassFlow(), 1.5 * 499, "ParallelMatchesSerial - last output");
+}
+
+// Тест 5а: параллельное вычисление сообщает число итераций рецикла, как последовательное
+void testParallelCountsRecycleSweeps(TestFramework& tf) {
+    RecycleSheet serial, parallel;
+    ThreadPool pool(2);
+    serial.fs.evaluate();
+    parallel.fs.evaluateParallel(pool);
+    tf.assertTrue(serial.fs.getLastRecycleSweeps() > 0, "ParallelCountsRecycleSweeps - serial sweeps counted");
+    tf.assertEqual(parallel.fs.getLastRecycleSweeps(), serial.fs.getLastRecycleSweeps(),
+                   "ParallelCountsRecycleSweeps - same count");
+}
+
+// Тест 6: изменение одного питания пересчитывает только устройства ниже по потоку
+void testRecomputesOnlyDownstream(TestFramework& tf) {
+    Flowsheet fs;
+    buildMixerReactorFarm(fs, 100);
+    fs.evaluate();
+    tf.assertTrue(fs.recomputeDirty() == 0, "RecomputesOnlyDownstream - nothing dirty after evaluate");
+
+    auto& streams = fs.getStreams();
+    streams[4 * 10]->setMassFlow(1000.0); // первое питание одиннадцатого смесителя
+    size_t recomputed = fs.recomputeDirty();
+
+    tf.assertTrue(recomputed == 2, "RecomputesOnlyDownstream - mixer and reactor re-run");
+    tf.assertDoubleEqual(streams[4 * 10 + 3]->getMassFlow(), 1005.0, "RecomputesOnlyDownstream - reactor output");
+}
+
+// Тест 7: распространение останавливается, если выход не изменился
+void testStopsWhenOutputUnchanged(TestFramework& tf) {
+    Flowsheet fs;
+    auto a = fs.addStream();
+    auto b = fs.addStream();
+    auto mixed = fs.addStream();
+    auto out = fs.addStream();
+    auto mix = fs.addDevice<Mixer>(2);
+    auto r = fs.addDevice<Reactor>(false);
+    mix->addInput(a);
+    mix->addInput(b);
+    mix->addOutput(mixed);
+    r->addInput(mixed);
+    r->addOutput(out);
+    a->setMassFlow(1.0);
+    b->setMassFlow(2.0);
+    fs.evaluate();
+
+    // сумма сохраняется: реактор пересчитывать не нужно
+    a->setMassFlow(2.0);
+    b->setMassFlow(1.0);
+    tf.assertTrue(fs.recomputeDirty() == 1, "StopsWhenOutputUnchanged - only mixer re-run");
+
+    a->setMassFlow(2.0 + 1e-9);
+    tf.assertTrue(fs.recomputeDirty(1e-6) == 1, "StopsWhenOutputUnchanged - change within tolerance");
+
+    a->setMassFlow(5.0);
+    tf.assertTrue(fs.recomputeDirty(1e-6) == 2, "StopsWhenOutputUnchanged - change propagates");
+    tf.assertDoubleEqual(out->getMassFlow(), 6.0, "StopsWhenOutputUnchanged - reactor output");
+}
+
+// Тест 8: изменение питания рецикла пересчитывает весь контур
+void testRecomputesRecycleLoop(TestFramework& tf) {
+    RecycleSheet sheet;
+    sheet.fs.evaluate();
+    sheet.feed->setMassFlow(30.0);
+    tf.assertTrue(sheet.fs.recomputeDirty() == 2, "RecomputesRecycleLoop - loop re-run once");
+    tf.assertDoubleEqual(sheet.product->getMassFlow(), 30.0, "RecomputesRecycleLoop - product", 1e-6);
+
+    ThreadPool pool(2);
+    sheet.feed->setMassFlow(4.0);
+    sheet.fs.evaluateParallel(pool);
+    tf.assertDoubleEqual(sheet.mixed->getMassFlow(), 8.0, "RecomputesRecycleLoop - parallel mixed", 1e-6);
+
+    sheet.feed->setMassFlow(6.0);
+    sheet.fs.evaluateBatched();
+    tf.assertDoubleEqual(sheet.mixed->getMassFlow(), 12.0, "RecomputesRecycleLoop - batched mixed", 1e-6);
+}
+
+// Тест 9: пакетное вычисление совпадает с поустройственным на всех наборах инструкций
+void testBatchedMatchesScalar(TestFramework& tf) {
+    Flowsheet reference;
+    buildMixerReactorFarm(reference, 37);
+    reference.evaluate();
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512}) {
+        setSimdLevel(level);
+        Flowsheet fs;
+        buildMixerReactorFarm(fs, 37);
+        auto in = fs.addStream();
+        auto a = fs.addStream();
+        auto b = fs.addStream();
+        auto sep = fs.addDevice<Separator>();
+        sep->addInput(in);
+        sep->addOutput(a);
+        sep->addOutput(b);
+        in->setMassFlow(3.0);
+        fs.evaluateBatched();
+
+        bool same = true;
+        for (size_t i = 0; i < reference.getStreams().size(); i++) {
+            same = same && reference.getStreams()[i]->getMassFlow() == fs.getStreams()[i]->getMassFlow();
+        }
+        tf.assertTrue(same, "BatchedMatchesScalar - identical stream values");
+        tf.assertDoubleEqual(b->getMassFlow(), 1.5, "BatchedMatchesScalar - separator output");
+    }
+    setSimdLevel(SimdLevel::Avx512);
+}
+
+// Тест 11: сепаратор на N выходов с весами, нормированными один раз
+void testWeightedSeparator(TestFramework& tf) {
+    Flowsheet fs;
+    auto in = fs.addStream();
+    auto sep = fs.addDevice<Separator>(vector<double>{1.0, 2.0, 3.0, 4.0});
+    sep->addInput(in);
+    vector<shared_ptr<Stream>> outs;
+    for (int j = 0; j < 4; j++) {
+        outs.push_back(fs.addStream());
+        sep->addOutput(outs.back());
+    }
+    in->setMassFlow(20.0);
+    fs.evaluate();
+    tf.assertDoubleEqual(outs[0]->getMassFlow(), 2.0, "WeightedSeparator - first share");
+    tf.assertDoubleEqual(outs[3]->getMassFlow(), 8.0, "WeightedSeparator - last share");
+
+    unsigned long version = fs.getWiringVersion();
+    sep->setSplit({1.0, 1.0, 1.0, 1.0});
+    fs.evaluateBatched();
+    tf.assertTrue(fs.getWiringVersion() != version, "WeightedSeparator - new split invalidates plans");
+    tf.assertDoubleEqual(outs[3]->getMassFlow(), 5.0, "WeightedSeparator - batched with new split");
+
+    bool thrown = false;
+    try {
+        sep->setSplit({1.0, -1.0, 1.0, 1.0});
+    } catch (const DeviceException& e) {
+        thrown = e.code() == DeviceError::SplitFractions;
+    }
+    tf.assertTrue(thrown, "WeightedSeparator - negative weight rejected");
+}
+
+// Тест 12: схема проверяется при перестроении порядка, недоподключённое устройство не вычисляется
+void testEvaluateValidatesWiring(TestFramework& tf) {
+    Flowsheet fs;
+    auto in = fs.addStream();
+    auto top = fs.addStream();
+    auto sep = fs.addDevice<Separator>();
+    sep->addInput(in);
+    sep->addOutput(top);
+    in->setMassFlow(10.0);
+    DeviceError code = DeviceError::None;
+    try {
+        fs.evaluate();
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(code == DeviceError::MissingOutput, "EvaluateValidatesWiring - half-connected separator rejected");
+
+    auto bottom = fs.addStream();
+    sep->addOutput(bottom);
+    fs.evaluate();
+    tf.assertDoubleEqual(top->getMassFlow() + bottom->getMassFlow(), 10.0, "EvaluateValidatesWiring - evaluated once wired");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running Flowsheet tests..." << std::endl;
+    std::cout << "==========================" << std::endl;
+
+    testEvaluatesInTopologicalOrder(tf);
+    testOrderCachedUntilRewired(tf);
+    testConvergesRecycle(tf);
+    testThrowsWhenNotConverged(tf);
+    testParallelThrowsWhenNotConverged(tf);
+    testSplitsIntoLevels(tf);
+    testParallelMatchesSerial(tf);
+    testParallelCountsRecycleSweeps(tf);
+    testRecomputesOnlyDownstream(tf);
+    testStopsWhenOutputUnchanged(tf);
+    testRecomputesRecycleLoop(tf);
+    testBatchedMatchesScalar(tf);
+    testWeightedSeparator(tf);
+    testEvaluateValidatesWiring(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
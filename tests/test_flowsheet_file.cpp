@@ -0,0 +1,222 @@
+#define DEVICE_NO_MAIN
+#include "../MappedFlowsheet.cpp"
+#include "TestFramework.cpp"
+
+static const std::string snapshotPath = "test_flowsheet_file.snapshot";
+
+// Рецикл с реактором на выходе: смеситель, сепаратор, реактор
+struct SavedSheet {
+    Flowsheet fs;
+    shared_ptr<Stream> feed, loop, mixed, product, reacted;
+
+    SavedSheet() {
+        feed = fs.addStream();
+        loop = fs.addStream();
+        mixed = fs.addStream();
+        product = fs.addStream();
+        reacted = fs.addStream();
+        auto mix = fs.addDevice<Mixer>(2);
+        auto sep = fs.addDevice<Separator>();
+        auto r = fs.addDevice<Reactor>(false);
+        mix->addInput(feed);
+        mix->addInput(loop);
+        mix->addOutput(mixed);
+        sep->addInput(mixed);
+        sep->addOutput(product);
+        sep->addOutput(loop);
+        r->addInput(product);
+        r->addOutput(reacted);
+        feed->setName("feed");
+        feed->setMassFlow(10.0);
+    }
+};
+
+// Тест 1: снимок сохраняет потоки, имена и состояние
+void testSnapshotKeepsStreams(TestFramework& tf) {
+    SavedSheet sheet;
+    sheet.fs.evaluate();
+    sheet.fs.save(snapshotPath);
+
+    MappedFlowsheet mapped(snapshotPath);
+    tf.assertTrue(mapped.streamCount() == 5 && mapped.deviceCount() == 3, "SnapshotKeepsStreams - counts");
+    tf.assertEqual(mapped.streamName(sheet.feed->getIndex()), std::string("feed"), "SnapshotKeepsStreams - interned name");
+    tf.assertEqual(mapped.streamName(sheet.loop->getIndex()), sheet.loop->getName(), "SnapshotKeepsStreams - generated name");
+    tf.assertDoubleEqual(mapped.flow(sheet.reacted->getIndex()), sheet.reacted->getMassFlow(), "SnapshotKeepsStreams - saved flow");
+}
+
+// Тест 2: отображённый файл вычисляется так же, как исходная схема
+void testMappedEvaluationMatches(TestFramework& tf) {
+    SavedSheet sheet;
+    sheet.fs.save(snapshotPath);
+    sheet.feed->setMassFlow(4.0);
+    sheet.fs.evaluate();
+
+    MappedFlowsheet mapped(snapshotPath);
+    mapped.setFlow(sheet.feed->getIndex(), 4.0);
+    mapped.evaluate();
+
+    bool same = true;
+    for (const auto& s : sheet.fs.getStreams()) same = same && mapped.flow(s->getIndex()) == s->getMassFlow();
+    tf.assertTrue(same, "MappedEvaluationMatches - identical stream values");
+    tf.assertDoubleEqual(mapped.flow(sheet.reacted->getIndex()), 4.0, "MappedEvaluationMatches - mass balance");
+    tf.assertTrue(mapped.getLastRecycleSweeps() == sheet.fs.getLastRecycleSweeps(), "MappedEvaluationMatches - same sweeps");
+}
+
+// Тест 3: компонентные потоки и параметры устройств сохраняются
+void testComponentsRoundTrip(TestFramework& tf) {
+    SavedSheet sheet;
+    sheet.fs.setComponentCount(2);
+    auto r = std::dynamic_pointer_cast<Reactor>(sheet.fs.getDevices()[2]);
+    r->setConversion({0.0, 0.0, 1.0, 1.0}); // всё превращается во второй компонент
+    sheet.feed->setComponents(ComponentVector{6.0, 4.0});
+    sheet.fs.save(snapshotPath);
+    sheet.fs.evaluate();
+
+    MappedFlowsheet mapped(snapshotPath);
+    mapped.evaluate();
+    const double* comps = mapped.componentFlows(sheet.reacted->getIndex());
+    tf.assertDoubleEqual(comps[0], 0.0, "ComponentsRoundTrip - converted away");
+    tf.assertDoubleEqual(comps[1], sheet.reacted->getComponentFlow(1), "ComponentsRoundTrip - converted into");
+}
+
+// Тест 4: повреждённый или чужой файл отвергается
+void testRejectsForeignFile(TestFramework& tf) {
+    {
+        std::ofstream file(snapshotPath, std::ios::binary | std::ios::trunc);
+        file << std::string(256, 'x');
+    }
+    DeviceError code = DeviceError::None;
+    try {
+        MappedFlowsheet mapped(snapshotPath);
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(code == DeviceError::FileFormat, "RejectsForeignFile - bad magic");
+}
+
+// Загрузка снимка, изменённого функцией patch, возвращает код ошибки
+template <class Patch>
+DeviceError loadPatched(Patch patch) {
+    SavedSheet sheet;
+    sheet.fs.save(snapshotPath);
+    std::vector<char> bytes;
+    {
+        std::ifstream file(snapshotPath, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    FlowsheetFileHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    patch(bytes, header);
+    {
+        std::ofstream file(snapshotPath, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), bytes.size());
+    }
+    try {
+        MappedFlowsheet mapped(snapshotPath);
+        mapped.evaluate();
+    } catch (const DeviceException& e) {
+        return e.code();
+    }
+    return DeviceError::None;
+}
+
+// Тест 4а: повреждённые индексы, диапазоны и обрезанный файл отвергаются при загрузке
+void testRejectsCorruptFile(TestFramework& tf) {
+    auto device = [](std::vector<char>& bytes, const FlowsheetFileHeader& h, size_t i) {
+        return reinterpret_cast<FileDevice*>(bytes.data() + h.devices.offset) + i;
+    };
+    tf.assertTrue(loadPatched([](std::vector<char>&, const FlowsheetFileHeader&) {}) == DeviceError::None,
+                  "RejectsCorruptFile - intact file loads");
+    tf.assertTrue(loadPatched([](std::vector<char>& b, const FlowsheetFileHeader& h) {
+                      reinterpret_cast<uint32_t*>(b.data() + h.ports.offset)[0] = 1000;
+                  }) == DeviceError::FileFormat, "RejectsCorruptFile - stream index out of range");
+    tf.assertTrue(loadPatched([&](std::vector<char>& b, const FlowsheetFileHeader& h) {
+                      device(b, h, 0)->portBegin = 0xFFFFFFF0u;
+                  }) == DeviceError::FileFormat, "RejectsCorruptFile - ports out of range");
+    tf.assertTrue(loadPatched([&](std::vector<char>& b, const FlowsheetFileHeader& h) {
+                      device(b, h, 1)->paramCount = 1000;
+                  }) == DeviceError::FileFormat, "RejectsCorruptFile - parameters out of range");
+    tf.assertTrue(loadPatched([&](std::vector<char>& b, const FlowsheetFileHeader& h) {
+                      device(b, h, 1)->outCount = 0;
+                  }) == DeviceError::MissingOutput, "RejectsCorruptFile - separator without outputs");
+    tf.assertTrue(loadPatched([](std::vector<char>& b, const FlowsheetFileHeader& h) {
+                      reinterpret_cast<FileBlock*>(b.data() + h.blocks.offset)[0].end = 1000;
+                  }) == DeviceError::FileFormat, "RejectsCorruptFile - block out of range");
+    tf.assertTrue(loadPatched([](std::vector<char>& b, const FlowsheetFileHeader& h) {
+                      reinterpret_cast<uint32_t*>(b.data() + h.tears.offset)[0] = 1000;
+                  }) == DeviceError::FileFormat, "RejectsCorruptFile - tear stream out of range");
+    tf.assertTrue(loadPatched([](std::vector<char>& b, const FlowsheetFileHeader&) {
+                      b.resize(b.size() / 2);
+                  }) == DeviceError::FileFormat, "RejectsCorruptFile - truncated file");
+}
+
+// Тест 5: снимок отображённой схемы можно сохранить и загрузить снова
+void testResaveMapped(TestFramework& tf) {
+    SavedSheet sheet;
+    sheet.fs.save(snapshotPath);
+    {
+        MappedFlowsheet mapped(snapshotPath);
+        mapped.evaluate();
+        mapped.save(snapshotPath + ".2");
+    }
+    MappedFlowsheet reloaded(snapshotPath + ".2");
+    tf.assertDoubleEqual(reloaded.flow(sheet.reacted->getIndex()), 10.0, "ResaveMapped - evaluated state kept");
+    std::remove((snapshotPath + ".2").c_str());
+}
+
+// Тест 6: доли сепаратора на N выходов сохраняются
+void testWeightedSeparatorRoundTrip(TestFramework& tf) {
+    Flowsheet fs;
+    auto in = fs.addStream();
+    auto sep = fs.addDevice<Separator>(vector<double>{1.0, 3.0, 4.0});
+    sep->addInput(in);
+    for (int j = 0; j < 3; j++) sep->addOutput(fs.addStream());
+    fs.save(snapshotPath);
+    in->setMassFlow(8.0);
+    fs.evaluate();
+
+    MappedFlowsheet mapped(snapshotPath);
+    mapped.setFlow(in->getIndex(), 8.0);
+    mapped.evaluate();
+    bool same = true;
+    for (const auto& s : fs.getStreams()) same = same && mapped.flow(s->getIndex()) == s->getMassFlow();
+    tf.assertTrue(same, "WeightedSeparatorRoundTrip - identical stream values");
+}
+
+// Тест 7: отображённая схема считает общий расход по тем же правилам, что и устройства
+void testMappedComponentTotals(TestFramework& tf) {
+    SavedSheet sheet;
+    sheet.fs.setComponentCount(2);
+    auto sep = std::dynamic_pointer_cast<Separator>(sheet.fs.getDevices()[1]);
+    sep->setComponentSplit({0.5, 0.25});
+    sheet.fs.save(snapshotPath); // в подаче только общий расход
+    sheet.fs.evaluate();
+
+    MappedFlowsheet mapped(snapshotPath);
+    mapped.evaluate();
+    bool same = true;
+    for (const auto& s : sheet.fs.getStreams()) same = same && abs(mapped.flow(s->getIndex()) - s->getMassFlow()) <= 1e-12;
+    tf.assertTrue(same, "MappedComponentTotals - same totals as the devices");
+    tf.assertDoubleEqual(mapped.flow(sheet.reacted->getIndex()), 10.0, "MappedComponentTotals - mass kept", 1e-6);
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running flowsheet file tests..." << std::endl;
+    std::cout << "===============================" << std::endl;
+
+    testSnapshotKeepsStreams(tf);
+    testMappedEvaluationMatches(tf);
+    testComponentsRoundTrip(tf);
+    testRejectsForeignFile(tf);
+    testRejectsCorruptFile(tf);
+    testResaveMapped(tf);
+    testWeightedSeparatorRoundTrip(tf);
+    testMappedComponentTotals(tf);
+    std::remove(snapshotPath.c_str());
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+#define DEVICE_NO_MAIN
+#include "../LinearMassBalance.cpp"
+#include "TestFramework.cpp"
+
+// Схема с двумя вложенными рециклами и реактором
+struct RecycleSheet {
+    Flowsheet fs;
+    shared_ptr<Stream> feed1, feed2, product;
+
+    RecycleSheet() {
+        feed1 = fs.addStream();
+        feed2 = fs.addStream();
+        auto loop1 = fs.addStream();
+        auto loop2 = fs.addStream();
+        auto mixed = fs.addStream();
+        auto top = fs.addStream();
+        auto bottom = fs.addStream();
+        auto joined = fs.addStream();
+        auto reacted = fs.addStream();
+        product = fs.addStream();
+        auto mix = fs.addDevice<Mixer>(3);
+        auto sep1 = fs.addDevice<Separator>();
+        auto join = fs.addDevice<Mixer>(2);
+        auto r = fs.addDevice<Reactor>(false);
+        auto sep2 = fs.addDevice<Separator>();
+        mix->addInput(feed1);
+        mix->addInput(loop1);
+        mix->addInput(loop2);
+        mix->addOutput(mixed);
+        sep1->addInput(mixed);
+        sep1->addOutput(top);
+        sep1->addOutput(loop1);
+        join->addInput(top);
+        join->addInput(feed2);
+        join->addOutput(joined);
+        r->addInput(joined);
+        r->addOutput(reacted);
+        sep2->addInput(reacted);
+        sep2->addOutput(product);
+        sep2->addOutput(loop2);
+    }
+};
+
+bool sameFlows(Flowsheet& expected, Flowsheet& actual, double tolerance) {
+    bool same = true;
+    for (size_t i = 0; i < expected.getStreams().size(); i++) {
+        double a = expected.getStreams()[i]->getMassFlow(), b = actual.getStreams()[i]->getMassFlow();
+        same = same && std::abs(a - b) <= tolerance * std::max(1.0, std::abs(a));
+    }
+    return same;
+}
+
+// Тест 1: прямое решение совпадает со сходящимся рециклом
+void testMatchesRecycleIteration(TestFramework& tf) {
+    RecycleSheet iterated, direct;
+    ConvergenceOptions options;
+    options.tolerance = 1e-13;
+    options.maxIterations = 1000;
+    iterated.fs.setConvergenceOptions(options);
+    for (RecycleSheet* s : {&iterated, &direct}) {
+        s->feed1->setMassFlow(10.0);
+        s->feed2->setMassFlow(4.0);
+    }
+    iterated.fs.evaluate();
+    LinearMassBalance balance(direct.fs);
+    balance.solve();
+    tf.assertTrue(sameFlows(iterated.fs, direct.fs, 1e-9), "MatchesRecycleIteration - same flows");
+    tf.assertEqual(balance.unknownCount(), size_t(7), "MatchesRecycleIteration - one unknown per produced stream");
+    tf.assertDoubleEqual(direct.product->getMassFlow(), 14.0, "MatchesRecycleIteration - mass closes");
+}
+
+// Тест 2: смена питаний не вызывает новой факторизации
+void testFeedChangeReusesFactors(TestFramework& tf) {
+    RecycleSheet s;
+    LinearMassBalance balance(s.fs);
+    s.feed1->setMassFlow(1.0);
+    balance.solve();
+    s.feed1->setMassFlow(7.0);
+    s.feed2->setMassFlow(2.0);
+    balance.solve();
+    tf.assertEqual(balance.factorizationCount(), size_t(1), "FeedChangeReusesFactors - factored once");
+    tf.assertDoubleEqual(s.product->getMassFlow(), 9.0, "FeedChangeReusesFactors - new feeds used");
+}
+
+// Тест 3: перекоммутация вызывает новую факторизацию
+void testRewiringRefactors(TestFramework& tf) {
+    RecycleSheet s;
+    LinearMassBalance balance(s.fs);
+    s.feed1->setMassFlow(3.0);
+    balance.solve();
+    auto half = s.fs.addStream();
+    auto rest = s.fs.addStream();
+    auto sep = s.fs.addDevice<Separator>();
+    sep->addInput(s.product);
+    sep->addOutput(half);
+    sep->addOutput(rest);
+    balance.solve();
+    tf.assertEqual(balance.factorizationCount(), size_t(2), "RewiringRefactors - factored again");
+    tf.assertDoubleEqual(half->getMassFlow(), 1.5, "RewiringRefactors - new device solved");
+}
+
+// Тест 4: замкнутый контур без отвода массы вырожден
+void testClosedLoopIsSingular(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed = fs.addStream();
+    auto loop = fs.addStream();
+    auto mixed = fs.addStream();
+    auto mix = fs.addDevice<Mixer>(2);
+    auto pass = fs.addDevice<Mixer>(1);
+    mix->addInput(feed);
+    mix->addInput(loop);
+    mix->addOutput(mixed);
+    pass->addInput(mixed);
+    pass->addOutput(loop);
+    LinearMassBalance balance(fs);
+    DeviceError code = DeviceError::None;
+    try {
+        balance.solve();
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(code == DeviceError::SingularMatrix, "ClosedLoopIsSingular - singular system rejected");
+}
+
+// Устройство без известного вида: удваивает вход
+class Doubler : public Device {
+public:
+    Doubler() { inputAmount = 1; outputAmount = 1; }
+    void updateOutputs() override { table->setFlow(outputIds[0], 2.0 * table->flow(inputIds[0])); }
+};
+
+// Тест 5: устройства вида Other не линеаризуются
+void testOtherDevicesRejected(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed = fs.addStream();
+    auto doubled = fs.addStream();
+    auto d = fs.addDevice<Doubler>();
+    d->addInput(feed);
+    d->addOutput(doubled);
+    LinearMassBalance balance(fs);
+    DeviceError code = DeviceError::None;
+    try {
+        balance.solve();
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(code == DeviceError::UnsupportedDevice, "OtherDevicesRejected - unknown device rejected");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running linear mass balance tests..." << std::endl;
+    std::cout << "====================================" << std::endl;
+
+    testMatchesRecycleIteration(tf);
+    testFeedChangeReusesFactors(tf);
+    testRewiringRefactors(tf);
+    testClosedLoopIsSingular(tf);
+    testOtherDevicesRejected(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+#define DEVICE_NO_MAIN
+#include "../LiveFlowsheet.cpp"
+#include "TestFramework.cpp"
+
+// Смеситель двух питаний и делитель пополам
+struct SplitSheet {
+    Flowsheet fs;
+    shared_ptr<Stream> feed1, feed2, mixed, top, bottom;
+
+    SplitSheet() {
+        feed1 = fs.addStream();
+        feed2 = fs.addStream();
+        mixed = fs.addStream();
+        top = fs.addStream();
+        bottom = fs.addStream();
+        auto mix = fs.addDevice<Mixer>(2);
+        auto sep = fs.addDevice<Separator>();
+        mix->addInput(feed1);
+        mix->addInput(feed2);
+        mix->addOutput(mixed);
+        sep->addInput(mixed);
+        sep->addOutput(top);
+        sep->addOutput(bottom);
+    }
+};
+
+// Тест 1: почтовый ящик сворачивает значения одного питания в последнее
+void testMailboxKeepsLatest(TestFramework& tf) {
+    FeedMailbox box(3);
+    box.publish(0, 1.0);
+    box.publish(2, 5.0);
+    box.publish(0, 2.0);
+    vector<double> seen(3, -1.0);
+    size_t applied = box.drain([&](size_t f, double m) { seen[f] = m; });
+    tf.assertEqual(applied, size_t(2), "MailboxKeepsLatest - one entry per feed");
+    tf.assertDoubleEqual(seen[0], 2.0, "MailboxKeepsLatest - latest value kept");
+    tf.assertTrue(!box.pending(), "MailboxKeepsLatest - drained");
+}
+
+// Тест 2: значения нескольких писателей доходят до расчёта
+void testConcurrentWritersLand(TestFramework& tf) {
+    SplitSheet s;
+    LiveFlowsheet live(s.fs, {s.feed1, s.feed2});
+    live.start();
+    vector<thread> writers;
+    for (size_t w = 0; w < 2; w++) {
+        writers.emplace_back([&live, w] {
+            for (int k = 1; k <= 5000; k++) live.setFeed(w, k * (w + 1.0));
+        });
+    }
+    for (thread& t : writers) t.join();
+    live.flush();
+    vector<double> flows;
+    uint64_t epoch = live.read(flows);
+    live.stop();
+    tf.assertDoubleEqual(flows[s.mixed->getIndex()], 15000.0, "ConcurrentWritersLand - last values evaluated");
+    tf.assertTrue(epoch >= 1, "ConcurrentWritersLand - snapshots published");
+    tf.assertDoubleEqual(s.top->getMassFlow(), 7500.0, "ConcurrentWritersLand - flowsheet left evaluated");
+}
+
+// Тест 3: читатели всегда видят согласованный снимок
+void testReadersSeeConsistentSnapshots(TestFramework& tf) {
+    SplitSheet s;
+    LiveFlowsheet live(s.fs, {s.feed1, s.feed2});
+    live.start();
+    atomic<bool> done{false};
+    thread writer([&] {
+        for (int k = 0; k < 20000; k++) {
+            live.setFeed(k % 2, k * 0.25);
+        }
+        done.store(true);
+    });
+    bool consistent = true;
+    uint64_t lastEpoch = 0;
+    bool monotonic = true;
+    vector<double> flows;
+    while (!done.load()) {
+        uint64_t epoch = live.read(flows);
+        double f1 = flows[s.feed1->getIndex()], f2 = flows[s.feed2->getIndex()];
+        double m = flows[s.mixed->getIndex()];
+        consistent = consistent && m == f1 + f2 && flows[s.top->getIndex()] == m * 0.5;
+        monotonic = monotonic && epoch >= lastEpoch;
+        lastEpoch = epoch;
+    }
+    writer.join();
+    live.stop();
+    tf.assertTrue(consistent, "ReadersSeeConsistentSnapshots - flows of one sweep");
+    tf.assertTrue(monotonic, "ReadersSeeConsistentSnapshots - epochs never go back");
+}
+
+// Устройство, которое отказывает на большом расходе
+class Fuse : public Device {
+public:
+    Fuse() { inputAmount = 1; outputAmount = 1; }
+    void updateOutputs() override {
+        if (table->flow(inputIds[0]) > 100.0) throw DeviceException(DeviceError::NotConverged);
+        table->setFlow(outputIds[0], table->flow(inputIds[0]));
+    }
+};
+
+// Тест 4: отказ потока расчёта не подвешивает flush() и передаётся вызывающему
+void testFlushReportsSolverFailure(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed = fs.addStream();
+    auto fuse = fs.addDevice<Fuse>();
+    fuse->addInput(feed);
+    fuse->addOutput(fs.addStream());
+    LiveFlowsheet live(fs, {feed});
+    live.start();
+    live.setFeed(0, 1000.0);
+    DeviceError code = DeviceError::None;
+    try {
+        live.flush();
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(code == DeviceError::NotConverged, "FlushReportsSolverFailure - failure rethrown");
+    live.setFeed(0, 2000.0);
+    try {
+        live.flush();
+    } catch (const DeviceException&) {
+    }
+    tf.assertTrue(true, "FlushReportsSolverFailure - later flush returns");
+    bool stopThrew = false;
+    try {
+        live.stop();
+    } catch (const DeviceException&) {
+        stopThrew = true;
+    }
+    tf.assertTrue(stopThrew, "FlushReportsSolverFailure - stop rethrows too");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running live flowsheet tests..." << std::endl;
+    std::cout << "===============================" << std::endl;
+
+    testMailboxKeepsLatest(tf);
+    testConcurrentWritersLand(tf);
+    testReadersSeeConsistentSnapshots(tf);
+    testFlushReportsSolverFailure(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
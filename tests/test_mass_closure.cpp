@@ -0,0 +1,145 @@
+#define DEVICE_NO_MAIN
+#include "../MassClosure.cpp"
+#include "../Tank.cpp"
+#include "TestFramework.cpp"
+
+// Тест 1: смеситель суммирует с компенсацией во всех путях вычисления
+void testCompensatedMixer(TestFramework& tf) {
+    Flowsheet fs;
+    auto big = fs.addStream();
+    auto one = fs.addStream();
+    auto minusBig = fs.addStream();
+    big->setMassFlow(1e16);
+    one->setMassFlow(1.0);
+    minusBig->setMassFlow(-1e16);
+    vector<shared_ptr<Stream>> outs;
+    for (int i = 0; i < 9; i++) { // больше ширины AVX-512, чтобы пройти и векторный путь, и хвост
+        auto mix = fs.addDevice<Mixer>(3);
+        mix->addInput(big);
+        mix->addInput(one);
+        mix->addInput(minusBig);
+        outs.push_back(fs.addStream());
+        mix->addOutput(outs.back());
+    }
+
+    fs.evaluate();
+    tf.assertDoubleEqual(outs[0]->getMassFlow(), 1.0, "CompensatedMixer - scalar device keeps the small input");
+
+    SimdLevel saved = batch_kernels::activeSimdLevel();
+    vector<SimdLevel> levels{SimdLevel::Scalar};
+    if (__builtin_cpu_supports("avx2")) levels.push_back(SimdLevel::Avx2);
+    if (__builtin_cpu_supports("avx512f")) levels.push_back(SimdLevel::Avx512);
+    bool same = true;
+    for (SimdLevel level : levels) {
+        batch_kernels::activeSimdLevel() = level;
+        for (auto& s : outs) s->setMassFlow(0.0);
+        fs.evaluateBatched();
+        for (auto& s : outs) same = same && s->getMassFlow() == 1.0;
+    }
+    batch_kernels::activeSimdLevel() = saved;
+    tf.assertTrue(same, "CompensatedMixer - batched kernels agree at every SIMD level");
+}
+
+// Тест 2: параллельная сумма не зависит от числа потоков и точна
+void testReproducibleSum(TestFramework& tf) {
+    size_t n = 100000;
+    auto value = [](size_t i) { return (i % 3 == 0 ? 1e12 : -1e12 / 2.0) + 1.0 / double(i + 1); };
+    double serial = reproducibleSum(n, value);
+    ThreadPool two(1), four(3);
+    double a = reproducibleSum(n, value, &two), b = reproducibleSum(n, value, &four);
+    tf.assertTrue(serial == a && serial == b, "ReproducibleSum - same bits for any pool");
+
+    auto cancelling = [](size_t i) { return i % 3 == 0 ? 1e16 : (i % 3 == 1 ? 1.0 : -1e16); };
+    tf.assertDoubleEqual(reproducibleSum(3000, cancelling, &four), 1000.0, "ReproducibleSum - compensated");
+}
+
+// Устройство без известного вида: удваивает вход, нарушая баланс
+class Doubler : public Device {
+public:
+    Doubler() { inputAmount = 1; outputAmount = 1; }
+    void updateOutputs() override { table->setFlow(outputIds[0], 2.0 * table->flow(inputIds[0])); }
+};
+
+// Тест 3: аудит находит худшие устройства
+void testAuditFindsOffenders(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed = fs.addStream();
+    auto mixed = fs.addStream();
+    auto top = fs.addStream();
+    auto bottom = fs.addStream();
+    auto doubled = fs.addStream();
+    auto mix = fs.addDevice<Mixer>(1);
+    auto sep = fs.addDevice<Separator>(vector<double>{1.0, 2.0});
+    auto d = fs.addDevice<Doubler>();
+    mix->addInput(feed);
+    mix->addOutput(mixed);
+    sep->addInput(mixed);
+    sep->addOutput(top);
+    sep->addOutput(bottom);
+    d->addInput(bottom);
+    d->addOutput(doubled);
+    feed->setMassFlow(9.0);
+    fs.evaluate();
+
+    MassClosureAudit audit(fs);
+    ClosureReport report = audit.run(2);
+    tf.assertEqual(report.devicesChecked, size_t(3), "AuditFindsOffenders - every device checked");
+    tf.assertEqual(report.worst.size(), size_t(2), "AuditFindsOffenders - requested number of offenders");
+    tf.assertTrue(report.worst[0].device == d.get(), "AuditFindsOffenders - doubler is the worst");
+    tf.assertDoubleEqual(report.worst[0].relative, 0.5, "AuditFindsOffenders - relative imbalance");
+    tf.assertDoubleEqual(report.worst[0].imbalance, -6.0, "AuditFindsOffenders - imbalance");
+    tf.assertDoubleEqual(report.feedFlow, 9.0, "AuditFindsOffenders - feeds");
+    tf.assertDoubleEqual(report.productFlow, 15.0, "AuditFindsOffenders - products");
+    tf.assertTrue(!report.closed(1e-12), "AuditFindsOffenders - not closed");
+}
+
+// Тест 4: баланс схемы без нарушителей сходится, отчёт одинаков при любом числе потоков
+void testAuditClosedAndReproducible(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed = fs.addStream();
+    feed->setMassFlow(1.0 / 3.0);
+    shared_ptr<Stream> current = feed;
+    for (int i = 0; i < 3000; i++) {
+        auto sep = fs.addDevice<Separator>(vector<double>{1.0, 2.0, 4.0});
+        sep->addInput(current);
+        auto mix = fs.addDevice<Mixer>(3);
+        for (int j = 0; j < 3; j++) {
+            auto s = fs.addStream();
+            sep->addOutput(s);
+            mix->addInput(s);
+        }
+        current = fs.addStream();
+        mix->addOutput(current);
+    }
+    auto tank = fs.addDevice<Tank>(1, 1.0);
+    tank->addInput(current);
+    tank->addOutput(fs.addStream());
+    fs.evaluate();
+
+    MassClosureAudit audit(fs);
+    ThreadPool pool(3);
+    ClosureReport serial = audit.run(5), parallel = audit.run(5, &pool);
+    tf.assertEqual(serial.devicesChecked, size_t(6000), "AuditClosedAndReproducible - tank skipped");
+    tf.assertTrue(serial.maxRelative < 1e-15, "AuditClosedAndReproducible - devices close");
+    bool same = serial.maxRelative == parallel.maxRelative && serial.worst.size() == parallel.worst.size();
+    for (size_t i = 0; i < serial.worst.size() && same; i++) {
+        same = serial.worst[i].device == parallel.worst[i].device && serial.worst[i].imbalance == parallel.worst[i].imbalance;
+    }
+    tf.assertTrue(same, "AuditClosedAndReproducible - same report with a pool");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running mass closure tests..." << std::endl;
+    std::cout << "=============================" << std::endl;
+
+    testCompensatedMixer(tf);
+    testReproducibleSum(tf);
+    testAuditFindsOffenders(tf);
+    testAuditClosedAndReproducible(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
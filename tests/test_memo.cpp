@@ -0,0 +1,106 @@
+#define DEVICE_NO_MAIN
+#include "../Flowsheet.cpp"
+#include "TestFramework.cpp"
+
+// Дорогая модель: считает свои вызовы
+class CountingHeater : public Device {
+public:
+    int calls = 0;
+    CountingHeater() { inputAmount = 1; outputAmount = 1; }
+    void updateOutputs() override {
+        calls++;
+        table->setFlow(outputIds[0], 3.0 * table->flow(inputIds[0]));
+    }
+};
+
+struct HeaterSheet {
+    Flowsheet fs;
+    shared_ptr<Stream> feed, out;
+    shared_ptr<CountingHeater> heater;
+
+    HeaterSheet() {
+        feed = fs.addStream();
+        out = fs.addStream();
+        heater = fs.addDevice<CountingHeater>();
+        heater->addInput(feed);
+        heater->addOutput(out);
+    }
+};
+
+// Тест 1: повторные входы берутся из кэша
+void testRepeatedInputsHit(TestFramework& tf) {
+    HeaterSheet s;
+    s.heater->enableMemo(8);
+    for (double m : {1.0, 2.0, 1.0, 2.0, 1.0}) {
+        s.feed->setMassFlow(m);
+        s.fs.evaluate();
+    }
+    tf.assertEqual(s.heater->calls, 2, "RepeatedInputsHit - computed once per input");
+    tf.assertDoubleEqual(s.out->getMassFlow(), 3.0, "RepeatedInputsHit - cached output written");
+    tf.assertDoubleEqual(s.heater->getMemo()->hitRate(), 0.6, "RepeatedInputsHit - hit rate");
+}
+
+// Тест 2: входы в пределах кванта считаются одинаковыми
+void testQuantizedKey(TestFramework& tf) {
+    HeaterSheet s;
+    s.heater->enableMemo(8, 1e-3);
+    s.feed->setMassFlow(5.0);
+    s.fs.evaluate();
+    s.feed->setMassFlow(5.0 + 2e-4);
+    s.fs.evaluate();
+    tf.assertEqual(s.heater->calls, 1, "QuantizedKey - near input reused");
+    s.feed->setMassFlow(5.0 + 2e-3);
+    s.fs.evaluate();
+    tf.assertEqual(s.heater->calls, 2, "QuantizedKey - moved input recomputed");
+}
+
+// Тест 3: вытесняется давно не использованный результат
+void testLeastRecentlyUsedEvicted(TestFramework& tf) {
+    HeaterSheet s;
+    s.heater->enableMemo(2);
+    for (double m : {1.0, 2.0, 1.0, 3.0, 1.0, 2.0}) {
+        s.feed->setMassFlow(m);
+        s.fs.evaluate();
+    }
+    // 1 и 2 в кэше, 1 снова, 3 вытесняет 2, 1 попадание, 2 вычисляется заново
+    tf.assertEqual(s.heater->calls, 4, "LeastRecentlyUsedEvicted - calls");
+    tf.assertEqual(s.heater->getMemo()->evictions(), size_t(2), "LeastRecentlyUsedEvicted - evictions");
+    tf.assertEqual(s.heater->getMemo()->size(), size_t(2), "LeastRecentlyUsedEvicted - bounded");
+}
+
+// Тест 4: смена параметров реактора очищает кэш
+void testParameterChangeClears(TestFramework& tf) {
+    Flowsheet fs;
+    fs.setComponentCount(2);
+    auto in = fs.addStream();
+    auto out = fs.addStream();
+    auto r = fs.addDevice<Reactor>(false);
+    r->addInput(in);
+    r->addOutput(out);
+    r->enableMemo(4);
+    in->setComponents({1.0, 3.0});
+    fs.evaluate();
+    r->setConversion({0.0, 0.0, 1.0, 1.0});
+    fs.evaluate();
+    tf.assertDoubleEqual(out->getComponentFlow(1), 4.0, "ParameterChangeClears - new conversion applied");
+    tf.assertEqual(r->getMemo()->hits(), size_t(0), "ParameterChangeClears - no stale hit");
+    fs.evaluate();
+    tf.assertDoubleEqual(out->getComponentFlow(0), 0.0, "ParameterChangeClears - cached components written");
+    tf.assertEqual(r->getMemo()->hits(), size_t(1), "ParameterChangeClears - hit afterwards");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running device memo tests..." << std::endl;
+    std::cout << "============================" << std::endl;
+
+    testRepeatedInputsHit(tf);
+    testQuantizedKey(tf);
+    testLeastRecentlyUsedEvicted(tf);
+    testParameterChangeClears(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
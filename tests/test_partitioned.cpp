@@ -0,0 +1,144 @@
+#define DEVICE_NO_MAIN
+#include "../PartitionedFlowsheet.cpp"
+#include "TestFramework.cpp"
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Несколько цепочек смеситель-сепаратор с перекрёстными связями и рециклами
+void buildChains(Flowsheet& fs, int chains, int length, bool recycles) {
+    vector<shared_ptr<Stream>> heads;
+    for (int c = 0; c < chains; c++) {
+        auto s = fs.addStream();
+        s->setMassFlow(1.0 + c);
+        heads.push_back(s);
+    }
+    for (int k = 0; k < length; k++) {
+        for (int c = 0; c < chains; c++) {
+            auto side = fs.addStream();
+            auto loop = fs.addStream();
+            auto mixed = fs.addStream();
+            auto next = fs.addStream();
+            auto mix = fs.addDevice<Mixer>(recycles ? 2 : 1);
+            auto sep = fs.addDevice<Separator>(vector<double>{3.0, 1.0, recycles ? 1.0 : 0.0});
+            mix->addInput(heads[c]);
+            if (recycles) mix->addInput(loop);
+            mix->addOutput(mixed);
+            sep->addInput(mixed);
+            sep->addOutput(next);
+            sep->addOutput(side);
+            sep->addOutput(loop);
+            heads[c] = next;
+            // Боковой поток соседней цепочки уходит в её следующий смеситель
+            if (k % 4 == 3 && c + 1 < chains) {
+                auto join = fs.addDevice<Mixer>(2);
+                auto joined = fs.addStream();
+                join->addInput(side);
+                join->addInput(heads[c + 1]);
+                join->addOutput(joined);
+                heads[c + 1] = joined;
+            }
+        }
+    }
+}
+
+bool sameFlows(Flowsheet& a, Flowsheet& b, double tolerance) {
+    bool same = true;
+    for (size_t i = 0; i < a.getStreams().size(); i++) {
+        double x = a.getStreams()[i]->getMassFlow(), y = b.getStreams()[i]->getMassFlow();
+        same = same && std::abs(x - y) <= tolerance * std::max(1.0, std::abs(x));
+    }
+    return same;
+}
+
+// Тест 1: без рециклов разбиение даёт те же значения, что и последовательный расчёт
+void testMatchesSerialEvaluation(TestFramework& tf) {
+    Flowsheet serial, split;
+    buildChains(serial, 4, 20, false);
+    buildChains(split, 4, 20, false);
+    serial.evaluate();
+    PartitionedFlowsheet parts(split, 4);
+    parts.evaluate();
+    tf.assertTrue(sameFlows(serial, split, 0.0), "MatchesSerialEvaluation - identical stream values");
+    tf.assertTrue(parts.getPartitioning().cutStreamCount() > 0, "MatchesSerialEvaluation - some streams cut");
+    tf.assertTrue(parts.getLastRounds() >= 2, "MatchesSerialEvaluation - boundary exchanged");
+}
+
+// Тест 2: рециклы внутри разделов сходятся как при последовательном расчёте
+void testRecyclesConverge(TestFramework& tf) {
+    Flowsheet serial, split;
+    ConvergenceOptions options;
+    options.tolerance = 1e-12;
+    serial.setConvergenceOptions(options);
+    split.setConvergenceOptions(options);
+    buildChains(serial, 3, 12, true);
+    buildChains(split, 3, 12, true);
+    serial.evaluate();
+    PartitionedFlowsheet parts(split, 3);
+    parts.evaluate();
+    tf.assertTrue(sameFlows(serial, split, 1e-9), "RecyclesConverge - same stream values");
+    tf.assertTrue(parts.getLastRecycleSweeps() > 0, "RecyclesConverge - local recycle sweeps");
+
+    split.getStreams()[0]->setMassFlow(10.0);
+    serial.getStreams()[0]->setMassFlow(10.0);
+    serial.evaluate();
+    parts.evaluate();
+    tf.assertTrue(sameFlows(serial, split, 1e-9), "RecyclesConverge - same values after a feed change");
+}
+
+// Тест 3: независимые цепочки разбиваются без разрезов и поровну
+void testBalancedWithoutCuts(TestFramework& tf) {
+    Flowsheet fs;
+    for (int c = 0; c < 4; c++) {
+        auto s = fs.addStream();
+        for (int k = 0; k < 10; k++) {
+            auto next = fs.addStream();
+            auto mix = fs.addDevice<Mixer>(1);
+            mix->addInput(s);
+            mix->addOutput(next);
+            s = next;
+        }
+    }
+    Partitioning p(fs, 4);
+    tf.assertEqual(p.cutStreamCount(), size_t(0), "BalancedWithoutCuts - no cut stream");
+    bool balanced = true;
+    for (size_t i = 0; i < p.partCount(); i++) balanced = balanced && p.weight(i) == 10;
+    tf.assertTrue(balanced, "BalancedWithoutCuts - equal weights");
+}
+
+// Тест 4: кольцо в разделяемой памяти работает между процессами
+void testRingAcrossProcesses(TestFramework& tf) {
+    SharedRing ring(8);
+    pid_t child = fork();
+    if (child == 0) {
+        for (int k = 0; k < 100; k++) {
+            double v[3] = {double(k), k + 0.5, -double(k)};
+            ring.push(v, 3);
+        }
+        _exit(0);
+    }
+    bool ordered = true;
+    for (int k = 0; k < 100; k++) {
+        double v[3];
+        ring.pop(v, 3);
+        ordered = ordered && v[0] == k && v[1] == k + 0.5 && v[2] == -k;
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    tf.assertTrue(ordered && WIFEXITED(status), "RingAcrossProcesses - values in order");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running partitioned flowsheet tests..." << std::endl;
+    std::cout << "======================================" << std::endl;
+
+    testMatchesSerialEvaluation(tf);
+    testRecyclesConverge(tf);
+    testBalancedWithoutCuts(tf);
+    testRingAcrossProcesses(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
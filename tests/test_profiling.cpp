@@ -0,0 +1,150 @@
+#define DEVICE_NO_MAIN
+#define DEVICE_PROFILING
+#include "../Flowsheet.cpp"
+#include "TestFramework.cpp"
+#include <sstream>
+
+// Смеситель и сепаратор в рецикле, за ними реактор
+struct ProfiledSheet {
+    Flowsheet fs;
+    shared_ptr<Stream> feed, loop, mixed, product, reacted;
+    shared_ptr<Mixer> mix;
+    shared_ptr<Reactor> reactor;
+
+    ProfiledSheet() {
+        feed = fs.addStream();
+        loop = fs.addStream();
+        mixed = fs.addStream();
+        product = fs.addStream();
+        reacted = fs.addStream();
+        mix = fs.addDevice<Mixer>(2);
+        auto sep = fs.addDevice<Separator>();
+        reactor = fs.addDevice<Reactor>(false);
+        mix->addInput(feed);
+        mix->addInput(loop);
+        mix->addOutput(mixed);
+        sep->addInput(mixed);
+        sep->addOutput(product);
+        sep->addOutput(loop);
+        reactor->addInput(product);
+        reactor->addOutput(reacted);
+        feed->setMassFlow(10.0);
+    }
+};
+
+// Тест 1: считаются вызовы по устройствам, по типам и итерации рецикла
+void testCountsCallsAndSweeps(TestFramework& tf) {
+    Profiler::global().reset();
+    ProfiledSheet sheet;
+    sheet.fs.evaluate();
+    sheet.fs.evaluate();
+    int sweeps = sheet.fs.getLastRecycleSweeps();
+
+    const Profiler::UnitStats* r = Profiler::global().unitStats(sheet.reactor->getProfileId());
+    const Profiler::UnitStats* m = Profiler::global().unitStats(sheet.mix->getProfileId());
+    tf.assertTrue(r && r->stats.calls == 2, "CountsCallsAndSweeps - reactor called once per sweep");
+    tf.assertTrue(m && m->stats.calls > 2, "CountsCallsAndSweeps - mixer called by every recycle sweep");
+    tf.assertEqual(r->type, std::string("Reactor"), "CountsCallsAndSweeps - type name");
+    tf.assertTrue(Profiler::global().typeStats()["Mixer"].calls == m->stats.calls, "CountsCallsAndSweeps - per-type count");
+    tf.assertTrue(Profiler::global().recycleLoopStats().calls == 2, "CountsCallsAndSweeps - recycle solves");
+    tf.assertTrue(Profiler::global().maxSweepsPerLoop() >= sweeps && sweeps > 0, "CountsCallsAndSweeps - sweeps recorded");
+}
+
+// Тест 2: процентили упорядочены и ограничены максимумом
+void testPercentiles(TestFramework& tf) {
+    ProfileStats s;
+    for (uint64_t ns = 1; ns <= 1000; ns++) s.add(ns);
+    uint64_t p50 = s.percentileNs(0.5), p99 = s.percentileNs(0.99);
+    tf.assertTrue(p50 >= 400 && p50 <= 640, "Percentiles - median within a bucket");
+    tf.assertTrue(p50 <= p99 && p99 <= s.maxNs, "Percentiles - ordered");
+}
+
+// Тест 3: экспорт в формат Chrome trace и плоский профиль
+void testExports(TestFramework& tf) {
+    Profiler::global().reset();
+    ProfiledSheet sheet;
+    sheet.fs.evaluateBatched();
+
+    std::ostringstream trace, flat;
+    Profiler::global().writeChromeTrace(trace);
+    Profiler::global().writeFlatProfile(flat);
+    tf.assertTrue(trace.str().find("{\"traceEvents\":[") == 0, "Exports - trace header");
+    tf.assertTrue(trace.str().find("\"cat\":\"batch\"") != std::string::npos, "Exports - batch event");
+    tf.assertTrue(trace.str().find("\"args\":{\"sweeps\":") != std::string::npos, "Exports - recycle sweeps");
+    tf.assertTrue(flat.str().find("batch Reactor") != std::string::npos, "Exports - flat profile lists types");
+    tf.assertTrue(flat.str().find("recycle loops: 1 solves") != std::string::npos, "Exports - flat profile recycle summary");
+}
+
+// Тест 4: кольцевой буфер трассы хранит последние события
+void testTraceIsBounded(TestFramework& tf) {
+    Profiler::global().reset();
+    Profiler::global().setTraceCapacity(4);
+    ProfiledSheet sheet;
+    for (int i = 0; i < 10; i++) sheet.fs.evaluate();
+    std::ostringstream trace;
+    Profiler::global().writeChromeTrace(trace);
+    size_t events = 0;
+    for (size_t at = trace.str().find("\"ph\""); at != std::string::npos; at = trace.str().find("\"ph\"", at + 1)) events++;
+    tf.assertTrue(events == 4, "TraceIsBounded - capacity kept");
+    tf.assertTrue(trace.str().find("Reactor") != std::string::npos, "TraceIsBounded - latest events kept");
+    Profiler::global().setTraceCapacity(1 << 20);
+}
+
+// Тест 5: новое устройство получает свою статистику, даже если занимает адрес удалённого
+void testUnitsKeyedById(TestFramework& tf) {
+    Profiler::global().reset();
+    StreamTable table;
+    auto in = std::make_shared<Stream>(table, 1);
+    auto out = std::make_shared<Stream>(table, 2);
+    uint64_t first;
+    {
+        auto r = std::make_unique<Reactor>(false);
+        r->addInput(in);
+        r->addOutput(out);
+        for (int i = 0; i < 3; i++) r->update();
+        first = r->getProfileId();
+    }
+    auto r = std::make_unique<Reactor>(false);
+    r->addInput(in);
+    r->addOutput(out);
+    r->update();
+    const Profiler::UnitStats* s = Profiler::global().unitStats(r->getProfileId());
+    tf.assertTrue(r->getProfileId() != first, "UnitsKeyedById - new id");
+    tf.assertTrue(s && s->stats.calls == 1, "UnitsKeyedById - own statistics");
+    tf.assertTrue(Profiler::global().unitStats(first)->stats.calls == 3, "UnitsKeyedById - old statistics kept");
+}
+
+// Тест 6: вызовы с нескольких потоков собираются при чтении
+void testParallelCallsMerged(TestFramework& tf) {
+    Profiler::global().reset();
+    Flowsheet fs;
+    const int units = 64;
+    for (int i = 0; i < units; i++) {
+        auto r = fs.addDevice<Reactor>(false);
+        r->addInput(fs.addStream());
+        r->addOutput(fs.addStream());
+    }
+    ThreadPool pool(4);
+    for (int i = 0; i < 3; i++) fs.evaluateParallel(pool, 1);
+    tf.assertTrue(Profiler::global().typeStats()["Reactor"].calls == 3 * units, "ParallelCallsMerged - every call counted");
+    const Profiler::UnitStats* s = Profiler::global().unitStats(fs.getDevices()[0]->getProfileId());
+    tf.assertTrue(s && s->stats.calls == 3, "ParallelCallsMerged - per unit over threads");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running profiling tests..." << std::endl;
+    std::cout << "==========================" << std::endl;
+
+    testCountsCallsAndSweeps(tf);
+    testPercentiles(tf);
+    testExports(tf);
+    testTraceIsBounded(tf);
+    testUnitsKeyedById(tf);
+    testParallelCallsMerged(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+#define DEVICE_NO_MAIN
+#include "../ScenarioBatch.cpp"
+#include "TestFramework.cpp"
+
+// Тест 1: каждая дорожка совпадает со скалярным расчётом тех же питаний
+void testLanesMatchScalar(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed1 = fs.addStream();
+    auto feed2 = fs.addStream();
+    auto mixed = fs.addStream();
+    auto top = fs.addStream();
+    auto bottom = fs.addStream();
+    auto reacted = fs.addStream();
+    auto mix = fs.addDevice<Mixer>(2);
+    auto sep = fs.addDevice<Separator>();
+    auto r = fs.addDevice<Reactor>(false);
+    mix->addInput(feed1);
+    mix->addInput(feed2);
+    mix->addOutput(mixed);
+    sep->addInput(mixed);
+    sep->addOutput(top);
+    sep->addOutput(bottom);
+    r->addInput(bottom);
+    r->addOutput(reacted);
+
+    const size_t lanes = 37;
+    ScenarioBatch batch(fs, lanes);
+    for (size_t k = 0; k < lanes; k++) {
+        batch.lane(*feed1)[k] = 0.1 * k;
+        batch.lane(*feed2)[k] = 3.0 / (k + 1);
+    }
+    batch.evaluate();
+
+    bool same = true;
+    for (size_t k = 0; k < lanes; k++) {
+        feed1->setMassFlow(0.1 * k);
+        feed2->setMassFlow(3.0 / (k + 1));
+        fs.evaluate();
+        for (const auto& s : fs.getStreams()) same = same && batch.lane(*s)[k] == s->getMassFlow();
+    }
+    tf.assertTrue(same, "LanesMatchScalar - identical values in every lane");
+}
+
+// Тест 2: рецикл сходится во всех дорожках сразу
+void testRecycleConvergesEveryLane(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed = fs.addStream();
+    auto loop = fs.addStream();
+    auto mixed = fs.addStream();
+    auto product = fs.addStream();
+    auto mix = fs.addDevice<Mixer>(2);
+    auto sep = fs.addDevice<Separator>();
+    mix->addInput(feed);
+    mix->addInput(loop);
+    mix->addOutput(mixed);
+    sep->addInput(mixed);
+    sep->addOutput(product);
+    sep->addOutput(loop);
+
+    ConvergenceOptions options;
+    options.method = ConvergenceOptions::Broyden; // заменяется на Вегштейна
+    fs.setConvergenceOptions(options);
+    ScenarioBatch batch(fs, 8);
+    for (size_t k = 0; k < 8; k++) batch.lane(*feed)[k] = 1.0 + k;
+    batch.evaluate();
+
+    bool converged = true;
+    for (size_t k = 0; k < 8; k++) {
+        converged = converged && std::abs(batch.lane(*product)[k] - (1.0 + k)) < 1e-8;
+        converged = converged && std::abs(batch.lane(*loop)[k] - (1.0 + k)) < 1e-8;
+    }
+    tf.assertTrue(converged, "RecycleConvergesEveryLane - product equals feed");
+    tf.assertTrue(batch.getLastRecycleSweeps() > 0, "RecycleConvergesEveryLane - sweeps counted");
+}
+
+// Устройство без известного вида: удваивает вход
+class Doubler : public Device {
+public:
+    Doubler() { inputAmount = 1; outputAmount = 1; }
+    void updateOutputs() override { table->setFlow(outputIds[0], 2.0 * table->flow(inputIds[0])); }
+};
+
+// Тест 3: устройства вида Other считаются по дорожкам через updateOutputs()
+void testOtherDevicesRunPerLane(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed = fs.addStream();
+    auto doubled = fs.addStream();
+    auto d = fs.addDevice<Doubler>();
+    d->addInput(feed);
+    d->addOutput(doubled);
+
+    ScenarioBatch batch(fs, 3);
+    batch.fillLane(*feed, 2.0);
+    batch.lane(*feed)[2] = 5.0;
+    batch.evaluate();
+    tf.assertDoubleEqual(batch.lane(*doubled)[0], 4.0, "OtherDevicesRunPerLane - lane 0");
+    tf.assertDoubleEqual(batch.lane(*doubled)[2], 10.0, "OtherDevicesRunPerLane - lane 2");
+}
+
+// Тест 4: компоненты, включённые после первого расчёта, тоже отвергаются
+void testComponentsEnabledLater(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed = fs.addStream();
+    auto out = fs.addStream();
+    auto mix = fs.addDevice<Mixer>(1);
+    mix->addInput(feed);
+    mix->addOutput(out);
+
+    ScenarioBatch batch(fs, 2);
+    batch.fillLane(*feed, 1.0);
+    batch.evaluate();
+    fs.setComponentCount(2);
+    DeviceError code = DeviceError::None;
+    try {
+        batch.evaluate();
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(code == DeviceError::UnsupportedComponents, "ComponentsEnabledLater - rejected");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running scenario batch tests..." << std::endl;
+    std::cout << "===============================" << std::endl;
+
+    testLanesMatchScalar(tf);
+    testRecycleConvergesEveryLane(tf);
+    testOtherDevicesRunPerLane(tf);
+    testComponentsEnabledLater(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
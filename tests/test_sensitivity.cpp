@@ -0,0 +1,137 @@
+#define DEVICE_NO_MAIN
+#include "../Sensitivity.cpp"
+#include "TestFramework.cpp"
+
+// Тест 1: арифметика дуальных чисел
+void testDualArithmetic(TestFramework& tf) {
+    Dual<2> x = Dual<2>::parameter(3.0, 0), y = Dual<2>::parameter(2.0, 1);
+    Dual<2> z = (x * y + x) / y;  // z = x + x / y
+    tf.assertDoubleEqual(z.value, 4.5, "DualArithmetic - value");
+    tf.assertDoubleEqual(z.d[0], 1.5, "DualArithmetic - dz/dx = 1 + 1 / y");
+    tf.assertDoubleEqual(z.d[1], -0.75, "DualArithmetic - dz/dy = -x / y^2");
+}
+
+// Тест 2: производные делителя по питанию и по весам выходов
+void testSeparatorDerivatives(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed = fs.addStream();
+    auto top = fs.addStream();
+    auto bottom = fs.addStream();
+    auto sep = fs.addDevice<Separator>(vector<double>{3.0, 1.0});
+    sep->addInput(feed);
+    sep->addOutput(top);
+    sep->addOutput(bottom);
+    feed->setMassFlow(8.0);
+
+    Sensitivity<3> s(fs);
+    size_t pFeed = s.addFeed(*feed);
+    size_t pTop = s.addSplitWeight(*sep, 0);
+    size_t pBottom = s.addSplitWeight(*sep, 1);
+    s.evaluate();
+    tf.assertDoubleEqual(s.value(*top), 6.0, "SeparatorDerivatives - value");
+    tf.assertDoubleEqual(s.derivative(*top, pFeed), 0.75, "SeparatorDerivatives - by the feed");
+    tf.assertDoubleEqual(s.derivative(*top, pTop), 2.0, "SeparatorDerivatives - by its own weight");
+    tf.assertDoubleEqual(s.derivative(*top, pBottom), -6.0, "SeparatorDerivatives - by the other weight");
+    tf.assertDoubleEqual(s.derivative(*top, pTop) + s.derivative(*bottom, pTop), 0.0, "SeparatorDerivatives - mass is conserved");
+}
+
+// Схема с рециклом: питание -> смеситель -> реактор -> делитель, вторая доля возвращается
+struct RecycleSheet {
+    Flowsheet fs;
+    shared_ptr<Stream> feed, loop, product;
+    shared_ptr<Separator> sep;
+
+    RecycleSheet(double loopFraction) {
+        feed = fs.addStream();
+        loop = fs.addStream();
+        auto mixed = fs.addStream();
+        auto reacted = fs.addStream();
+        product = fs.addStream();
+        auto mix = fs.addDevice<Mixer>(2);
+        auto r = fs.addDevice<Reactor>(false);
+        sep = fs.addDevice<Separator>(vector<double>{1.0 - loopFraction, loopFraction});
+        mix->addInput(feed);
+        mix->addInput(loop);
+        mix->addOutput(mixed);
+        r->addInput(mixed);
+        r->addOutput(reacted);
+        sep->addInput(reacted);
+        sep->addOutput(product);
+        sep->addOutput(loop);
+        feed->setMassFlow(10.0);
+        ConvergenceOptions options;
+        options.tolerance = 1e-13;
+        options.maxIterations = 1000;
+        fs.setConvergenceOptions(options);
+    }
+};
+
+// Тест 3: производная через рецикл совпадает с аналитической и с конечной разностью
+void testRecycleDerivative(TestFramework& tf) {
+    RecycleSheet s(0.5);
+    Sensitivity<1> sens(s.fs);
+    size_t p = sens.addSplitWeight(*s.sep, 1);
+    sens.evaluate();
+    // loop = F f / (1 - f), df/dw = 1 - f: dloop/dw = F / (1 - f)
+    tf.assertTrue(std::abs(sens.derivative(*s.loop, p) - 20.0) < 1e-8, "RecycleDerivative - analytic");
+    tf.assertTrue(std::abs(sens.derivative(*s.product, p)) < 1e-8, "RecycleDerivative - product fixed by the feed");
+
+    double h = 1e-6;
+    RecycleSheet plus(0.5), minus(0.5);
+    plus.sep->setSplit({0.5, 0.5 + h});
+    minus.sep->setSplit({0.5, 0.5 - h});
+    plus.fs.evaluate();
+    minus.fs.evaluate();
+    double fd = (plus.loop->getMassFlow() - minus.loop->getMassFlow()) / (2 * h);
+    tf.assertTrue(std::abs(sens.derivative(*s.loop, p) - fd) < 1e-4, "RecycleDerivative - finite difference");
+    tf.assertTrue(sens.getLastRecycleSweeps() > 1, "RecycleDerivative - loop iterated");
+}
+
+// Устройство без известного вида: удваивает вход
+class Doubler : public Device {
+public:
+    Doubler() { inputAmount = 1; outputAmount = 1; }
+    void updateOutputs() override { table->setFlow(outputIds[0], 2.0 * table->flow(inputIds[0])); }
+};
+
+// Тест 4: недифференцируемые устройства и лишние параметры отклоняются
+void testRejected(TestFramework& tf) {
+    Flowsheet fs;
+    auto feed = fs.addStream();
+    auto out = fs.addStream();
+    auto d = fs.addDevice<Doubler>();
+    d->addInput(feed);
+    d->addOutput(out);
+    Sensitivity<1> s(fs);
+    s.addFeed(*feed);
+    DeviceError code = DeviceError::None;
+    try {
+        s.evaluate();
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(code == DeviceError::UnsupportedDevice, "Rejected - other device");
+    code = DeviceError::None;
+    try {
+        s.addFeed(*out);
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(code == DeviceError::TooManyParameters, "Rejected - more parameters than N");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running sensitivity tests..." << std::endl;
+    std::cout << "============================" << std::endl;
+
+    testDualArithmetic(tf);
+    testSeparatorDerivatives(tf);
+    testRecycleDerivative(tf);
+    testRejected(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
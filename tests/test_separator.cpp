@@ -3,6 +3,7 @@
 #include <memory>
 #include <cmath>
 #include <stdexcept>
+#include "TestFramework.cpp"
 
 // Объявляем классы прямо здесь (без включения device.cpp)
 class Stream {
@@ -48,69 +49,6 @@ public:
     }
 };
 
-class TestFramework {
-private:
-    std::vector<std::pair<std::string, bool>> testResults;
-    int passed = 0;
-    int failed = 0;
-
-public:
-    void assertTrue(bool condition, const std::string& testName) {
-        testResults.emplace_back(testName, condition);
-        if (condition) {
-            passed++;
-            std::cout << "PASS: " << testName << std::endl;
-        } else {
-            failed++;
-            std::cout << "FAIL: " << testName << std::endl;
-        }
-    }
-
-    template<typename T>
-    void assertEqual(const T& actual, const T& expected, const std::string& testName) {
-        bool condition = (actual == expected);
-        testResults.emplace_back(testName, condition);
-        if (condition) {
-            passed++;
-            std::cout << "PASS: " << testName << " (expected: " << expected << ", actual: " << actual << ")" << std::endl;
-        } else {
-            failed++;
-            std::cout << "FAIL: " << testName << " (expected: " << expected << ", actual: " << actual << ")" << std::endl;
-        }
-    }
-
-    void assertDoubleEqual(double actual, double expected, const std::string& testName, double epsilon = 1e-10) {
-        bool condition = std::abs(actual - expected) < epsilon;
-        testResults.emplace_back(testName, condition);
-        if (condition) {
-            passed++;
-            std::cout << "PASS: " << testName << " (expected: " << expected << ", actual: " << actual << ")" << std::endl;
-        } else {
-            failed++;
-            std::cout << "FAIL: " << testName << " (expected: " << expected << ", actual: " << actual << ")" << std::endl;
-        }
-    }
-
-    void printSummary() {
-        std::cout << "\n=== TEST SUMMARY ===" << std::endl;
-        std::cout << "Total tests: " << (passed + failed) << std::endl;
-        std::cout << "Passed: " << passed << std::endl;
-        std::cout << "Failed: " << failed << std::endl;
-        
-        if (failed > 0) {
-            std::cout << "\nFailed tests:" << std::endl;
-            for (const auto& testResult : testResults) {
-                const std::string& testName = testResult.first;
-                bool result = testResult.second;
-            }
-        }
-    }
-
-    bool allTestsPassed() const {
-        return failed == 0;
-    }
-};
-
 // Тест 1: базовое разделение
 void testSplitsMassFlowEqually(TestFramework& tf) {
     Separator sep;
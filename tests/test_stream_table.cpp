@@ -0,0 +1,107 @@
+#define DEVICE_NO_MAIN
+#include "../Flowsheet.cpp"
+#include "TestFramework.cpp"
+
+// Тест 1: потоки хранятся в одном непрерывном массиве
+void testFlowsAreContiguous(TestFramework& tf) {
+    StreamTable table;
+    Stream a(table, 1);
+    Stream b(table, 2);
+    a.setMassFlow(3.0);
+    b.setMassFlow(4.0);
+
+    tf.assertTrue(b.getIndex() == a.getIndex() + 1, "FlowsAreContiguous - sequential indices");
+    tf.assertDoubleEqual(table.data()[a.getIndex()], 3.0, "FlowsAreContiguous - a in table");
+    tf.assertDoubleEqual(table.data()[b.getIndex()], 4.0, "FlowsAreContiguous - b in table");
+}
+
+// Тест 2: имена интернируются в общем пуле
+void testNamesAreInterned(TestFramework& tf) {
+    StreamTable table;
+    Stream a(table, 1);
+    Stream b(table, 2);
+    a.setName("feed");
+    b.setName("feed");
+    tf.assertEqual(a.getName(), std::string("feed"), "NamesAreInterned - name kept");
+    tf.assertTrue(table.intern("feed") == table.intern(b.getName()), "NamesAreInterned - single pool entry");
+    tf.assertEqual(Stream(table, 7).getName(), std::string("s7"), "NamesAreInterned - default name");
+}
+
+// Тест 3: устройство читает и пишет потоки через таблицу
+void testDeviceUpdatesThroughTable(TestFramework& tf) {
+    Flowsheet fs;
+    auto in1 = fs.addStream();
+    auto in2 = fs.addStream();
+    auto out = fs.addStream();
+    auto mix = fs.addDevice<Mixer>(2);
+    mix->addInput(in1);
+    mix->addInput(in2);
+    mix->addOutput(out);
+
+    fs.getTable().setFlow(in1->getIndex(), 1.5);
+    in2->setMassFlow(2.5);
+    fs.evaluate();
+
+    tf.assertDoubleEqual(out->getMassFlow(), 4.0, "DeviceUpdatesThroughTable - mixer output");
+    tf.assertTrue(mix->getOutputIds().front() == out->getIndex(), "DeviceUpdatesThroughTable - output index");
+}
+
+// Тест 4: нельзя подключать к устройству потоки из разных таблиц
+void testRejectsMixedTables(TestFramework& tf) {
+    StreamTable other;
+    Flowsheet fs;
+    auto r = fs.addDevice<Reactor>(false);
+    r->addInput(fs.addStream());
+    try {
+        r->addOutput(std::make_shared<Stream>(other, 1));
+        tf.assertTrue(false, "RejectsMixedTables - should have thrown");
+    } catch (const DeviceException& e) {
+        tf.assertTrue(e.code() == DeviceError::DifferentTables, "RejectsMixedTables - threw correctly");
+    }
+}
+
+// Тест 5: имя потока строится только по запросу
+void testNamesAreLazy(TestFramework& tf) {
+    StreamTable table;
+    Stream a(table, 42);
+    tf.assertEqual(a.getName(), std::string("s42"), "NamesAreLazy - generated name");
+    tf.assertTrue(table.intern("s42") == 0, "NamesAreLazy - generated name not interned");
+    a.setName("feed");
+    tf.assertEqual(a.getName(), std::string("feed"), "NamesAreLazy - renamed");
+}
+
+// Тест 6: потоки и устройства размещаются в арене листа
+void testFlowsheetUsesArena(TestFramework& tf) {
+    Flowsheet fs;
+    size_t before = fs.arenaBytes();
+    auto s = fs.addStream();
+    auto mix = fs.addDevice<Mixer>(1);
+    tf.assertTrue(fs.arenaBytes() >= before + sizeof(Stream) + sizeof(Mixer), "FlowsheetUsesArena - objects in arena");
+    tf.assertTrue(s.use_count() == 0, "FlowsheetUsesArena - stream handle not reference counted");
+    tf.assertTrue(mix.use_count() == 0, "FlowsheetUsesArena - device handle not reference counted");
+
+    Arena arena(16);
+    int* values[100];
+    for (int i = 0; i < 100; i++) values[i] = arena.create<int>(i);
+    tf.assertTrue(*values[99] == 99 && arena.chunkCount() > 1, "FlowsheetUsesArena - arena grows by chunks");
+    arena.release();
+    tf.assertTrue(arena.bytesUsed() == 0 && arena.chunkCount() == 0, "FlowsheetUsesArena - bulk release");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running StreamTable tests..." << std::endl;
+    std::cout << "============================" << std::endl;
+
+    testFlowsAreContiguous(tf);
+    testNamesAreInterned(tf);
+    testDeviceUpdatesThroughTable(tf);
+    testRejectsMixedTables(tf);
+    testNamesAreLazy(tf);
+    testFlowsheetUsesArena(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+#define DEVICE_NO_MAIN
+#include "../StreamingDriver.cpp"
+#include "TestFramework.cpp"
+#include <sstream>
+
+// Два питания смешиваются, смесь делится сепаратором
+struct StreamingSheet {
+    Flowsheet fs;
+    shared_ptr<Stream> feed1, feed2, mixed, top, bottom;
+
+    StreamingSheet() {
+        feed1 = fs.addStream();
+        feed2 = fs.addStream();
+        mixed = fs.addStream();
+        top = fs.addStream();
+        bottom = fs.addStream();
+        auto mix = fs.addDevice<Mixer>(2);
+        auto sep = fs.addDevice<Separator>();
+        mix->addInput(feed1);
+        mix->addInput(feed2);
+        mix->addOutput(mixed);
+        sep->addInput(mixed);
+        sep->addOutput(top);
+        sep->addOutput(bottom);
+        top->setName("top");
+        mixed->setName("mixed");
+    }
+};
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+// Тест 1: CSV с заголовком проходит через схему шаг за шагом
+void testCsvFeedToCsvOutput(TestFramework& tf) {
+    {
+        std::ofstream feed("test_streaming_feed.csv");
+        feed << "feed1,feed2\n1,2\n\n3,4\r\n5,6\n";
+    }
+    StreamingSheet sheet;
+    StreamingDriver driver(sheet.fs, {sheet.feed1, sheet.feed2}, {sheet.mixed, sheet.top}, 2, 2);
+    CsvFeedReader reader("test_streaming_feed.csv");
+    size_t steps;
+    {
+        CsvOutputSink sink("test_streaming_out.csv", driver.outputNames());
+        steps = driver.run(reader, sink);
+    }
+    tf.assertTrue(steps == 3, "CsvFeedToCsvOutput - every step run");
+    tf.assertEqual(readFile("test_streaming_out.csv"), std::string("mixed,top\n3,1.5\n7,3.5\n11,5.5\n"),
+                   "CsvFeedToCsvOutput - output rows");
+}
+
+// Тест 2: длинный двоичный ряд идёт через маленькие буферы без потерь и перестановок
+void testBinaryLongHorizon(TestFramework& tf) {
+    const size_t steps = 10000;
+    {
+        std::ofstream feed("test_streaming_feed.bin", std::ios::binary);
+        for (size_t i = 0; i < steps; i++) {
+            double row[2] = {double(i), 1.0};
+            feed.write(reinterpret_cast<const char*>(row), sizeof(row));
+        }
+    }
+    StreamingSheet sheet;
+    StreamingDriver driver(sheet.fs, {sheet.feed1, sheet.feed2}, {sheet.bottom}, 64, 3);
+    BinaryFeedReader reader("test_streaming_feed.bin");
+    {
+        BinaryOutputSink sink("test_streaming_out.bin");
+        tf.assertTrue(driver.run(reader, sink) == steps, "BinaryLongHorizon - every step run");
+    }
+    std::ifstream out("test_streaming_out.bin", std::ios::binary);
+    bool ordered = true;
+    size_t count = 0;
+    double v;
+    while (out.read(reinterpret_cast<char*>(&v), sizeof(v))) {
+        ordered = ordered && v == (double(count) + 1.0) / 2.0;
+        count++;
+    }
+    tf.assertTrue(ordered && count == steps, "BinaryLongHorizon - outputs in step order");
+}
+
+// Тест 3: ошибка чтения останавливает конвейер и передаётся вызывающему
+void testReaderErrorPropagates(TestFramework& tf) {
+    {
+        std::ofstream feed("test_streaming_feed.csv");
+        feed << "1,2\n3\n";
+    }
+    StreamingSheet sheet;
+    StreamingDriver driver(sheet.fs, {sheet.feed1, sheet.feed2}, {sheet.mixed}, 1, 1);
+    CsvFeedReader reader("test_streaming_feed.csv");
+    CsvOutputSink sink("test_streaming_out.csv", driver.outputNames());
+    DeviceError code = DeviceError::None;
+    try {
+        driver.run(reader, sink);
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(code == DeviceError::FileFormat, "ReaderErrorPropagates - error rethrown");
+}
+
+// Тест 4: поток чужой таблицы отвергается сразу, а не даёт устаревшие выходы
+void testForeignStreamRejected(TestFramework& tf) {
+    StreamingSheet sheet;
+    auto foreign = std::make_shared<Stream>(900);
+    DeviceError feedCode = DeviceError::None, outputCode = DeviceError::None;
+    try {
+        StreamingDriver driver(sheet.fs, {sheet.feed1, foreign}, {sheet.mixed});
+    } catch (const DeviceException& e) {
+        feedCode = e.code();
+    }
+    try {
+        StreamingDriver driver(sheet.fs, {sheet.feed1}, {foreign});
+    } catch (const DeviceException& e) {
+        outputCode = e.code();
+    }
+    tf.assertTrue(feedCode == DeviceError::DifferentTables, "ForeignStreamRejected - feed stream");
+    tf.assertTrue(outputCode == DeviceError::DifferentTables, "ForeignStreamRejected - output stream");
+}
+
+// Тест 5: двоичный ряд без столбцов не делит на ноль
+void testBinaryNoColumns(TestFramework& tf) {
+    {
+        std::ofstream feed("test_streaming_feed.bin", std::ios::binary);
+        double row = 1.0;
+        feed.write(reinterpret_cast<const char*>(&row), sizeof(row));
+    }
+    BinaryFeedReader reader("test_streaming_feed.bin");
+    double values[1];
+    tf.assertTrue(reader.read(values, 0, 4) == 0, "BinaryNoColumns - no steps");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running streaming driver tests..." << std::endl;
+    std::cout << "=================================" << std::endl;
+
+    testCsvFeedToCsvOutput(tf);
+    testBinaryLongHorizon(tf);
+    testReaderErrorPropagates(tf);
+    testForeignStreamRejected(tf);
+    testBinaryNoColumns(tf);
+    for (const char* f : {"test_streaming_feed.csv", "test_streaming_out.csv", "test_streaming_feed.bin", "test_streaming_out.bin"}) {
+        std::remove(f);
+    }
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#define DEVICE_NO_MAIN
+#include "../FlowsheetTape.cpp"
+#include "TestFramework.cpp"
+
+// Цепочка: смеситель -> реактор -> делитель, промежуточные потоки никто не читает
+struct ChainSheet {
+    Flowsheet fs;
+    shared_ptr<Stream> feed1, feed2, mixed, reacted, top, bottom;
+
+    ChainSheet() {
+        feed1 = fs.addStream();
+        feed2 = fs.addStream();
+        mixed = fs.addStream();
+        reacted = fs.addStream();
+        top = fs.addStream();
+        bottom = fs.addStream();
+        auto mix = fs.addDevice<Mixer>(2);
+        auto r = fs.addDevice<Reactor>(false);
+        auto sep = fs.addDevice<Separator>(vector<double>{3.0, 1.0});
+        mix->addInput(feed1);
+        mix->addInput(feed2);
+        mix->addOutput(mixed);
+        r->addInput(mixed);
+        r->addOutput(reacted);
+        sep->addInput(reacted);
+        sep->addOutput(top);
+        sep->addOutput(bottom);
+        feed1->setMassFlow(6.0);
+        feed2->setMassFlow(2.0);
+    }
+};
+
+// Тест 1: цепочка сливается в одну инструкцию, результат совпадает с evaluate()
+void testChainFused(TestFramework& tf) {
+    ChainSheet s;
+    FlowsheetTape tape(s.fs);
+    tape.evaluate();
+    tf.assertEqual(tape.instructionCount(), size_t(1), "ChainFused - one instruction");
+    tf.assertEqual(tape.elidedStreamCount(), size_t(2), "ChainFused - both intermediates elided");
+    tf.assertDoubleEqual(s.top->getMassFlow(), 6.0, "ChainFused - first product");
+    tf.assertDoubleEqual(s.bottom->getMassFlow(), 2.0, "ChainFused - second product");
+    tf.assertDoubleEqual(s.mixed->getMassFlow(), 0.0, "ChainFused - elided stream not written");
+}
+
+// Тест 2: наблюдаемый поток не исключается
+void testObservedStreamKept(TestFramework& tf) {
+    ChainSheet s;
+    FlowsheetTape tape(s.fs);
+    tape.observe(*s.mixed);
+    tape.evaluate();
+    tf.assertEqual(tape.instructionCount(), size_t(2), "ObservedStreamKept - mixer kept");
+    tf.assertEqual(tape.elidedStreamCount(), size_t(1), "ObservedStreamKept - reactor outlet still elided");
+    tf.assertDoubleEqual(s.mixed->getMassFlow(), 8.0, "ObservedStreamKept - observed stream written");
+}
+
+// Устройство без известного вида: удваивает вход
+class Doubler : public Device {
+public:
+    Doubler() { inputAmount = 1; outputAmount = 1; }
+    void updateOutputs() override { table->setFlow(outputIds[0], 2.0 * table->flow(inputIds[0])); }
+};
+
+// Тест 3: рецикл и устройство другого типа дают те же потоки, что evaluate()
+void testRecycleAndOtherDevices(TestFramework& tf) {
+    Flowsheet expected, actual;
+    for (Flowsheet* fs : {&expected, &actual}) {
+        auto feed = fs->addStream();
+        auto loop = fs->addStream();
+        auto mixed = fs->addStream();
+        auto reacted = fs->addStream();
+        auto doubledIn = fs->addStream();
+        auto product = fs->addStream();
+        auto mix = fs->addDevice<Mixer>(2);
+        auto r = fs->addDevice<Reactor>(false);
+        auto sep = fs->addDevice<Separator>(vector<double>{1.0, 1.0, 2.0});
+        auto doubler = fs->addDevice<Doubler>();
+        mix->addInput(feed);
+        mix->addInput(loop);
+        mix->addOutput(mixed);
+        r->addInput(mixed);
+        r->addOutput(reacted);
+        sep->addInput(reacted);
+        sep->addOutput(doubledIn);
+        sep->addOutput(loop);
+        sep->addOutput(product);
+        doubler->addInput(doubledIn);
+        doubler->addOutput(fs->addStream());
+        feed->setMassFlow(10.0);
+    }
+    expected.evaluate();
+    FlowsheetTape tape(actual);
+    tape.evaluate();
+    bool same = true;
+    for (size_t i = 0; i < expected.getStreams().size(); i++) {
+        if (i == 3) continue; // выход реактора исключён
+        double a = expected.getStreams()[i]->getMassFlow(), b = actual.getStreams()[i]->getMassFlow();
+        same = same && std::abs(a - b) <= 1e-8 * std::max(1.0, std::abs(a));
+    }
+    tf.assertTrue(same, "RecycleAndOtherDevices - same flows as evaluate()");
+    tf.assertTrue(tape.getLastRecycleSweeps() > 1, "RecycleAndOtherDevices - loop iterated");
+    tf.assertDoubleEqual(actual.getStreams()[5]->getMassFlow() + actual.getStreams()[4]->getMassFlow(), 10.0,
+                         "RecycleAndOtherDevices - mass closes");
+}
+
+// Тест 4: перекоммутация перекомпилирует ленту
+void testRewiringRecompiles(TestFramework& tf) {
+    ChainSheet s;
+    FlowsheetTape tape(s.fs);
+    tape.evaluate();
+    auto extra = s.fs.addStream();
+    auto out = s.fs.addStream();
+    auto mix = s.fs.addDevice<Mixer>(1);
+    mix->addInput(s.bottom);
+    mix->addOutput(extra);
+    auto r = s.fs.addDevice<Reactor>(false);
+    r->addInput(extra);
+    r->addOutput(out);
+    tape.evaluate();
+    tf.assertEqual(tape.instructionCount(), size_t(2), "RewiringRecompiles - new chain fused");
+    tf.assertDoubleEqual(out->getMassFlow(), 2.0, "RewiringRecompiles - new product evaluated");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running flowsheet tape tests..." << std::endl;
+    std::cout << "===============================" << std::endl;
+
+    testChainFused(tf);
+    testObservedStreamKept(tf);
+    testRecycleAndOtherDevices(tf);
+    testRewiringRecompiles(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}
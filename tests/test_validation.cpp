@@ -0,0 +1,115 @@
+#define DEVICE_NO_MAIN
+#define DEVICE_CHECKED
+#include "../Flowsheet.cpp"
+#include "TestFramework.cpp"
+
+// Тест 1: подключение с кодом ошибки не бросает исключений
+void testTryAddReturnsCodes(TestFramework& tf) {
+    Flowsheet fs;
+    StreamTable other;
+    auto mix = fs.addDevice<Mixer>(1);
+    tf.assertTrue(mix->tryAddInput(fs.addStream()) == DeviceError::None, "TryAddReturnsCodes - connected");
+    tf.assertTrue(mix->tryAddInput(fs.addStream()) == DeviceError::InputLimit, "TryAddReturnsCodes - input limit");
+    tf.assertTrue(mix->tryAddOutput(std::make_shared<Stream>(other, 1)) == DeviceError::DifferentTables,
+                  "TryAddReturnsCodes - other table");
+    tf.assertTrue(mix->getOutputs().empty(), "TryAddReturnsCodes - rejected stream not connected");
+}
+
+// Тест 2: все устройства бросают один тип исключения с кодом
+void testThrowsTypedException(TestFramework& tf) {
+    Flowsheet fs;
+    auto mix = fs.addDevice<Mixer>(2);
+    mix->addOutput(fs.addStream());
+    DeviceError code = DeviceError::None;
+    try {
+        mix->addOutput(fs.addStream());
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(code == DeviceError::OutputLimit, "ThrowsTypedException - mixer output limit");
+}
+
+// Тест 3: проверка схемы возвращает все найденные проблемы
+void testValidateListsProblems(TestFramework& tf) {
+    Flowsheet fs;
+    fs.setComponentCount(2);
+    auto feed = fs.addStream();
+    auto shared = fs.addStream();
+    auto sep = fs.addDevice<Separator>();
+    auto r = fs.addDevice<Reactor>(false);
+    auto lonely = fs.addDevice<Mixer>(1);
+    sep->addInput(feed);
+    sep->addOutput(shared);
+    sep->addOutput(fs.addStream());
+    sep->setComponentSplit(ComponentVector{0.5, 0.5, 0.5});
+    r->addInput(feed);
+    r->addOutput(shared);
+
+    std::vector<Diagnostic> found = fs.validate();
+    tf.assertTrue(found.size() == 3, "ValidateListsProblems - three problems");
+    tf.assertTrue(found[0].code == DeviceError::SplitSize && found[0].device == sep.get(), "ValidateListsProblems - split size");
+    tf.assertTrue(found[1].code == DeviceError::SeveralProducers && found[1].stream == shared->getIndex(),
+                  "ValidateListsProblems - several producers");
+    tf.assertTrue(found[2].code == DeviceError::MissingOutput && found[2].device == lonely.get(),
+                  "ValidateListsProblems - missing output");
+    tf.assertEqual(std::string(found[2].message()), std::string("MISSING OUTPUT STREAM!"), "ValidateListsProblems - message");
+}
+
+// Тест 4: в проверяемом режиме обновление некорректного устройства бросает исключение
+void testCheckedModeThrows(TestFramework& tf) {
+    Flowsheet fs;
+    auto r = fs.addDevice<Reactor>(true);
+    r->addInput(fs.addStream());
+    r->addOutput(fs.addStream());
+    DeviceError code = DeviceError::None;
+    try {
+        fs.evaluate();
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(code == DeviceError::MissingOutput, "CheckedModeThrows - missing output reported");
+    r->addOutput(fs.addStream());
+    tf.assertTrue(fs.validate().empty(), "CheckedModeThrows - valid once wired");
+}
+
+// Тест 5: только проверяемое обновление замечает изменение, о котором схема не знает
+void testCheckedUpdateCatchesUntrackedChange(TestFramework& tf) {
+    Flowsheet fs;
+    fs.setComponentCount(2);
+    auto in = fs.addStream();
+    auto r = fs.addDevice<Reactor>(false);
+    r->addInput(in);
+    r->addOutput(fs.addStream());
+    r->setConversion({1.0, 0.0, 0.0, 1.0});
+    fs.evaluate();
+
+    // Число компонентов меняется в таблице в обход Flowsheet::setComponentCount,
+    // поэтому порядок расчёта не перестраивается и проверка схемы не повторяется.
+    unsigned long version = fs.getWiringVersion();
+    fs.getTable().setComponentCount(3);
+    DeviceError code = DeviceError::None;
+    try {
+        fs.evaluate();
+    } catch (const DeviceException& e) {
+        code = e.code();
+    }
+    tf.assertTrue(fs.getWiringVersion() == version, "CheckedUpdateCatchesUntrackedChange - order not rebuilt");
+    tf.assertTrue(code == DeviceError::ConversionSize, "CheckedUpdateCatchesUntrackedChange - caught by update()");
+}
+
+int main() {
+    TestFramework tf;
+
+    std::cout << "Running validation tests..." << std::endl;
+    std::cout << "===========================" << std::endl;
+
+    testTryAddReturnsCodes(tf);
+    testThrowsTypedException(tf);
+    testValidateListsProblems(tf);
+    testCheckedModeThrows(tf);
+    testCheckedUpdateCatchesUntrackedChange(tf);
+
+    tf.printSummary();
+
+    return tf.allTestsPassed() ? 0 : 1;
+}